@@ -23,11 +23,11 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
     pManager = FbxManager::Create();
     if( !pManager )
     {
-        FBXSDK_printf("***   Error: Unable to create FBX Manager!\n");
+        LOG_ERROR("***   Error: Unable to create FBX Manager!\n");
         exit(1);
     }
-	else if(G_bVerbose)
-		FBXSDK_printf("\tAutodesk FBX SDK version %s\n", pManager->GetVersion());
+	else
+		LOG_VERBOSE("\tAutodesk FBX SDK version %s\n", pManager->GetVersion());
 
 	//Create an IOSettings object. This object holds all import/export settings.
 	FbxIOSettings* ios = FbxIOSettings::Create(pManager, IOSROOT);
@@ -41,7 +41,7 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
     pScene = FbxScene::Create(pManager, "My Scene");
 	if( !pScene )
     {
-        FBXSDK_printf("***   Error: Unable to create FBX scene!\n");
+        LOG_ERROR("***   Error: Unable to create FBX scene!\n");
         exit(1);
     }
 }
@@ -50,7 +50,7 @@ void DestroySdkObjects(FbxManager* pManager, bool pExitStatus)
 {
     //Delete the FBX Manager. All the objects that have been allocated using the FBX Manager and that haven't been explicitly destroyed are also automatically destroyed.
     if( pManager ) pManager->Destroy();
-	if( pExitStatus ) FBXSDK_printf("Program Success!\n");
+	if( pExitStatus ) LOG_INFO("Program Success!\n");
 }
 
 bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename, int pFileFormat, bool pEmbedMedia)
@@ -98,13 +98,13 @@ bool SaveScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename,
     // Initialize the exporter by providing a filename.
     if(lExporter->Initialize(pFilename, pFileFormat, pManager->GetIOSettings()) == false)
     {
-        FBXSDK_printf("Call to FbxExporter::Initialize() failed.\n");
-        FBXSDK_printf("Error returned: %s\n\n", lExporter->GetLastErrorString());
+        LOG_ERROR("Call to FbxExporter::Initialize() failed.\n");
+        LOG_ERROR("Error returned: %s\n\n", lExporter->GetLastErrorString());
         return false;
     }
 
     FbxManager::GetFileFormatVersion(lMajor, lMinor, lRevision);
-    FBXSDK_printf("FBX file format version %d.%d.%d\n\n", lMajor, lMinor, lRevision);
+    LOG_INFO("FBX file format version %d.%d.%d\n\n", lMajor, lMinor, lRevision);
 
     // Export the scene.
     lStatus = lExporter->Export(pScene); 
@@ -135,53 +135,51 @@ bool LoadScene(FbxManager* pManager, FbxDocument* pScene, const char* pFilename)
 
     if( !lImportStatus )
     {
-        FBXSDK_printf("*** Call to FbxImporter::Initialize() failed.\n");
-        FBXSDK_printf("*** Error returned: %s\n\n", lImporter->GetLastErrorString());
+        LOG_ERROR("*** Call to FbxImporter::Initialize() failed.\n");
+        LOG_ERROR("*** Error returned: %s\n\n", lImporter->GetLastErrorString());
 
         if (lImporter->GetLastErrorID() == FbxIOBase::eFileVersionNotSupportedYet ||
             lImporter->GetLastErrorID() == FbxIOBase::eFileVersionNotSupportedAnymore)
         {
-            FBXSDK_printf("*** FBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
-            FBXSDK_printf("*** FBX file format version for file '%s' is %d.%d.%d\n\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
+            LOG_ERROR("*** FBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
+            LOG_ERROR("*** FBX file format version for file '%s' is %d.%d.%d\n\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
         }
 
         return false;
     }
 
-	if(G_bVerbose)
-	    FBXSDK_printf("\t\t\tFBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
+	LOG_VERBOSE("\t\t\tFBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
 
     if (lImporter->IsFBX())
     {
-		if(G_bVerbose)
-	        FBXSDK_printf("\t\t\tFBX file format version for file '%s' is %d.%d.%d\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
+		LOG_VERBOSE("\t\t\tFBX file format version for file '%s' is %d.%d.%d\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
 
         // From this point, it is possible to access animation stack information without
         // the expense of loading the entire file.
 
         lAnimStackCount = lImporter->GetAnimStackCount();
 
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		{
-	        FBXSDK_printf("\t\t\tAnimation Stack Information:\n");
-		    FBXSDK_printf("\t\t\t\tNumber of Animation Stacks: %d\n", lAnimStackCount);
-			FBXSDK_printf("\t\t\t\tCurrent Animation Stack: \"%s\"\n", lImporter->GetActiveAnimStackName().Buffer());
+	        LOG_VERBOSE("\t\t\tAnimation Stack Information:\n");
+		    LOG_VERBOSE("\t\t\t\tNumber of Animation Stacks: %d\n", lAnimStackCount);
+			LOG_VERBOSE("\t\t\t\tCurrent Animation Stack: \"%s\"\n", lImporter->GetActiveAnimStackName().Buffer());
 
 			for(i = 0; i < lAnimStackCount; i++)
 			{
 				FbxTakeInfo* lTakeInfo = lImporter->GetTakeInfo(i);
 
-				FBXSDK_printf("\t\t\t\tAnimation Stack %d\n", i);
-				FBXSDK_printf("\t\t\t\tName: \"%s\"\n", lTakeInfo->mName.Buffer());
-				FBXSDK_printf("\t\t\t\tDescription: \"%s\"\n", lTakeInfo->mDescription.Buffer());
+				LOG_VERBOSE("\t\t\t\tAnimation Stack %d\n", i);
+				LOG_VERBOSE("\t\t\t\tName: \"%s\"\n", lTakeInfo->mName.Buffer());
+				LOG_VERBOSE("\t\t\t\tDescription: \"%s\"\n", lTakeInfo->mDescription.Buffer());
 
 				// Change the value of the import name if the animation stack should be imported 
 				// under a different name.
-				FBXSDK_printf("\t\t\t\tImport Name: \"%s\"\n", lTakeInfo->mImportName.Buffer());
+				LOG_VERBOSE("\t\t\t\tImport Name: \"%s\"\n", lTakeInfo->mImportName.Buffer());
 
 				// Set the value of the import state to false if the animation stack should be not
 				// be imported. 
-				FBXSDK_printf("\t\t\t\tImport State: %s\n", lTakeInfo->mSelect ? "true" : "false");
+				LOG_VERBOSE("\t\t\t\tImport State: %s\n", lTakeInfo->mSelect ? "true" : "false");
 			}
 		}
 
@@ -10,6 +10,7 @@
 ****************************************************************************************/
 
 #include "DisplayCommon.h"
+#include "../fbx1/Log.h"
 #if defined (FBXSDK_ENV_MAC)
 // disable the format not a string literal and no format arguments warning since
 // the FBXSDK_printf calls made here are all valid calls and there is no secuity risk
@@ -37,7 +38,7 @@ void DisplayString(const char* pHeader, const char* pValue /* = "" */, const cha
     lString += pValue;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -49,7 +50,7 @@ void DisplayBool(const char* pHeader, bool pValue, const char* pSuffix /* = "" *
     lString += pValue ? "true" : "false";
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -61,7 +62,7 @@ void DisplayInt(const char* pHeader, int pValue, const char* pSuffix /* = "" */)
     lString += pValue;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -77,7 +78,7 @@ void DisplayDouble(const char* pHeader, double pValue, const char* pSuffix /* =
     lString += lFloatValue;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -98,7 +99,7 @@ void Display2DVector(const char* pHeader, FbxVector2 pValue, const char* pSuffix
     lString += lFloatValue2;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -124,7 +125,7 @@ void Display3DVector(const char* pHeader, FbxVector4 pValue, const char* pSuffix
     lString += lFloatValue3;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 void Display4DVector(const char* pHeader, FbxVector4 pValue, const char* pSuffix /* = "" */)
@@ -154,7 +155,7 @@ void Display4DVector(const char* pHeader, FbxVector4 pValue, const char* pSuffix
     lString += lFloatValue4;
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -175,7 +176,7 @@ void DisplayColor(const char* pHeader, FbxPropertyT<FbxDouble3> pValue, const ch
     lString += " (blue)";
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
 
@@ -195,6 +196,6 @@ void DisplayColor(const char* pHeader, FbxColor pValue, const char* pSuffix /* =
     lString += " (blue)";
     lString += pSuffix;
     lString += "\n";
-    FBXSDK_printf(lString);
+    LOG_VERBOSE("%s", lString.Buffer());
 }
 
@@ -0,0 +1,438 @@
+//
+// Write-behind output files: a background thread does the disk I/O
+//
+
+
+
+//
+// System headers
+//
+#include <process.h> // thread library ('_beginthreadex')
+#include <assert.h>
+#include <string.h>
+
+
+//
+// Project Includes
+//
+#include "AsyncWriter.h"
+#include "Log.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// One file on its way to disk.  Belongs to its AsyncFile until it's closed or abandoned,
+// then to whoever does the work (the I/O thread, or the caller without one)
+////////////////////////////////////////////////////////////////////////////////////////
+struct AsyncFileState
+{
+	string filename;
+	string tempFilename;
+	HANDLE hFile;
+	volatile LONG failed;	// set on the I/O thread, read by the file's owner
+};
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// FILE OPERATIONS
+// The same on the I/O thread or the caller's.  Once one fails, the rest do nothing and
+// the temp file gets deleted in the end
+//
+///////////////////////////////////////////////////////////////////////////////////////
+static bool Failed(AsyncFileState *pFile, const char *pFormat)
+{
+	if(!pFile->failed)
+		LOG_ERROR(pFormat, pFile->filename.c_str());
+
+	InterlockedExchange(&pFile->failed, 1);
+	return false;
+}
+
+
+
+static bool OpenTempFile(AsyncFileState *pFile)
+{
+	pFile->hFile = CreateFileA(pFile->tempFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(pFile->hFile == INVALID_HANDLE_VALUE)
+		return Failed(pFile, "***   Can't create %s\n");
+
+	return true;
+}
+
+
+
+static bool WriteToFile(AsyncFileState *pFile, unsigned __int64 offset, const char *pData, size_t size)
+{
+	while(!pFile->failed && size > 0)
+	{
+		DWORD cnt = (DWORD) (size < ASYNC_WRITE_CHUNK ? size : ASYNC_WRITE_CHUNK);
+		DWORD written = 0;
+
+		// the offset goes in the OVERLAPPED, the handle isn't: a plain write at that spot
+		OVERLAPPED at;
+		memset(&at, 0, sizeof(at));
+		at.Offset = (DWORD) offset;
+		at.OffsetHigh = (DWORD) (offset >> 32);
+
+		if(!WriteFile(pFile->hFile, pData, cnt, &written, &at) || written != cnt)
+			return Failed(pFile, "***   Error writing %s\n");
+
+		offset += cnt;
+		pData += cnt;
+		size -= cnt;
+	}
+
+	return !pFile->failed;
+}
+
+
+
+static void FlushToDisk(AsyncFileState *pFile)
+{
+	if(!pFile->failed && !FlushFileBuffers(pFile->hFile))
+		Failed(pFile, "***   Error writing %s\n");
+}
+
+
+
+// close, then into place if all went well.  Replacing the old file is atomic
+static bool FinishFile(AsyncFileState *pFile)
+{
+	if(pFile->hFile != INVALID_HANDLE_VALUE && !CloseHandle(pFile->hFile))
+		Failed(pFile, "***   Error writing %s\n");
+	pFile->hFile = INVALID_HANDLE_VALUE;
+
+	if(!pFile->failed && !MoveFileExA(pFile->tempFilename.c_str(), pFile->filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		Failed(pFile, "***   Can't replace %s\n");
+
+	if(pFile->failed)
+	{
+		DeleteFileA(pFile->tempFilename.c_str());
+		return false;
+	}
+
+	LOG_VERBOSE("\t\tSaved %s\n", pFile->filename.c_str());
+	return true;
+}
+
+
+
+static void DiscardFile(AsyncFileState *pFile)
+{
+	InterlockedExchange(&pFile->failed, 1);
+	FinishFile(pFile);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// ASYNC FILE
+//
+///////////////////////////////////////////////////////////////////////////////////////
+AsyncFile::AsyncFile() : m_pWriter(NULL), m_pState(NULL)
+{
+}
+
+
+
+AsyncFile::~AsyncFile()
+{
+	Abandon();
+}
+
+
+
+bool AsyncFile::Open(AsyncWriter *pWriter, const string & filename)
+{
+	Abandon();
+
+	m_pWriter = pWriter;
+	m_pState = new AsyncFileState;
+	m_pState->filename = filename;
+	m_pState->tempFilename = filename + ASYNC_TEMP_SUFFIX;
+	m_pState->hFile = INVALID_HANDLE_VALUE;
+	m_pState->failed = 0;
+
+	if(!m_pWriter)
+	{
+		if(OpenTempFile(m_pState))
+			return true;
+
+		delete m_pState;
+		m_pState = NULL;
+		return false;
+	}
+
+	AsyncWriter::Request request = { AsyncWriter::REQUEST_OPEN, m_pState, 0, NULL, 0 };
+	m_pWriter->Queue(request);
+
+	return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// With a writer: copied a chunk at a time, so the cap on the bytes queued holds even
+// for huge writes.  Only blocks while the queue is full
+///////////////////////////////////////////////////////////////////////////////////////
+bool AsyncFile::Write(unsigned __int64 offset, const void *pData, size_t size)
+{
+	if(!m_pState)
+		return false;
+
+	const char *pBytes = (const char *) pData;
+
+	if(!m_pWriter)
+		return WriteToFile(m_pState, offset, pBytes, size);
+
+	if(m_pState->failed)
+		return false;
+
+	while(size > 0)
+	{
+		size_t cnt = size < ASYNC_WRITE_CHUNK ? size : ASYNC_WRITE_CHUNK;
+
+		AsyncWriter::Request request = { AsyncWriter::REQUEST_WRITE, m_pState, offset, new char[cnt], cnt };
+		memcpy(request.pData, pBytes, cnt);
+		m_pWriter->Queue(request);
+
+		offset += cnt;
+		pBytes += cnt;
+		size -= cnt;
+	}
+
+	return true;
+}
+
+
+
+bool AsyncFile::Close()
+{
+	if(!m_pState)
+		return false;
+
+	AsyncFileState *pState = m_pState;
+	m_pState = NULL;
+
+	if(!m_pWriter)
+	{
+		FlushToDisk(pState);
+		bool ok = FinishFile(pState);
+
+		delete pState;
+		return ok;
+	}
+
+	// read before it's handed over: the I/O thread deletes it once it's done
+	bool ok = !pState->failed;
+
+	AsyncWriter::Request request = { AsyncWriter::REQUEST_CLOSE, pState, 0, NULL, 0 };
+	m_pWriter->Queue(request);
+
+	return ok;
+}
+
+
+
+void AsyncFile::Abandon()
+{
+	if(!m_pState)
+		return;
+
+	if(!m_pWriter)
+	{
+		DiscardFile(m_pState);
+		delete m_pState;
+	}
+	else
+	{
+		AsyncWriter::Request request = { AsyncWriter::REQUEST_ABANDON, m_pState, 0, NULL, 0 };
+		m_pWriter->Queue(request);
+	}
+
+	m_pState = NULL;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// ASYNC WRITER
+//
+///////////////////////////////////////////////////////////////////////////////////////
+AsyncWriter::AsyncWriter(size_t maxBytesQueued) : m_bytesQueued(0), m_maxBytesQueued(maxBytesQueued), m_hThread(NULL), m_quit(0)
+{
+	InitializeCriticalSection(&m_lock);
+	m_hWork = CreateEvent(NULL, FALSE, FALSE, NULL);	// auto reset
+	m_hRoom = CreateEvent(NULL, TRUE, FALSE, NULL);		// manual reset: wakes every writer waiting
+}
+
+
+
+AsyncWriter::~AsyncWriter()
+{
+	if(m_hThread)
+	{
+		InterlockedExchange(&m_quit, 1);
+		SetEvent(m_hWork);
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+	}
+
+	assert(m_requests.empty() && m_finished.empty());
+
+	CloseHandle(m_hWork);
+	CloseHandle(m_hRoom);
+	DeleteCriticalSection(&m_lock);
+}
+
+
+
+bool AsyncWriter::Start()
+{
+	if(!m_hWork || !m_hRoom)
+		return false;
+
+	m_hThread = (HANDLE) _beginthreadex(NULL, 0, IOThreadStart, (void *) this, 0, NULL);
+	return m_hThread != NULL;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// A write bigger than the whole cap still goes, on its own
+///////////////////////////////////////////////////////////////////////////////////////
+void AsyncWriter::Queue(const Request & request)
+{
+	EnterCriticalSection(&m_lock);
+
+	while(m_bytesQueued > 0 && m_bytesQueued + request.size > m_maxBytesQueued)
+	{
+		ResetEvent(m_hRoom);
+		LeaveCriticalSection(&m_lock);
+
+		WaitForSingleObject(m_hRoom, INFINITE);
+
+		EnterCriticalSection(&m_lock);
+	}
+
+	m_requests.push_back(request);
+	m_bytesQueued += request.size;
+
+	LeaveCriticalSection(&m_lock);
+
+	SetEvent(m_hWork);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// I/O THREAD
+// Requests in the order they were queued.  Finished files are flushed and renamed
+// whenever the queue runs dry, or once enough of them have piled up
+///////////////////////////////////////////////////////////////////////////////////////
+unsigned __stdcall AsyncWriter::IOThreadStart(void *pData)
+{
+	static_cast<AsyncWriter *>(pData)->IOLoop();
+	return 0;
+}
+
+
+
+void AsyncWriter::IOLoop()
+{
+	for(;;)
+	{
+		Request request;
+		bool any = false;
+
+		EnterCriticalSection(&m_lock);
+		if(!m_requests.empty())
+		{
+			request = m_requests.front();
+			m_requests.pop_front();
+			any = true;
+		}
+		LeaveCriticalSection(&m_lock);
+
+		if(!any)
+		{
+			if(!m_finished.empty())
+				FinishBatch();
+			else if(m_quit)
+				break;
+			else
+				WaitForSingleObject(m_hWork, INFINITE);
+
+			continue;
+		}
+
+		Execute(request);
+
+		if(request.size)
+		{
+			EnterCriticalSection(&m_lock);
+			m_bytesQueued -= request.size;
+			LeaveCriticalSection(&m_lock);
+
+			SetEvent(m_hRoom);
+		}
+
+		if(m_finished.size() >= ASYNC_RENAME_BATCH)
+			FinishBatch();
+	}
+}
+
+
+
+void AsyncWriter::Execute(const Request & request)
+{
+	switch(request.type)
+	{
+		case REQUEST_OPEN:
+			OpenTempFile(request.pFile);
+			break;
+
+		case REQUEST_WRITE:
+			WriteToFile(request.pFile, request.offset, request.pData, request.size);
+			delete [] request.pData;
+			break;
+
+		case REQUEST_CLOSE:
+			m_finished.push_back(request.pFile);
+			break;
+
+		case REQUEST_ABANDON:
+			DiscardFile(request.pFile);
+			delete request.pFile;
+			break;
+	}
+}
+
+
+
+// every flush first, so the disk can get on with all of them, then every rename
+void AsyncWriter::FinishBatch()
+{
+	for(size_t i = 0; i < m_finished.size(); i++)
+		FlushToDisk(m_finished[i]);
+
+	for(size_t i = 0; i < m_finished.size(); i++)
+	{
+		FinishFile(m_finished[i]);
+		delete m_finished[i];
+	}
+
+	m_finished.clear();
+}
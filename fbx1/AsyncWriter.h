@@ -0,0 +1,157 @@
+////////////////////////////////////////////////
+// ASYNCWRITER.H
+//
+// Write-behind output files.  The threads making
+// the data hand their writes to a background I/O
+// thread and carry on: a slow disk (network
+// scratch space) only ever stalls that thread.
+// - writes are copied and queued, a chunk at a
+//   time.  The bytes queued are capped: past
+//   that, writers block until the disk catches
+//   up, so memory can't run away
+// - a file is written as "name.tmp", and only
+//   renamed over "name" once it's complete and
+//   flushed to disk.  A reader never sees half a
+//   file, and a failed file leaves the old one
+//   alone
+// - flushing and renaming are batched: finished
+//   files wait until the queue runs dry (or
+//   enough of them pile up), then all go at once
+// - errors found on the I/O thread are logged
+//   there, with the file's name
+// Without an AsyncWriter (NULL), every call does
+// its work right away on the calling thread, the
+// same way.
+////////////////////////////////////////////////
+
+
+#ifndef _ASYNC_WRITER_H_
+#define _ASYNC_WRITER_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define ASYNC_WRITE_CHUNK			(1 << 20)	// bytes per queued write.  Big writes get split up
+#define ASYNC_DEFAULT_MAX_MB		64			// bytes queued before writers block, in MB
+#define ASYNC_RENAME_BATCH			16			// finished files flushed and renamed in one go, at most
+#define ASYNC_TEMP_SUFFIX			".tmp"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+class AsyncWriter;
+struct AsyncFileState;
+
+
+
+// One output file.  Writes go anywhere in the file, in any order
+class AsyncFile
+{
+	public:
+		AsyncFile();
+		~AsyncFile();		// abandons the file if it wasn't closed
+
+		// start writing 'filename' (as its temp file).  NULL writer = all the work on this thread.
+		// Only fails right away without a writer, otherwise errors show up at Write or Close
+		bool Open(AsyncWriter *pWriter, const std::string & filename);
+		bool IsOpen() const { return m_pState != NULL; }
+
+		bool Write(unsigned __int64 offset, const void *pData, size_t size);	// false once the file is known to have failed
+		bool Close();		// rename into place once it's all on disk.  With a writer, true = queued
+		void Abandon();		// delete what was written
+
+	private:
+		AsyncWriter *m_pWriter;
+		AsyncFileState *m_pState;	// the I/O thread's once closed or abandoned
+
+		// not copyable
+		AsyncFile(const AsyncFile &);
+		AsyncFile & operator =(const AsyncFile &);
+};
+
+
+
+class AsyncWriter
+{
+	public:
+		AsyncWriter(size_t maxBytesQueued);
+		~AsyncWriter();		// every file queued gets finished first
+
+		bool Start();		// the I/O thread
+
+	private:
+		friend class AsyncFile;
+
+		enum RequestType
+		{
+			REQUEST_OPEN,
+			REQUEST_WRITE,
+			REQUEST_CLOSE,
+			REQUEST_ABANDON
+		};
+
+		struct Request
+		{
+			RequestType type;
+			AsyncFileState *pFile;
+			unsigned __int64 offset;
+			char *pData;			// REQUEST_WRITE: our own copy
+			size_t size;
+		};
+
+		CRITICAL_SECTION m_lock;
+		std::deque<Request> m_requests;
+		size_t m_bytesQueued;
+		size_t m_maxBytesQueued;
+		HANDLE m_hWork;				// auto reset: something got queued
+		HANDLE m_hRoom;				// manual reset: bytes got written, writers waiting for room can go
+		HANDLE m_hThread;
+		volatile LONG m_quit;
+
+		std::vector<AsyncFileState *> m_finished;	// I/O thread only: closed, waiting to be flushed and renamed
+
+		void Queue(const Request & request);	// blocks while the queue is full
+
+		static unsigned __stdcall IOThreadStart(void *pData);
+		void IOLoop();
+		void Execute(const Request & request);
+		void FinishBatch();
+
+		// not copyable
+		AsyncWriter(const AsyncWriter &);
+		AsyncWriter & operator =(const AsyncWriter &);
+};
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+extern AsyncWriter *G_pAsyncWriter;	// shared by all pipeline threads.  NULL = files are written by whoever makes them
+
+
+
+#endif // _ASYNC_WRITER_H_
@@ -0,0 +1,212 @@
+//
+// Decide in which order the files of a batch get handed to the workers
+//
+
+
+
+//
+// System headers
+//
+#include <algorithm>	// push_heap, pop_heap
+#include <math.h>
+
+
+//
+// Project Includes
+//
+#include "BatchScheduler.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Heap ordering: biggest file on top
+////////////////////////////////////////////////////////////////////////////////////////
+static bool SmallerFile(const FbxLibAndFilename *pA, const FbxLibAndFilename *pB)
+{
+	return pA->fileSize < pB->fileSize;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////
+BatchScheduler::BatchScheduler(WorkQueue<FbxLibAndFilename *> *pQueue, size_t window) : m_pQueue(pQueue), m_window(window)
+{
+	InitializeCriticalSection(&m_heapLock);
+	InitializeCriticalSection(&m_statsLock);
+
+	m_secPerByte = 1.0 / (SCHEDULER_DEFAULT_MB_PER_SEC * 1024.0 * 1024.0);
+	m_doneBytes = 0.0;
+	m_doneSec = 0.0;
+	m_predictedSec = 0.0;
+	m_absErrorSec = 0.0;
+	m_doneCnt = 0;
+}
+
+
+
+BatchScheduler::~BatchScheduler()
+{
+	DeleteCriticalSection(&m_heapLock);
+	DeleteCriticalSection(&m_statsLock);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Into the heap, then straight on to the workers if there's room.  Past the window, the
+// biggest file goes anyway and we wait for the workers (outside the lock, so the load
+// threads can keep feeding themselves)
+///////////////////////////////////////////////////////////////////////////////////////
+void BatchScheduler::Submit(FbxLibAndFilename *pFbxInfo)
+{
+	if(m_window == 0)
+	{
+		Dispatch(pFbxInfo);
+		return;
+	}
+
+	EnterCriticalSection(&m_heapLock);
+	m_heap.push_back(pFbxInfo);
+	push_heap(m_heap.begin(), m_heap.end(), SmallerFile);
+	LeaveCriticalSection(&m_heapLock);
+
+	Feed();
+
+	EnterCriticalSection(&m_heapLock);
+	FbxLibAndFilename *pBiggest = m_heap.size() > m_window ? PopBiggest() : NULL;
+	LeaveCriticalSection(&m_heapLock);
+
+	if(pBiggest)
+		Dispatch(pBiggest);
+}
+
+
+
+
+void BatchScheduler::Flush()
+{
+	for(;;)
+	{
+		EnterCriticalSection(&m_heapLock);
+		FbxLibAndFilename *pBiggest = m_heap.empty() ? NULL : PopBiggest();
+		LeaveCriticalSection(&m_heapLock);
+
+		if(!pBiggest)
+			break;
+
+		Dispatch(pBiggest);
+	}
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Never blocks.  Called on every Submit, and by the load threads each time they take a
+// file (which makes room).  The queue is only pushed to under the lock, so once Flush
+// has seen the heap empty nothing gets pushed behind the producer's back
+///////////////////////////////////////////////////////////////////////////////////////
+void BatchScheduler::Feed()
+{
+	if(m_window == 0)
+		return;
+
+	EnterCriticalSection(&m_heapLock);
+
+	while(!m_heap.empty())
+	{
+		FbxLibAndFilename *pBiggest = m_heap.front();
+		pBiggest->predictedSec = PredictSeconds(pBiggest->fileSize);
+
+		if(!m_pQueue->TryPush(pBiggest))
+			break;
+
+		PopBiggest();
+	}
+
+	LeaveCriticalSection(&m_heapLock);
+}
+
+
+
+FbxLibAndFilename *BatchScheduler::PopBiggest()
+{
+	pop_heap(m_heap.begin(), m_heap.end(), SmallerFile);
+	FbxLibAndFilename *pBiggest = m_heap.back();
+	m_heap.pop_back();
+
+	return pBiggest;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Stamp the prediction (with the model as calibrated right now) and queue the file
+///////////////////////////////////////////////////////////////////////////////////////
+void BatchScheduler::Dispatch(FbxLibAndFilename *pFbxInfo)
+{
+	pFbxInfo->predictedSec = PredictSeconds(pFbxInfo->fileSize);
+
+	m_pQueue->Push(pFbxInfo); // blocks while the workers are busy
+}
+
+
+
+
+double BatchScheduler::PredictSeconds(unsigned __int64 fileSize)
+{
+	EnterCriticalSection(&m_statsLock);
+	double secPerByte = m_secPerByte;
+	LeaveCriticalSection(&m_statsLock);
+
+	return SCHEDULER_FIXED_COST_SEC + (double) fileSize * secPerByte;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// A worker finished a file: record the error and refine the throughput estimate
+///////////////////////////////////////////////////////////////////////////////////////
+void BatchScheduler::ReportDone(const FbxLibAndFilename *pFbxInfo, double actualSec)
+{
+	LOG_VERBOSE("\t\t%s: %.1f MB, predicted %.3fs, actual %.3fs\n", pFbxInfo->fileName.c_str(),
+			(double) pFbxInfo->fileSize / (1024.0 * 1024.0), pFbxInfo->predictedSec, actualSec);
+
+	EnterCriticalSection(&m_statsLock);
+
+	m_doneCnt++;
+	m_doneBytes += (double) pFbxInfo->fileSize;
+	m_doneSec += actualSec;
+	m_predictedSec += pFbxInfo->predictedSec;
+	m_absErrorSec += fabs(actualSec - pFbxInfo->predictedSec);
+
+	// least squares through the fixed cost: time = fixed + bytes * secPerByte
+	double variableSec = m_doneSec - SCHEDULER_FIXED_COST_SEC * (double) m_doneCnt;
+	if(m_doneBytes > 0.0 && variableSec > 0.0)
+		m_secPerByte = variableSec / m_doneBytes;
+
+	LeaveCriticalSection(&m_statsLock);
+}
+
+
+
+
+void BatchScheduler::PrintSummary(double wallClockSec)
+{
+	if(m_doneCnt == 0)
+		return;
+
+	double mbPerSec = m_secPerByte > 0.0 ? 1.0 / (m_secPerByte * 1024.0 * 1024.0) : 0.0;
+
+	LOG_INFO("\t%u file(s), %.1f MB in %.2fs wall clock (%.2fs of work)\n", (unsigned int) m_doneCnt,
+			m_doneBytes / (1024.0 * 1024.0), wallClockSec, m_doneSec);
+	LOG_INFO("\tCost model: predicted %.2fs total vs %.2fs actual, mean abs error %.3fs/file, fitted throughput %.1f MB/s\n",
+			m_predictedSec, m_doneSec, m_absErrorSec / (double) m_doneCnt, mbPerSec);
+}
@@ -0,0 +1,95 @@
+//
+// Decide in which order the files of a batch get handed to the workers
+//
+
+
+#ifndef __BATCH_SCHEDULER__H
+#define __BATCH_SCHEDULER__H
+
+
+
+//
+// System headers
+//
+#include <vector>
+
+
+//
+// Project headers
+//
+#include "fbxdefs.h"
+#include "WorkQueue.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+//////////////////////////////////////////
+// DEFINES
+//////////////////////////////////////////
+#define SCHEDULER_DEFAULT_WINDOW		4096	// how many files we hold back while the workers are busy, to pick the most expensive one from
+#define SCHEDULER_DEFAULT_MB_PER_SEC	20.0	// starting guess of the processing throughput, refined as files complete
+#define SCHEDULER_FIXED_COST_SEC		0.01	// per file cost that doesn't depend on the size (open, SDK set up, etc)
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Largest-first (LPT) scheduling.  Every file gets a
+// cost estimate from its size on disk, and the most
+// expensive file seen so far is always dispatched
+// first, so that one huge scene doesn't start last and
+// leave every other core idle at the end of the batch.
+//
+// Inputs are streamed, so we can't sort the whole batch.
+// Files go straight to the workers while the input queue
+// has room; only once the pipeline is saturated are they
+// held back, up to 'window' of them, in a max-heap.  Every
+// time a load thread takes a file off the queue, the
+// biggest one held takes its place, so no worker waits
+// while files are held.  A full heap, or the end of the
+// input, releases files too.  A window of 0 keeps the
+// input order.
+//
+// Workers report the actual time every file took; that
+// calibrates the cost model and the predicted vs actual
+// numbers are printed so the model can be checked.
+///////////////////////////////////////////////////////
+class BatchScheduler
+{
+	public:
+		BatchScheduler(WorkQueue<FbxLibAndFilename *> *pQueue, size_t window);
+		~BatchScheduler();
+
+		void Submit(FbxLibAndFilename *pFbxInfo);	// producer thread only
+		void Flush();								// producer thread only. Dispatch everything still held back, most expensive first
+		void Feed();								// any thread: fill the room in the queue with the most expensive files held back
+		void ReportDone(const FbxLibAndFilename *pFbxInfo, double actualSec); // called by the workers
+		void PrintSummary(double wallClockSec);
+
+	private:
+		WorkQueue<FbxLibAndFilename *> *m_pQueue;
+		size_t m_window;
+		CRITICAL_SECTION m_heapLock;
+		vector<FbxLibAndFilename *> m_heap;	// max-heap on fileSize
+
+		// cost model stats, shared with the workers
+		CRITICAL_SECTION m_statsLock;
+		double m_secPerByte;
+		double m_doneBytes;
+		double m_doneSec;
+		double m_predictedSec;
+		double m_absErrorSec;
+		size_t m_doneCnt;
+
+		void Dispatch(FbxLibAndFilename *pFbxInfo);
+		FbxLibAndFilename *PopBiggest();		// under m_heapLock
+		double PredictSeconds(unsigned __int64 fileSize);
+};
+
+
+
+#endif
@@ -0,0 +1,143 @@
+//
+// Instruction set detection, and which version of every kernel runs
+//
+
+
+
+//
+// System headers
+//
+#include <intrin.h>		// __cpuid, _xgetbv
+#include <stdio.h>
+#include <string.h>
+
+
+//
+// Project Includes
+//
+#include "CpuDispatch.h"
+#include "Quantize.h"
+#include "MeshKernels.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DEFINES
+////////////////////////////////////////////////////////////////////////////////////////
+#define XCR0_SSE_AVX		0x06	// xmm and ymm state saved by the OS
+#define XCR0_AVX512			0xe6	// plus opmask and zmm state
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+CpuLevel G_cpuLevel = CPU_LEVEL_SCALAR;
+
+CpuFeatures CpuDispatch::m_features;
+CpuLevel CpuDispatch::m_bestLevel = CPU_LEVEL_SCALAR;
+
+static const char *G_levelNames[CPU_LEVEL_COUNT] = { "scalar", "sse4.1", "avx" };
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Read the features once, before any kernel runs (and before any worker thread starts)
+////////////////////////////////////////////////////////////////////////////////////////
+void CpuDispatch::Init()
+{
+	int info[4];
+	int maxLeaf;
+	unsigned __int64 xcr0 = 0;
+
+	memset(&m_features, 0, sizeof(m_features));
+
+	__cpuid(info, 0);
+	maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	m_features.sse2 = (info[3] & (1 << 26)) != 0;
+	m_features.sse3 = (info[2] & (1 << 0)) != 0;
+	m_features.ssse3 = (info[2] & (1 << 9)) != 0;
+	m_features.sse41 = (info[2] & (1 << 19)) != 0;
+	m_features.sse42 = (info[2] & (1 << 20)) != 0;
+	m_features.popcnt = (info[2] & (1 << 23)) != 0;
+
+	// wide registers are only usable if the OS saves them on a context switch (OSXSAVE, then XCR0)
+	if(info[2] & (1 << 27))
+		xcr0 = _xgetbv(0);
+
+	bool osAvx = (xcr0 & XCR0_SSE_AVX) == XCR0_SSE_AVX;
+	bool osAvx512 = (xcr0 & XCR0_AVX512) == XCR0_AVX512;
+
+	m_features.avx = osAvx && (info[2] & (1 << 28)) != 0;
+	m_features.fma = osAvx && (info[2] & (1 << 12)) != 0;
+
+	if(maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		m_features.avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+		m_features.avx512f = osAvx512 && (info[1] & (1 << 16)) != 0;
+	}
+
+	if(m_features.avx && m_features.sse41)
+		m_bestLevel = CPU_LEVEL_AVX;
+	else if(m_features.sse41)
+		m_bestLevel = CPU_LEVEL_SSE41;
+	else
+		m_bestLevel = CPU_LEVEL_SCALAR;
+
+	G_cpuLevel = m_bestLevel;
+}
+
+
+
+bool CpuDispatch::SetLevel(const char *pName)
+{
+	for(int level = 0; level < CPU_LEVEL_COUNT; level++)
+	{
+		if(strcmp(pName, G_levelNames[level]) == 0)
+		{
+			if(level > m_bestLevel)
+				return false;
+
+			G_cpuLevel = (CpuLevel) level;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+const char *CpuDispatch::GetLevelName(CpuLevel level)
+{
+	return level >= 0 && level < CPU_LEVEL_COUNT ? G_levelNames[level] : "unknown";
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// --cpu-features.  Straight to stdout, like the usage text
+////////////////////////////////////////////////////////////////////////////////////////
+void CpuDispatch::PrintReport()
+{
+	printf("CPU features:");
+	printf("%s%s%s%s%s%s", m_features.sse2 ? " sse2" : "", m_features.sse3 ? " sse3" : "", m_features.ssse3 ? " ssse3" : "",
+			m_features.sse41 ? " sse4.1" : "", m_features.sse42 ? " sse4.2" : "", m_features.popcnt ? " popcnt" : "");
+	printf("%s%s%s%s\n", m_features.avx ? " avx" : "", m_features.fma ? " fma" : "", m_features.avx2 ? " avx2" : "",
+			m_features.avx512f ? " avx512f" : "");
+
+	printf("Best level: %s.  Running at: %s\n", GetLevelName(m_bestLevel), GetLevelName(G_cpuLevel));
+
+	printf("Kernels:\n");
+	printf("\tquantize\t%s\n", GetLevelName(GetQuantizeLevel()));
+	printf("\tweld hash\t%s\n", GetLevelName(GetHashLevel()));
+	printf("\tindex remap\t%s\n", GetLevelName(GetRemapLevel()));
+	printf("\tbounds\t\t%s\n", GetLevelName(GetBoundsLevel()));
+}
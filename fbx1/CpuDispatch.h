@@ -0,0 +1,113 @@
+////////////////////////////////////////////////
+// CPUDISPATCH.H
+//
+// Picks which version of the numeric kernels
+// (rounding, weld hashes, index remapping,
+// bounds) runs on this machine.  Features are
+// read once at startup (cpuid, plus xgetbv to
+// make sure the OS saves the wide registers),
+// and can be capped from the command line
+// (--cpu=level) so results from any machine
+// can be reproduced on any other.
+// Every kernel has a table of versions, one per
+// level, scalar always there; missing ones fall
+// back to the next level down (CpuSelect).
+////////////////////////////////////////////////
+
+
+#ifndef _CPU_DISPATCH_H_
+#define _CPU_DISPATCH_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+// instruction set levels kernels get written for, each one includes the ones before it
+enum CpuLevel
+{
+	CPU_LEVEL_SCALAR,
+	CPU_LEVEL_SSE41,
+	CPU_LEVEL_AVX,
+	CPU_LEVEL_COUNT
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Structs:
+----------------------------------------------------------------------------*/
+
+// what cpuid says.  The avx flags are only set if the OS saves the registers too
+struct CpuFeatures
+{
+	bool sse2, sse3, ssse3, sse41, sse42, popcnt;
+	bool avx, fma, avx2;
+	bool avx512f;
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+extern CpuLevel G_cpuLevel;	// level kernels run at.  Scalar until CpuDispatch::Init runs
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+class CpuDispatch
+{
+	public:
+		static void Init();							// read the features, run at the best level they allow
+		static bool SetLevel(const char *pName);	// cap the level ("scalar", "sse4.1", "avx").  Fails if unknown or not supported here
+		static void PrintReport();					// features found, and the level every kernel runs at
+
+		static const CpuFeatures & GetFeatures() { return m_features; }
+		static CpuLevel GetBestLevel() { return m_bestLevel; }
+		static const char *GetLevelName(CpuLevel level);
+
+	private:
+		static CpuFeatures m_features;
+		static CpuLevel m_bestLevel;
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Templates:
+----------------------------------------------------------------------------*/
+
+// Version of a kernel to call: the one for the current level, or the closest below it.  'pVersions' is
+// indexed by CpuLevel, NULL where there's no version for that level (the scalar one is never NULL)
+template <class Fn>
+inline Fn CpuSelect(Fn const (&pVersions)[CPU_LEVEL_COUNT])
+{
+	int level = G_cpuLevel;
+	while(!pVersions[level])
+		level--;
+	return pVersions[level];
+}
+
+// level CpuSelect ends up at, for reports
+template <class Fn>
+inline CpuLevel CpuSelectedLevel(Fn const (&pVersions)[CPU_LEVEL_COUNT])
+{
+	int level = G_cpuLevel;
+	while(!pVersions[level])
+		level--;
+	return (CpuLevel) level;
+}
+
+
+
+#endif // _CPU_DISPATCH_H_
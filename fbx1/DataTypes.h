@@ -9,6 +9,11 @@
 // sytem includes
 #include <string>
 #include <vector>
+#include <algorithm>	// copy
+#include <math.h>		// floor
+
+// project includes
+#include "SoAArray.h"
 
 
 using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
@@ -75,6 +80,8 @@ struct ColorRGBA
 // bits declaring which fields where found in the data file (Maya file, Fbx file)
 struct UsingFields
 {
+	UsingFields() : vpos(0), vnorm(0), vbinormal(0), vtangent(0), vcolor(0), vtexCoord(0) {}
+
 	unsigned vpos : 1;
 	unsigned vnorm : 1;
 	unsigned vbinormal: 1;
@@ -83,10 +90,121 @@ struct UsingFields
 	unsigned vtexCoord : 1;
 };
 
-// for holding the list of materials each tri will hold
-struct MatList
+// a setting for every kind of vertex value (i.e. rounding precision, weld tolerance), as set with "pos=N,nrm=N,..."
+struct AttributeFloats
 {
-	vector<int> list;
+	float pos;
+	float nrm;
+	float tex;
+	float col;
+	float tan;
+	float bin;
+};
+
+// the materials of every triangle (-1 = no material), stored as compressed sparse rows: triangle t uses
+// ids[offsets[t]] up to ids[offsets[t + 1]].  As long as every triangle has the same number of materials
+// (nearly always exactly one) there's no offsets array at all: triangle t uses ids[t * stride] onwards
+#define MATLISTS_MIXED		-1	// stride of lists that don't all have the same length
+
+class MatLists
+{
+	public:
+		MatLists() : m_triCnt(0), m_stride(0) {}
+
+		size_t size() const { return m_triCnt; }
+		size_t GetIdCount() const { return m_ids.size(); }
+		int GetStride() const { return m_offsets.empty() ? m_stride : MATLISTS_MIXED; }	// materials per triangle
+
+		int GetCount(size_t tri) const { return m_offsets.empty() ? m_stride : (int) (m_offsets[tri + 1] - m_offsets[tri]); }
+		const int *Get(size_t tri) const { return m_ids.empty() ? NULL : &m_ids[0] + (m_offsets.empty() ? tri * m_stride : m_offsets[tri]); }
+		const vector<int> & GetIds() const { return m_ids; } // every triangle's materials, back to back
+
+		// add a triangle using 'cnt' materials
+		void Add(const int *pIds, int cnt)
+		{
+			if(m_offsets.empty() && m_triCnt > 0 && cnt != m_stride)
+				MakeMixed();
+
+			if(m_triCnt == 0)
+				m_stride = cnt;
+
+			m_ids.insert(m_ids.end(), pIds, pIds + cnt);
+			m_triCnt++;
+
+			if(!m_offsets.empty())
+				m_offsets.push_back((unsigned int) m_ids.size());
+		}
+
+		// Make room for 'triCnt' triangles using 'idCnt' materials in all, for Stitch().  'stride' is
+		// the stride of all the lists together (existing ones and the ones about to be stitched)
+		void Resize(size_t triCnt, size_t idCnt, int stride)
+		{
+			if(stride == MATLISTS_MIXED)
+			{
+				MakeMixed();
+				m_offsets.resize(triCnt + 1);
+				m_offsets[triCnt] = (unsigned int) idCnt;
+			}
+			else
+			{
+				m_stride = stride;
+			}
+
+			m_triCnt = triCnt;
+			m_ids.resize(idCnt);
+		}
+
+		// Copy 'src' in, starting at triangle 'atTri' and material 'atId'.  Stitching different spots can
+		// be done on different threads
+		void Stitch(size_t atTri, size_t atId, const MatLists & src)
+		{
+			if(!src.m_ids.empty())
+				copy(src.m_ids.begin(), src.m_ids.end(), m_ids.begin() + atId);
+
+			if(m_offsets.empty())
+				return;
+
+			for(size_t t = 0; t < src.m_triCnt; t++)
+				m_offsets[atTri + t] = (unsigned int) (atId + (src.m_offsets.empty() ? t * src.m_stride : src.m_offsets[t]));
+		}
+
+		// id = newIds[id] for every material id (i.e. once unused materials are gone).  -1 stays -1
+		void RemapIds(const vector<int> & newIds)
+		{
+			for(size_t i = 0; i < m_ids.size(); i++)
+			{
+				if(m_ids[i] >= 0)
+					m_ids[i] = m_ids[i] < (int) newIds.size() ? newIds[m_ids[i]] : -1;
+			}
+		}
+
+		const vector<unsigned int> & GetOffsets() const { return m_offsets; } // empty unless the stride is MATLISTS_MIXED
+
+		void Clear() { m_triCnt = 0; m_stride = 0; m_ids.clear(); m_offsets.clear(); }
+		void swap(MatLists & other)
+		{
+			size_t triCnt = m_triCnt;	m_triCnt = other.m_triCnt;	other.m_triCnt = triCnt;
+			int stride = m_stride;		m_stride = other.m_stride;	other.m_stride = stride;
+			m_ids.swap(other.m_ids);
+			m_offsets.swap(other.m_offsets);
+		}
+
+	private:
+		size_t m_triCnt;
+		int m_stride;				// materials per triangle, while there's no 'm_offsets'
+		vector<int> m_ids;
+		vector<unsigned int> m_offsets;	// triangle count + 1 entries once the triangles stop agreeing on a stride
+
+		// switch to an offsets array, the existing triangles keep their stride
+		void MakeMixed()
+		{
+			if(!m_offsets.empty())
+				return;
+
+			m_offsets.resize(m_triCnt + 1);
+			for(size_t t = 0; t <= m_triCnt; t++)
+				m_offsets[t] = (unsigned int) (t * m_stride);
+		}
 };
 
 // indices into the triangle components.  These correspond 1:1 so that iPos[0] corresponds to iNrm[0], iTex[0], etc.  Done this way for caching performance.
@@ -99,22 +217,77 @@ struct TriList
 	vector<Int3> iCol;
 	vector<Int3> iBin;
 	vector<Int3> iTan;
-	vector<MatList>  iMat; // which material is used by this triangle
+	MatLists iMat; // which materials are used by this triangle
+};
+
+// how vertex values are laid out in a SoAArray: one lane per component
+template <> struct SoATraits<Vec3>
+{
+	enum { LANES = 3 };
+
+	static Vec3 Load(float * const *pLanes, size_t i) { return Vec3(pLanes[0][i], pLanes[1][i], pLanes[2][i]); }
+	static void Store(float * const *pLanes, size_t i, const Vec3 & v) { pLanes[0][i] = v.x; pLanes[1][i] = v.y; pLanes[2][i] = v.z; }
+};
+
+template <> struct SoATraits<TexCoord>
+{
+	enum { LANES = 2 };
+
+	static TexCoord Load(float * const *pLanes, size_t i) { return TexCoord(pLanes[0][i], pLanes[1][i]); }
+	static void Store(float * const *pLanes, size_t i, const TexCoord & uv) { pLanes[0][i] = uv.u; pLanes[1][i] = uv.v; }
+};
+
+template <> struct SoATraits<ColorRGBA>
+{
+	enum { LANES = 4 };
+
+	static ColorRGBA Load(float * const *pLanes, size_t i) { return ColorRGBA(pLanes[0][i], pLanes[1][i], pLanes[2][i], pLanes[3][i]); }
+	static void Store(float * const *pLanes, size_t i, const ColorRGBA & c) { pLanes[0][i] = c.r; pLanes[1][i] = c.g; pLanes[2][i] = c.b; pLanes[3][i] = c.a; }
+};
+
+// components of a vertex in a VertexBuffer, in the order they're laid out
+enum VertexComponent
+{
+	VERTEX_POS,
+	VERTEX_NRM,
+	VERTEX_TEX,
+	VERTEX_COL,
+	VERTEX_TAN,
+	VERTEX_BIN,
+	VERTEX_COMPONENT_COUNT
+};
+
+// One vertex per distinct combination of component indices used by a triangle corner, all its components side
+// by side, and a single index list: what a GPU draws.  Built from the welded data (see VertexBuffer.h)
+struct VertexBuffer
+{
+	VertexBuffer() : stride(0) { for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++) offsets[k] = -1; }
+
+	int offsets[VERTEX_COMPONENT_COUNT];	// where each component starts in a vertex, in floats.  -1 if the vertices don't have it
+	unsigned int stride;					// floats per vertex
+	vector<float> vertices;
+	vector<unsigned int> indices;			// 3 per triangle, in TriList order
 };
 
 struct MeshData
 {
 	// Raw values for all components.  Kept separate for better performance when we weld values later on.
-	vector<Vec3> vPos;
-	vector<Vec3> vNorm;
-	vector<TexCoord> vTex;
-	vector<ColorRGBA> vColor;
-	vector<Vec3> vBinorm;
-	vector<Vec3> vTang;
+	// Stored as structures of arrays (x's, then y's, then z's) so they can be processed 4/8/16 floats at a time
+	SoAArray<Vec3> vPos;
+	SoAArray<Vec3> vNorm;
+	SoAArray<TexCoord> vTex;
+	SoAArray<ColorRGBA> vColor;
+	SoAArray<Vec3> vBinorm;
+	SoAArray<Vec3> vTang;
 
 	UsingFields m_usingFields;
+	UsingFields m_perCorner;	// fields with values recorded per triangle corner (duplicates galore, they need welding).  Values recorded per control point are unique already
 
 	TriList tris;
+
+	Vec3 bbMin, bbMax;			// bounding box of the positions, worked out by WriteData::WeldData
+
+	VertexBuffer vb;			// worked out by WriteData::BuildVertexBuffer, after welding
 };
 
 enum ShadingModel
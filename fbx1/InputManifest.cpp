@@ -0,0 +1,263 @@
+//
+// Collect the list of files to process and hand them to the workers as they are found
+//
+
+
+
+//
+// System headers
+//
+#include <ctype.h>
+#include <string.h>
+
+
+//
+// Project Includes
+//
+#include "InputManifest.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DEFINES
+////////////////////////////////////////////////////////////////////////////////////////
+#define MANIFEST_READ_SIZE	4096	// list files and stdin are read this much at a time.  Longer lines get put back together
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Queue a single file.  The worker that processes it owns (and deletes) the entry.
+// Files already queued are skipped, however their path was written
+///////////////////////////////////////////////////////////////////////////////////////
+void InputManifest::AddFile(const string & filename, unsigned __int64 fileSize)
+{
+	char fullPath[MAX_PATH];
+	DWORD len = GetFullPathNameA(filename.c_str(), MAX_PATH, fullPath, NULL);
+	string key = len > 0 && len < MAX_PATH ? string(fullPath, len) : filename;
+
+	for(size_t i = 0; i < key.length(); i++)
+		key[i] = (char) tolower((unsigned char) key[i]);
+
+	if(!m_queued.insert(key).second)
+	{
+		LOG_WARNING("***  WARNING: %s is listed more than once.  Converted once\n", filename.c_str());
+		return;
+	}
+
+	if(fileSize == FILE_SIZE_UNKNOWN)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attribs;
+
+		// a missing file costs nothing, it will fail to load anyway
+		fileSize = 0;
+		if(GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attribs))
+			fileSize = ((unsigned __int64) attribs.nFileSizeHigh << 32) | attribs.nFileSizeLow;
+	}
+
+	FbxLibAndFilename *pFbxInfo = new FbxLibAndFilename;
+	pFbxInfo->pFbxLib = NULL; // filled in by whichever worker picks up the file
+	pFbxInfo->fileName = filename;
+	pFbxInfo->fileSize = fileSize;
+	pFbxInfo->predictedSec = 0.0; // set by the scheduler on dispatch
+	pFbxInfo->workSec = 0.0;
+	pFbxInfo->pContent = NULL;
+
+	m_pScheduler->Submit(pFbxInfo); // may block while the workers are busy
+	m_fileCnt++;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Read a list of files, one path per line
+///////////////////////////////////////////////////////////////////////////////////////
+bool InputManifest::AddResponseFile(const string & listFilename)
+{
+	FILE *pFile = fopen(listFilename.c_str(), "rt");
+	if(!pFile)
+	{
+		LOG_ERROR("***   Error: unable to open file list \"%s\"\n", listFilename.c_str());
+		return false;
+	}
+
+	AddStream(pFile);
+	fclose(pFile);
+
+	return true;
+}
+
+
+
+
+void InputManifest::AddStream(FILE *pStream)
+{
+	char buf[MANIFEST_READ_SIZE];
+	string line;
+
+	while(fgets(buf, MANIFEST_READ_SIZE, pStream))
+	{
+		line += buf;
+
+		// fgets stops short of the end of a long line: keep reading until we have all of it
+		if(line[line.length() - 1] != '\n' && !feof(pStream))
+			continue;
+
+		AddLine(line);
+		line.clear();
+	}
+
+	// the last line, if the stream broke off in the middle of it
+	if(!line.empty())
+		AddLine(line);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Strip the line of white space and queue it unless it's empty or a comment
+///////////////////////////////////////////////////////////////////////////////////////
+void InputManifest::AddLine(const string & line)
+{
+	size_t st = 0, end = line.length();
+
+	while(end > st && isspace((unsigned char) line[end - 1]))
+		end--;
+
+	while(st < end && isspace((unsigned char) line[st]))
+		st++;
+
+	if(st == end || line[st] == '#')
+		return;
+
+	AddFile(line.substr(st, end - st));
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Recursive directory walk.  Only files matching one of the filters are queued
+///////////////////////////////////////////////////////////////////////////////////////
+bool InputManifest::AddDirectory(const string & dir, const string & filters)
+{
+	DWORD attribs = GetFileAttributesA(dir.c_str());
+	if(attribs == INVALID_FILE_ATTRIBUTES || !(attribs & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		LOG_ERROR("***   Error: \"%s\" is not a directory\n", dir.c_str());
+		return false;
+	}
+
+	// split "*.fbx;*.FBX" into its separate patterns
+	vector<string> filterList;
+	size_t st = 0;
+	while(st <= filters.length())
+	{
+		size_t end = filters.find(';', st);
+		if(end == string::npos)
+			end = filters.length();
+
+		if(end > st)
+			filterList.push_back(filters.substr(st, end - st));
+
+		st = end + 1;
+	}
+
+	// remove trailing separators so we don't end up with "dir\\\\file"
+	string root(dir);
+	while(root.length() > 1 && (root[root.length()-1] == '\\' || root[root.length()-1] == '/'))
+		root.erase(root.length()-1);
+
+	WalkDirectory(root, filterList);
+
+	return true;
+}
+
+
+
+
+void InputManifest::WalkDirectory(const string & dir, const vector<string> & filters)
+{
+	WIN32_FIND_DATAA findData;
+	string searchPath = dir + "\\*";
+
+	HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
+	if(hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		const char *pName = findData.cFileName;
+
+		if(strcmp(pName, ".") == 0 || strcmp(pName, "..") == 0)
+			continue;
+
+		string fullPath = dir + "\\" + pName;
+
+		if(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			// don't follow junctions/symlinks, they can loop back on themselves
+			if(!(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+				WalkDirectory(fullPath, filters);
+
+			continue;
+		}
+
+		for(size_t i=0; i < filters.size(); i++)
+		{
+			if(WildcardMatch(filters[i].c_str(), pName))
+			{
+				AddFile(fullPath, ((unsigned __int64) findData.nFileSizeHigh << 32) | findData.nFileSizeLow);
+				break;
+			}
+		}
+	}
+	while(FindNextFileA(hFind, &findData));
+
+	FindClose(hFind);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Case insensitive glob match ('*' = any run of characters, '?' = any one character)
+///////////////////////////////////////////////////////////////////////////////////////
+bool WildcardMatch(const char *pPattern, const char *pName)
+{
+	const char *pStar = NULL;	// last '*' seen in the pattern
+	const char *pRetry = NULL;	// where in the name to resume when we backtrack to it
+
+	while(*pName)
+	{
+		if(*pPattern == '*')
+		{
+			pStar = pPattern++;
+			pRetry = pName;
+		}
+		else if(*pPattern == '?' || tolower((unsigned char) *pPattern) == tolower((unsigned char) *pName))
+		{
+			pPattern++;
+			pName++;
+		}
+		else if(pStar)
+		{
+			// let the last '*' swallow one more character and try again
+			pPattern = pStar + 1;
+			pName = ++pRetry;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while(*pPattern == '*')
+		pPattern++;
+
+	return *pPattern == '\0';
+}
@@ -0,0 +1,84 @@
+//
+// Collect the list of files to process and hand them to the workers as they are found
+//
+
+
+#ifndef __INPUT_MANIFEST__H
+#define __INPUT_MANIFEST__H
+
+
+
+//
+// System headers
+//
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+
+
+//
+// Project headers
+//
+#include "fbxdefs.h"
+#include "BatchScheduler.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+//////////////////////////////////////////
+// DEFINES
+//////////////////////////////////////////
+#define FILE_SIZE_UNKNOWN	((unsigned __int64) -1)	// AddFile() asks the file system
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Files can come from the command line, from a
+// response file ("@list.txt"), from stdin ("-", one
+// path per line) or from a recursive directory walk
+// with glob filters.  Every file is handed to the
+// scheduler as soon as it is found, so the workers start
+// converting while the list is still being read.  The
+// scheduler only holds a bounded window of files, so a
+// huge directory tree never ends up fully listed in memory.
+// A file that shows up twice (listed and found by a walk,
+// say) is only queued once: both copies would write the
+// same output file.
+///////////////////////////////////////////////////////
+class InputManifest
+{
+	public:
+		InputManifest(BatchScheduler *pScheduler) : m_pScheduler(pScheduler), m_fileCnt(0) {}
+
+		void AddFile(const string & filename, unsigned __int64 fileSize = FILE_SIZE_UNKNOWN);
+		bool AddResponseFile(const string & listFilename);			// one path per line, '#' starts a comment line
+		void AddStream(FILE *pStream);								// one path per line (i.e. stdin)
+		bool AddDirectory(const string & dir, const string & filters);	// recursive. filters are ';' separated globs, i.e. "*.fbx;*.obj"
+
+		size_t GetFileCount() { return m_fileCnt; }
+
+	private:
+		BatchScheduler *m_pScheduler;
+		size_t m_fileCnt;
+		set<string> m_queued;	// full paths, lower case, of every file queued so far
+
+		void WalkDirectory(const string & dir, const vector<string> & filters);
+		void AddLine(const string & line);
+};
+
+
+
+//
+// Case insensitive glob match.  Supports '*' and '?'
+//
+bool WildcardMatch(const char *pPattern, const char *pName);
+
+
+
+#endif
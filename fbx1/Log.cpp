@@ -0,0 +1,554 @@
+//
+// Thread safe, asynchronous logging
+//
+
+
+
+//
+// System headers
+//
+#include <process.h> // thread library ('_beginthreadex')
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+
+//
+// Project Includes
+//
+#include "Log.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// TYPES
+////////////////////////////////////////////////////////////////////////////////////////
+
+// One message waiting to be printed
+struct LogRecord
+{
+	LONG seq;						// global order the messages were written in
+	LogLevel level;
+	const char *pFormat;
+	int argCnt;
+	LogArg args[LOG_MAX_ARGS];		// string arguments point into 'text'
+	char text[LOG_TEXT_SIZE];		// tag first, then the string arguments
+};
+
+
+
+// Messages written by one thread.  Only that thread moves 'head', only the writer thread moves 'tail'
+struct LogRing
+{
+	LogRecord records[LOG_RING_SIZE];
+	volatile LONG head;		// next record to fill
+	volatile LONG tail;		// next record to print
+	LogRing *pNext;
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+LogLevel G_logLevel = LOG_LEVEL_INFO;
+
+static const char *G_levelNames[LOG_LEVEL_COUNT] = { "error", "warning", "info", "verbose" };
+
+static volatile LONG G_logSeq = 0;
+static LogRing * volatile G_pRings = NULL;	// every thread that ever logged, newest first
+static CRITICAL_SECTION G_ringsCS;			// adding rings, and printing right away when the writer isn't running
+static bool G_bCSReady = false;
+static volatile LONG G_bRunning = 0;		// writer thread up
+static volatile LONG G_bStopping = 0;
+static HANDLE G_hWriterThread = NULL;
+static HANDLE G_hWakeWriter = NULL;
+static bool G_bAtLineStart = true;			// only touched by whoever is printing
+
+static __declspec(thread) LogRing *T_pRing = NULL;
+static __declspec(thread) char T_tag[LOG_TAG_SIZE] = "";
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// FORMATTING
+////////////////////////////////////////////////////////////////////////////////////////
+
+// printf one conversion.  'spec' is the conversion without its length modifier, 'conv' its letter.
+// Integers are 32 bits wide, as printf would take them, unless 'wide' (ll, I64, ...)
+static void FormatArg(const string & spec, char conv, bool wide, const LogArg & arg, string & out)
+{
+	char buf[512];
+	string fmt = spec;
+
+	switch(conv)
+	{
+		case 'd': case 'i':
+		case 'u': case 'x': case 'X': case 'o':
+		{
+			__int64 value = arg.i;
+			if(arg.type == LogArg::ARG_DOUBLE)
+				value = (__int64) arg.d;
+			else if(arg.type == LogArg::ARG_STRING || arg.type == LogArg::ARG_POINTER)
+				value = (__int64) (size_t) arg.p;
+
+			// i.e. -1 for a %x is ffffffff, not ffffffffffffffff
+			if(!wide)
+				value = (conv == 'd' || conv == 'i') ? (__int64) (int) value : (__int64) (unsigned int) value;
+
+			fmt += "ll";
+			fmt += conv;
+			_snprintf(buf, sizeof(buf), fmt.c_str(), value);
+			break;
+		}
+
+		case 'c':
+			fmt += conv;
+			_snprintf(buf, sizeof(buf), fmt.c_str(), (int) arg.i);
+			break;
+
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		{
+			double value = arg.d;
+			if(arg.type == LogArg::ARG_INT)
+				value = (double) arg.i;
+			else if(arg.type == LogArg::ARG_UINT)
+				value = (double) (unsigned __int64) arg.i;
+
+			fmt += conv;
+			_snprintf(buf, sizeof(buf), fmt.c_str(), value);
+			break;
+		}
+
+		case 's':
+			fmt += conv;
+			_snprintf(buf, sizeof(buf), fmt.c_str(), arg.type == LogArg::ARG_STRING ? arg.s : "(?)");
+			break;
+
+		default: // 'p' and anything we don't know
+			fmt += 'p';
+			_snprintf(buf, sizeof(buf), fmt.c_str(), arg.p);
+			break;
+	}
+
+	buf[sizeof(buf) - 1] = 0; // _snprintf doesn't terminate when it truncates
+	out += buf;
+}
+
+
+
+// The message, as printf would have printed it
+static void FormatRecord(const LogRecord & record, string & out)
+{
+	const char *p = record.pFormat;
+	int arg = 0;
+
+	while(*p)
+	{
+		if(*p != '%')
+		{
+			out += *p++;
+			continue;
+		}
+
+		if(p[1] == '%')
+		{
+			out += '%';
+			p += 2;
+			continue;
+		}
+
+		// flags, width, precision
+		string spec = "%";
+		p++;
+		while(*p && strchr("-+ #0123456789.", *p))
+			spec += *p++;
+
+		// length modifiers: we know the real type of the argument, they only say how wide an integer is
+		string length;
+		while(*p && strchr("hlLqjzt", *p))
+			length += *p++;
+
+		bool wide = length.find("ll") != string::npos || length.find_first_of("Lqj") != string::npos ||
+					(length.find_first_of("zt") != string::npos && sizeof(size_t) > 4);
+
+		if(p[0] == 'I' && p[1] == '6' && p[2] == '4')
+		{
+			wide = true;
+			p += 3;
+		}
+		else if(p[0] == 'I' && p[1] == '3' && p[2] == '2')
+		{
+			p += 3;
+		}
+		else if(p[0] == 'I')
+		{
+			wide = sizeof(size_t) > 4;
+			p++;
+		}
+
+		if(!*p)
+			break;
+
+		char conv = *p++;
+		if(arg < record.argCnt)
+			FormatArg(spec, conv, wide, record.args[arg++], out);
+	}
+}
+
+
+
+// Append the message, every line tagged with the file it's about
+static void PrintRecord(const LogRecord & record, string & out)
+{
+	string text;
+	FormatRecord(record, text);
+
+	const char *pTag = record.text;
+
+	for(size_t i = 0; i < text.size(); i++)
+	{
+		if(G_bAtLineStart && text[i] != '\n' && *pTag)
+		{
+			out += '[';
+			out += pTag;
+			out += "] ";
+		}
+
+		out += text[i];
+		G_bAtLineStart = text[i] == '\n';
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// WRITER THREAD
+////////////////////////////////////////////////////////////////////////////////////////
+
+// Print everything queued so far, oldest first.  Returns false if there was nothing
+static bool Drain()
+{
+	string out;
+	bool any = false;
+
+	for(;;)
+	{
+		// the ring whose oldest message is the oldest of all
+		LogRing *pOldest = NULL;
+		LONG oldestSeq = 0;
+
+		for(LogRing *pRing = G_pRings; pRing; pRing = pRing->pNext)
+		{
+			if(pRing->tail == pRing->head)
+				continue;
+
+			LONG seq = pRing->records[pRing->tail & (LOG_RING_SIZE - 1)].seq;
+			if(!pOldest || (LONG) (seq - oldestSeq) < 0)
+			{
+				pOldest = pRing;
+				oldestSeq = seq;
+			}
+		}
+
+		if(!pOldest)
+			break;
+
+		MemoryBarrier(); // read the record only after seeing 'head' move past it
+		PrintRecord(pOldest->records[pOldest->tail & (LOG_RING_SIZE - 1)], out);
+		InterlockedExchange(&pOldest->tail, pOldest->tail + 1);
+		any = true;
+
+		if(out.size() > 64 * 1024)
+		{
+			fwrite(out.data(), 1, out.size(), stdout);
+			out.clear();
+		}
+	}
+
+	if(!out.empty())
+		fwrite(out.data(), 1, out.size(), stdout);
+	if(any)
+		fflush(stdout);
+
+	return any;
+}
+
+
+
+static unsigned int __stdcall WriterThread(void *)
+{
+	while(!G_bStopping)
+	{
+		WaitForSingleObject(G_hWakeWriter, LOG_FLUSH_MS);
+		Drain();
+	}
+
+	while(Drain())
+		;
+
+	return 0;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// LOG
+////////////////////////////////////////////////////////////////////////////////////////
+void Log::Start()
+{
+	if(!G_bCSReady)
+	{
+		InitializeCriticalSection(&G_ringsCS);
+		G_bCSReady = true;
+	}
+
+	if(G_bRunning)
+		return;
+
+	G_bStopping = 0;
+	G_hWakeWriter = CreateEvent(NULL, FALSE, FALSE, NULL); // auto reset
+	G_hWriterThread = (HANDLE) _beginthreadex(NULL, 0, WriterThread, NULL, 0, NULL);
+
+	if(!G_hWriterThread)
+	{
+		CloseHandle(G_hWakeWriter);
+		G_hWakeWriter = NULL;
+		return; // messages get printed right away then
+	}
+
+	InterlockedExchange(&G_bRunning, 1);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Every other thread must be done logging: the rings go away
+////////////////////////////////////////////////////////////////////////////////////////
+void Log::Stop()
+{
+	if(!G_bRunning)
+		return;
+
+	InterlockedExchange(&G_bStopping, 1);
+	SetEvent(G_hWakeWriter);
+	WaitForSingleObject(G_hWriterThread, INFINITE);
+	CloseHandle(G_hWriterThread);
+	CloseHandle(G_hWakeWriter);
+	G_hWriterThread = NULL;
+	G_hWakeWriter = NULL;
+
+	InterlockedExchange(&G_bRunning, 0);
+
+	while(G_pRings)
+	{
+		LogRing *pRing = G_pRings;
+		G_pRings = pRing->pNext;
+		delete pRing;
+	}
+
+	T_pRing = NULL;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Copy the message into this thread's ring (or print it if there's no writer thread)
+////////////////////////////////////////////////////////////////////////////////////////
+void Log::Queue(LogLevel level, const char *pFormat, const LogArg *pArgs, int argCnt)
+{
+	LogRecord local;
+	LogRecord *pRecord = &local;
+	LogRing *pRing = NULL;
+
+	if(G_bRunning)
+	{
+		pRing = T_pRing;
+		if(!pRing)
+		{
+			pRing = new LogRing;
+			pRing->head = 0;
+			pRing->tail = 0;
+
+			EnterCriticalSection(&G_ringsCS);
+			pRing->pNext = G_pRings;
+			G_pRings = pRing; // the writer only ever reads the list, a new head is fine
+			LeaveCriticalSection(&G_ringsCS);
+
+			T_pRing = pRing;
+		}
+
+		// full: let the writer catch up (better slow than losing messages)
+		while(pRing->head - pRing->tail >= LOG_RING_SIZE)
+		{
+			SetEvent(G_hWakeWriter);
+			SwitchToThread();
+		}
+
+		pRecord = &pRing->records[pRing->head & (LOG_RING_SIZE - 1)];
+	}
+
+	pRecord->level = level;
+	pRecord->pFormat = pFormat;
+	pRecord->argCnt = argCnt;
+
+	// tag, then the strings: they may be gone by the time the message gets printed
+	size_t used = strlen(T_tag) + 1;
+	memcpy(pRecord->text, T_tag, used);
+
+	for(int i = 0; i < argCnt; i++)
+	{
+		pRecord->args[i] = pArgs[i];
+		if(pArgs[i].type != LogArg::ARG_STRING)
+			continue;
+
+		// out of room: the rest get the empty string that ends the text
+		if(used >= LOG_TEXT_SIZE)
+		{
+			pRecord->args[i].s = pRecord->text + LOG_TEXT_SIZE - 1;
+			continue;
+		}
+
+		size_t len = strlen(pArgs[i].s);
+		size_t room = LOG_TEXT_SIZE - used - 1;
+		if(len > room)
+			len = room;
+
+		memcpy(pRecord->text + used, pArgs[i].s, len);
+		pRecord->text[used + len] = 0;
+		pRecord->args[i].s = pRecord->text + used;
+		used += len + 1;
+	}
+
+	pRecord->seq = InterlockedIncrement(&G_logSeq);
+
+	if(pRing)
+	{
+		InterlockedExchange(&pRing->head, pRing->head + 1); // publishes the record
+		if(level <= LOG_LEVEL_WARNING)
+			SetEvent(G_hWakeWriter);
+		return;
+	}
+
+	string out;
+	if(G_bCSReady)
+		EnterCriticalSection(&G_ringsCS);
+	PrintRecord(*pRecord, out);
+	fwrite(out.data(), 1, out.size(), stdout);
+	if(G_bCSReady)
+		LeaveCriticalSection(&G_ringsCS);
+}
+
+
+
+void Log::Write(LogLevel level, const char *pFormat)
+{
+	Queue(level, pFormat, NULL, 0);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0)
+{
+	LogArg args[] = { a0 };
+	Queue(level, pFormat, args, 1);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1)
+{
+	LogArg args[] = { a0, a1 };
+	Queue(level, pFormat, args, 2);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2)
+{
+	LogArg args[] = { a0, a1, a2 };
+	Queue(level, pFormat, args, 3);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3)
+{
+	LogArg args[] = { a0, a1, a2, a3 };
+	Queue(level, pFormat, args, 4);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4)
+{
+	LogArg args[] = { a0, a1, a2, a3, a4 };
+	Queue(level, pFormat, args, 5);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5)
+{
+	LogArg args[] = { a0, a1, a2, a3, a4, a5 };
+	Queue(level, pFormat, args, 6);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5, LogArg a6)
+{
+	LogArg args[] = { a0, a1, a2, a3, a4, a5, a6 };
+	Queue(level, pFormat, args, 7);
+}
+
+void Log::Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5, LogArg a6, LogArg a7)
+{
+	LogArg args[] = { a0, a1, a2, a3, a4, a5, a6, a7 };
+	Queue(level, pFormat, args, 8);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Tags are per thread: a task carries its submitter's tag (see TaskScheduler)
+////////////////////////////////////////////////////////////////////////////////////////
+void Log::SetTag(const char *pName)
+{
+	if(!pName)
+	{
+		T_tag[0] = 0;
+		return;
+	}
+
+	if(pName == T_tag)
+		return;
+
+	const char *pSlash = strrchr(pName, '\\');
+	const char *pOther = strrchr(pName, '/');
+	if(pOther > pSlash)
+		pSlash = pOther;
+	if(pSlash)
+		pName = pSlash + 1;
+
+	strncpy(T_tag, pName, LOG_TAG_SIZE - 1);
+	T_tag[LOG_TAG_SIZE - 1] = 0;
+}
+
+
+
+const char *Log::GetTag()
+{
+	return T_tag;
+}
+
+
+
+bool Log::ParseLevel(const char *pName, LogLevel & level)
+{
+	for(int i = 0; i < LOG_LEVEL_COUNT; i++)
+	{
+		if(_stricmp(pName, G_levelNames[i]) == 0)
+		{
+			level = (LogLevel) i;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////
+// LOG.H
+//
+// Thread safe, asynchronous logging.
+// Every thread writes its messages to its own
+// ring buffer (single producer/single consumer,
+// no locks); a background thread drains all the
+// rings, formats the messages and prints them.
+// Formatting is deferred: a message is stored as
+// its format string plus its raw arguments, so
+// the thread logging it only pays for a copy.
+// Messages below the current level are skipped
+// by the LOG_* macros before their arguments are
+// even evaluated: a single branch.
+// Every line is tagged with the file the thread
+// was working on (Log::SetTag), so the output of
+// files processed at the same time stays apart.
+////////////////////////////////////////////////
+
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define LOG_MAX_ARGS		8		// arguments per message
+#define LOG_TEXT_SIZE		192		// per message: tag + copies of the string arguments (truncated beyond)
+#define LOG_TAG_SIZE		48		// file tag, truncated beyond
+#define LOG_RING_SIZE		512		// messages per thread waiting to be printed (power of 2)
+#define LOG_FLUSH_MS		20		// the writer thread wakes up at least this often
+
+
+
+
+/*----------------------------------------------------------------------------
+	Enums:
+----------------------------------------------------------------------------*/
+
+enum LogLevel
+{
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_INFO,		// default
+	LOG_LEVEL_VERBOSE,	// -v
+	LOG_LEVEL_COUNT
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+extern LogLevel G_logLevel;	// messages above this level are dropped
+
+
+
+
+/*----------------------------------------------------------------------------
+	Macros:
+----------------------------------------------------------------------------*/
+
+#define LOG_ENABLED(level)	((level) <= G_logLevel)
+
+// arguments aren't evaluated unless the message is going to be printed
+#define LOG(level, ...)		do { if(LOG_ENABLED(level)) Log::Write(level, __VA_ARGS__); } while(0)
+#define LOG_ERROR(...)		LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARNING(...)	LOG(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_INFO(...)		LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_VERBOSE(...)	LOG(LOG_LEVEL_VERBOSE, __VA_ARGS__)
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+// One argument of a message, stored raw.  Converts from anything printf would take
+class LogArg
+{
+	public:
+		enum Type { ARG_INT, ARG_UINT, ARG_DOUBLE, ARG_STRING, ARG_POINTER };
+
+		LogArg() : type(ARG_INT) { i = 0; }
+		LogArg(int v) : type(ARG_INT) { i = v; }
+		LogArg(long v) : type(ARG_INT) { i = v; }
+		LogArg(__int64 v) : type(ARG_INT) { i = v; }
+		LogArg(unsigned int v) : type(ARG_UINT) { i = (__int64) v; }
+		LogArg(unsigned long v) : type(ARG_UINT) { i = (__int64) v; }
+		LogArg(unsigned __int64 v) : type(ARG_UINT) { i = (__int64) v; }
+		LogArg(double v) : type(ARG_DOUBLE) { d = v; }
+		LogArg(const char *v) : type(ARG_STRING) { s = v ? v : "(null)"; }
+		LogArg(const void *v) : type(ARG_POINTER) { p = v; }
+
+		Type type;
+		union
+		{
+			__int64 i;
+			double d;
+			const char *s;	// copied into the message when it's queued
+			const void *p;
+		};
+};
+
+
+
+class Log
+{
+	public:
+		static void Start();	// start the writer thread.  Until then (and after Stop) messages are printed right away
+		static void Stop();		// print everything still queued and stop the writer thread
+
+		// 'pFormat' is printf style and must stay valid for the whole run (a literal): only a pointer to it is kept
+		static void Write(LogLevel level, const char *pFormat);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5, LogArg a6);
+		static void Write(LogLevel level, const char *pFormat, LogArg a0, LogArg a1, LogArg a2, LogArg a3, LogArg a4, LogArg a5, LogArg a6, LogArg a7);
+
+		// Tag every following message of this thread with 'pName' (path stripped).  NULL = no tag
+		static void SetTag(const char *pName);
+		static const char *GetTag();	// this thread's tag, "" if none.  Valid until the thread changes it
+
+		static bool ParseLevel(const char *pName, LogLevel & level);	// "error", "warning", "info" or "verbose"
+
+	private:
+		static void Queue(LogLevel level, const char *pFormat, const LogArg *pArgs, int argCnt);
+};
+
+
+
+#endif // _LOG_H_
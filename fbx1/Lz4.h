@@ -0,0 +1,269 @@
+////////////////////////////////////////////////
+// LZ4.H
+//
+// LZ4 block format, compressor and decompressor,
+// small enough to keep in the tree instead of
+// linking the library.  Output is plain LZ4
+// blocks: anything that reads LZ4 reads them.
+// - compressor: greedy, one 4K entry hash table
+//   of 4 byte sequences (16KB on the stack).
+//   Moves on faster and faster through data
+//   that doesn't compress, like the reference
+//   one's fast mode
+// - decompressor: checks every length against
+//   both buffers, so a damaged block fails
+//   instead of writing out of bounds
+////////////////////////////////////////////////
+
+
+#ifndef _LZ4_H_
+#define _LZ4_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <string.h>		// memcpy
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5		// a block always ends with this many literals
+#define LZ4_MATCH_LIMIT		12		// and no match starts in its last 12 bytes
+#define LZ4_MAX_OFFSET		65535
+#define LZ4_HASH_BITS		12
+#define LZ4_SKIP_TRIGGER	6		// misses in a row before the step grows (2^this)
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// worst case size of 'size' bytes once compressed (nothing matched)
+inline size_t Lz4CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+
+
+inline unsigned int Lz4Read32(const unsigned char *p)
+{
+	unsigned int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+
+inline unsigned int Lz4Hash(unsigned int sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+
+
+// length byte(s) past the 15 that fit in the token
+inline unsigned char *Lz4WriteLength(unsigned char *op, size_t length)
+{
+	for(; length >= 255; length -= 255)
+		*op++ = 255;
+
+	*op++ = (unsigned char) length;
+	return op;
+}
+
+
+
+// literals, then a match (matchLength 0 = the last sequence, no match).  NULL if it doesn't fit
+inline unsigned char *Lz4WriteSequence( unsigned char *op, const unsigned char *opEnd, const unsigned char *pLiterals, size_t literalCnt,
+										size_t offset, size_t matchLength )
+{
+	size_t worst = 1 + literalCnt / 255 + 1 + literalCnt + (matchLength ? 2 + (matchLength - LZ4_MIN_MATCH) / 255 + 1 : 0);
+	if( worst > (size_t) (opEnd - op) )
+		return NULL;
+
+	unsigned char *pToken = op++;
+	size_t matchCode = matchLength ? matchLength - LZ4_MIN_MATCH : 0;
+
+	*pToken = (unsigned char) (((literalCnt < 15 ? literalCnt : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+	if( literalCnt >= 15 )
+		op = Lz4WriteLength(op, literalCnt - 15);
+
+	if( literalCnt )
+		memcpy(op, pLiterals, literalCnt);
+	op += literalCnt;
+
+	if( matchLength )
+	{
+		*op++ = (unsigned char) offset;
+		*op++ = (unsigned char) (offset >> 8);
+
+		if( matchCode >= 15 )
+			op = Lz4WriteLength(op, matchCode - 15);
+	}
+
+	return op;
+}
+
+
+
+/** Compress 'srcSize' bytes (up to 4GB) into one LZ4 block.  Returns the compressed size,
+ * or 0 if it doesn't fit in 'dstCapacity' bytes (i.e. pass srcSize - 1 to only keep
+ * blocks that got smaller)
+ */
+inline size_t Lz4Compress(const void *pSrc, size_t srcSize, void *pDst, size_t dstCapacity)
+{
+	const unsigned char * const src = (const unsigned char *) pSrc;
+	unsigned char *op = (unsigned char *) pDst;
+	const unsigned char * const opEnd = op + dstCapacity;
+
+	size_t anchor = 0;	// first literal not written yet
+
+	if( srcSize > LZ4_MATCH_LIMIT )
+	{
+		const size_t matchStartEnd = srcSize - LZ4_MATCH_LIMIT;	// matches start before this
+		const size_t matchEnd = srcSize - LZ4_LAST_LITERALS;		// and end by this
+		unsigned int table[1 << LZ4_HASH_BITS];	// position + 1 of the last sequence seen with each hash, 0 = none
+		size_t ip = 0;
+		size_t misses = 1 << LZ4_SKIP_TRIGGER;
+
+		memset(table, 0, sizeof(table));
+
+		while( ip < matchStartEnd )
+		{
+			unsigned int sequence = Lz4Read32(src + ip);
+			unsigned int h = Lz4Hash(sequence);
+			size_t ref = table[h];
+
+			table[h] = (unsigned int) (ip + 1);
+
+			if( ref == 0 || ip - (ref - 1) > LZ4_MAX_OFFSET || Lz4Read32(src + ref - 1) != sequence )
+			{
+				ip += misses++ >> LZ4_SKIP_TRIGGER;
+				continue;
+			}
+
+			ref--;
+			misses = 1 << LZ4_SKIP_TRIGGER;
+
+			// back over matching bytes before, as far as the literals go
+			while( ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1] )
+			{
+				ip--;
+				ref--;
+			}
+
+			size_t length = LZ4_MIN_MATCH;
+			while( ip + length < matchEnd && src[ref + length] == src[ip + length] )
+				length++;
+
+			op = Lz4WriteSequence(op, opEnd, src + anchor, ip - anchor, ip - ref, length);
+			if( !op )
+				return 0;
+
+			ip += length;
+			anchor = ip;
+
+			// the position just before the next search, so runs keep matching
+			if( ip - 2 < matchStartEnd )
+				table[Lz4Hash(Lz4Read32(src + ip - 2))] = (unsigned int) (ip - 1);
+		}
+	}
+
+	op = Lz4WriteSequence(op, opEnd, src + anchor, srcSize - anchor, 0, 0);
+	if( !op )
+		return 0;
+
+	return op - (unsigned char *) pDst;
+}
+
+
+
+/** Decompress one LZ4 block into exactly 'dstSize' bytes.  Returns false if the block is
+ * damaged or doesn't decompress to that size
+ */
+inline bool Lz4Decompress(const void *pSrc, size_t srcSize, void *pDst, size_t dstSize)
+{
+	const unsigned char *ip = (const unsigned char *) pSrc;
+	const unsigned char * const ipEnd = ip + srcSize;
+	unsigned char * const dst = (unsigned char *) pDst;
+	size_t op = 0;
+
+	while( ip < ipEnd )
+	{
+		unsigned int token = *ip++;
+
+		// literals
+		size_t length = token >> 4;
+		if( length == 15 )
+		{
+			unsigned int b;
+			do
+			{
+				if( ip >= ipEnd )
+					return false;
+				b = *ip++;
+				length += b;
+			} while( b == 255 );
+		}
+
+		if( length > (size_t) (ipEnd - ip) || length > dstSize - op )
+			return false;
+
+		memcpy(dst + op, ip, length);
+		ip += length;
+		op += length;
+
+		// the last sequence has no match
+		if( ip == ipEnd )
+			break;
+
+		if( ipEnd - ip < 2 )
+			return false;
+
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if( offset == 0 || offset > op )
+			return false;
+
+		length = (token & 15) + LZ4_MIN_MATCH;
+		if( (token & 15) == 15 )
+		{
+			unsigned int b;
+			do
+			{
+				if( ip >= ipEnd )
+					return false;
+				b = *ip++;
+				length += b;
+			} while( b == 255 );
+		}
+
+		if( length > dstSize - op )
+			return false;
+
+		// may overlap what it's writing (offset < length repeats the last bytes): byte by byte
+		const unsigned char *pMatch = dst + op - offset;
+		for( size_t i = 0; i < length; ++i )
+			dst[op + i] = pMatch[i];
+		op += length;
+	}
+
+	return op == dstSize;
+}
+
+
+
+#endif // _LZ4_H_
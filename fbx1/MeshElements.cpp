@@ -0,0 +1,207 @@
+//
+// Layer elements of a mesh (colors, uv's, normals, etc) resolved once per mesh
+//
+
+
+
+//
+// Project Includes
+//
+#include "MeshElements.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+static const int G_firstMaterial = 0; // for meshes with materials but no material element
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Find the elements of the mesh we can read.  When there are several layers of the
+// same kind, the last one we can read wins (that's the one the triangles always ended
+// up pointing to)
+///////////////////////////////////////////////////////////////////////////////////////
+MeshElements::MeshElements(FbxMesh *pMesh, int materialCnt)
+{
+	int l;
+
+	for(l = 0; l < pMesh->GetElementVertexColorCount(); l++)
+	{
+		ElementAccessor<FbxColor> accessor;
+		if(accessor.Init(pMesh->GetElementVertexColor(l), pMesh, true))
+		{
+			color.Release();
+			color = accessor;
+		}
+	}
+
+	for(l = 0; l < pMesh->GetElementUVCount(); l++)
+	{
+		ElementAccessor<FbxVector2> accessor;
+		if(accessor.Init(pMesh->GetElementUV(l), pMesh, true))
+		{
+			uv.Release();
+			uv = accessor;
+		}
+	}
+
+	// normals, tangents and binormals are only read per polygon vertex
+	for(l = 0; l < pMesh->GetElementNormalCount(); l++)
+	{
+		ElementAccessor<FbxVector4> accessor;
+		if(accessor.Init(pMesh->GetElementNormal(l), pMesh, false))
+		{
+			normal.Release();
+			normal = accessor;
+		}
+	}
+
+	for(l = 0; l < pMesh->GetElementTangentCount(); l++)
+	{
+		ElementAccessor<FbxVector4> accessor;
+		if(accessor.Init(pMesh->GetElementTangent(l), pMesh, false))
+		{
+			tangent.Release();
+			tangent = accessor;
+		}
+	}
+
+	for(l = 0; l < pMesh->GetElementBinormalCount(); l++)
+	{
+		ElementAccessor<FbxVector4> accessor;
+		if(accessor.Init(pMesh->GetElementBinormal(l), pMesh, false))
+		{
+			binormal.Release();
+			binormal = accessor;
+		}
+	}
+
+	// every material element gives each polygon one more material
+	for(l = 0; l < pMesh->GetElementMaterialCount(); l++)
+	{
+		MaterialAccessor accessor;
+		if(accessor.Init(pMesh->GetElementMaterial(l), pMesh, materialCnt))
+			materials.push_back(accessor);
+	}
+
+	// no material element at all: one material for the entire mesh, easy
+	if(pMesh->GetElementMaterialCount() == 0 && materialCnt > 0)
+	{
+		materials.push_back(MaterialAccessor());
+		materials.back().InitFirstMaterial();
+	}
+}
+
+
+
+MeshElements::~MeshElements()
+{
+	color.Release();
+	uv.Release();
+	normal.Release();
+	tangent.Release();
+	binormal.Release();
+
+	for(size_t i = 0; i < materials.size(); i++)
+		materials[i].Release();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Positions always come from the control points, the rest depends on what we found
+///////////////////////////////////////////////////////////////////////////////////////
+UsingFields MeshElements::GetUsingFields() const
+{
+	UsingFields fields;
+
+	fields.vpos = 1;
+	fields.vcolor = color.IsValid();
+	fields.vtexCoord = uv.IsValid();
+	fields.vnorm = normal.IsValid();
+	fields.vtangent = tangent.IsValid();
+	fields.vbinormal = binormal.IsValid();
+
+	return fields;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Material elements are either one material for the whole mesh or one per polygon
+///////////////////////////////////////////////////////////////////////////////////////
+bool MaterialAccessor::Init(FbxGeometryElementMaterial *pElement, FbxMesh *pMesh, int materialCnt)
+{
+	int needed;
+
+	Release();
+
+	if(!pElement)
+		return false;
+
+	switch(pElement->GetMappingMode())
+	{
+		case FbxGeometryElement::eAllSame:
+			m_stride = 0;
+			needed = 1;
+			break;
+
+		case FbxGeometryElement::eByPolygon:
+			m_stride = 1;
+			needed = pMesh->GetPolygonCount();
+			break;
+
+		default:
+			return false; // other mapping modes don't make sense for materials
+	}
+
+	FbxLayerElementArrayTemplate<int> & index = pElement->GetIndexArray();
+
+	if(index.GetCount() < needed)
+	{
+		LOG_WARNING("***  WARNING: material element in mesh %s is too short (%d indices for %d).  Element ignored\n", pMesh->GetName(), index.GetCount(), needed);
+		return false;
+	}
+
+	m_pIndexArray = &index;
+	m_pIndices = index.GetLocked(FbxLayerElementArray::eReadLock);
+
+	for(int i = 0; i < needed; i++)
+	{
+		if(m_pIndices[i] < 0 || m_pIndices[i] >= materialCnt)
+		{
+			LOG_WARNING("***  WARNING: material element in mesh %s has an index out of range (%d).  Element ignored\n", pMesh->GetName(), m_pIndices[i]);
+			Release();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+void MaterialAccessor::InitFirstMaterial()
+{
+	Release();
+
+	m_pIndices = &G_firstMaterial;
+	m_stride = 0;
+}
+
+
+
+void MaterialAccessor::Release()
+{
+	if(m_pIndexArray && m_pIndices)
+		m_pIndexArray->Release((int **) &m_pIndices);
+
+	m_pIndices = NULL;
+	m_pIndexArray = NULL;
+}
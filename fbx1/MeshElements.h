@@ -0,0 +1,230 @@
+//
+// Layer elements of a mesh (colors, uv's, normals, etc) resolved once per mesh
+//
+
+
+#ifndef __MESH_ELEMENTS__H
+#define __MESH_ELEMENTS__H
+
+
+
+//
+// System headers
+//
+#include <vector>
+
+
+//
+// Fbx library headers
+//
+#include "fbxdefs.h"
+
+
+//
+// Project headers
+//
+#include "DataTypes.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Reading a layer element through the SDK means going
+// through its mapping mode, its reference mode and
+// GetDirectArray().GetAt() for every single corner.
+// Instead, every element is checked once per mesh and
+// its arrays locked, so reading a value is a couple
+// of array lookups.
+// The accessors are plain pointers into the SDK's
+// arrays: cheap to copy, safe to read from several
+// threads at once, and only valid as long as the
+// MeshElements that set them up is alive.
+///////////////////////////////////////////////////////
+
+// One vertex attribute (color, uv, normal...), mapped by control point or by polygon vertex
+template <class T>
+class ElementAccessor
+{
+	public:
+		ElementAccessor() : m_pDirect(NULL), m_pIndices(NULL), m_byControlPoint(false), m_pDirectArray(NULL), m_pIndexArray(NULL) {}
+
+		bool IsValid() const { return m_pDirect != NULL; }
+		bool ByControlPoint() const { return m_byControlPoint; }
+
+		// value for a corner: 'controlPoint' is the corner's control point, 'polyVertex' its polygon vertex index
+		const T & Get(int controlPoint, int polyVertex) const
+		{
+			int k = m_byControlPoint ? controlPoint : polyVertex;
+			return m_pDirect[m_pIndices ? m_pIndices[k] : k];
+		}
+
+		bool Init(FbxLayerElementTemplate<T> *pElement, FbxMesh *pMesh, bool allowByControlPoint);
+		void Release();
+
+	private:
+		const T *m_pDirect;
+		const int *m_pIndices;	// NULL for eDirect
+		bool m_byControlPoint;
+
+		FbxLayerElementArrayTemplate<T> *m_pDirectArray;		// locked arrays, to give back
+		FbxLayerElementArrayTemplate<int> *m_pIndexArray;
+};
+
+
+
+// The material of a polygon, for one material element
+class MaterialAccessor
+{
+	public:
+		MaterialAccessor() : m_pIndices(NULL), m_stride(0), m_pIndexArray(NULL) {}
+
+		int Get(int polygon) const { return m_pIndices[polygon * m_stride]; } // index into the mesh's materials
+
+		bool Init(FbxGeometryElementMaterial *pElement, FbxMesh *pMesh, int materialCnt);
+		void InitFirstMaterial();	// every polygon uses the mesh's first material
+		void Release();
+
+	private:
+		const int *m_pIndices;
+		int m_stride;			// 0 for eAllSame, 1 for eByPolygon
+
+		FbxLayerElementArrayTemplate<int> *m_pIndexArray;
+};
+
+
+
+// Every element of a mesh we know how to read.  The arrays stay locked until this goes away
+class MeshElements
+{
+	public:
+		MeshElements(FbxMesh *pMesh, int materialCnt);
+		~MeshElements();
+
+		ElementAccessor<FbxColor> color;
+		ElementAccessor<FbxVector2> uv;
+		ElementAccessor<FbxVector4> normal;
+		ElementAccessor<FbxVector4> tangent;
+		ElementAccessor<FbxVector4> binormal;
+		vector<MaterialAccessor> materials;	// one per material element
+
+		UsingFields GetUsingFields() const;	// which vertex fields this mesh has
+
+	private:
+		// not copyable
+		MeshElements(const MeshElements &);
+		MeshElements & operator =(const MeshElements &);
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Check the element out and lock its arrays.  Anything we can't read safely (unknown
+// modes, arrays too short, indices out of range) is left out, with a warning
+////////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+bool ElementAccessor<T>::Init(FbxLayerElementTemplate<T> *pElement, FbxMesh *pMesh, bool allowByControlPoint)
+{
+	int needed;
+
+	Release();
+
+	if(!pElement)
+		return false;
+
+	switch(pElement->GetMappingMode())
+	{
+		case FbxGeometryElement::eByControlPoint:
+			if(!allowByControlPoint)
+				return false;
+
+			m_byControlPoint = true;
+			needed = pMesh->GetControlPointsCount();
+			break;
+
+		case FbxGeometryElement::eByPolygonVertex:
+			m_byControlPoint = false;
+			needed = pMesh->GetPolygonVertexCount();
+			break;
+
+		default:
+			return false; // other mapping modes don't make sense for vertex data
+	}
+
+	FbxLayerElementArrayTemplate<T> & direct = pElement->GetDirectArray();
+	int directCnt = direct.GetCount();
+
+	switch(pElement->GetReferenceMode())
+	{
+		case FbxGeometryElement::eDirect:
+		{
+			if(directCnt < needed)
+			{
+				LOG_WARNING("***  WARNING: layer element in mesh %s is too short (%d values for %d).  Element ignored\n", pMesh->GetName(), directCnt, needed);
+				return false;
+			}
+
+			break;
+		}
+
+		case FbxGeometryElement::eIndexToDirect:
+		{
+			FbxLayerElementArrayTemplate<int> & index = pElement->GetIndexArray();
+
+			if(index.GetCount() < needed)
+			{
+				LOG_WARNING("***  WARNING: layer element in mesh %s is too short (%d indices for %d).  Element ignored\n", pMesh->GetName(), index.GetCount(), needed);
+				return false;
+			}
+
+			m_pIndexArray = &index;
+			m_pIndices = index.GetLocked(FbxLayerElementArray::eReadLock);
+
+			for(int i = 0; i < needed; i++)
+			{
+				if(m_pIndices[i] < 0 || m_pIndices[i] >= directCnt)
+				{
+					LOG_WARNING("***  WARNING: layer element in mesh %s has an index out of range (%d).  Element ignored\n", pMesh->GetName(), m_pIndices[i]);
+					Release();
+					return false;
+				}
+			}
+
+			break;
+		}
+
+		default:
+			return false; // other reference modes not handled
+	}
+
+	m_pDirectArray = &direct;
+	m_pDirect = direct.GetLocked(FbxLayerElementArray::eReadLock);
+
+	return true;
+}
+
+
+
+template <class T>
+void ElementAccessor<T>::Release()
+{
+	if(m_pDirect)
+		m_pDirectArray->Release((T **) &m_pDirect);
+
+	if(m_pIndices)
+		m_pIndexArray->Release((int **) &m_pIndices);
+
+	m_pDirect = NULL;
+	m_pIndices = NULL;
+	m_pDirectArray = NULL;
+	m_pIndexArray = NULL;
+}
+
+
+
+#endif
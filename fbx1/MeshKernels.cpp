@@ -0,0 +1,324 @@
+//
+// Weld stage kernels: hashing, index remapping, bounds
+//
+
+
+
+//
+// System headers
+//
+#include <immintrin.h>	// SSE4.1, AVX
+
+
+//
+// Project Includes
+//
+#include "MeshKernels.h"
+#include "WeldHash.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// HASHES
+// See WeldHash.h.  32 bit integer multiplies only come 4 wide (SSE4.1): AVX has no
+// 256 bit integer ops, so the AVX level uses the SSE4.1 versions
+////////////////////////////////////////////////////////////////////////////////////////
+static inline __m128i HashBits4(const float *p)
+{
+	__m128i u = _mm_castps_si128(_mm_loadu_ps(p));
+	return _mm_andnot_si128(_mm_cmpeq_epi32(u, _mm_set1_epi32((int) 0x80000000u)), u);	// -0 as +0
+}
+
+
+
+static inline __m128i HashMul4(__m128i a, unsigned int b)
+{
+	return _mm_mullo_epi32(a, _mm_set1_epi32((int) b));
+}
+
+
+
+static inline __m128i HashMix4(__m128i h)
+{
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	h = HashMul4(h, 0x85ebca6bu);
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+	h = HashMul4(h, 0xc2b2ae35u);
+	return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+
+
+static void HashVec3sScalar(const float *pX, const float *pY, const float *pZ, size_t cnt, unsigned int *pHashes)
+{
+	WeldHashVec3 hash;
+
+	for(size_t i = 0; i < cnt; i++)
+		pHashes[i] = hash(Vec3(pX[i], pY[i], pZ[i]));
+}
+
+
+
+static void HashVec3sSSE41(const float *pX, const float *pY, const float *pZ, size_t cnt, unsigned int *pHashes)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128i h = _mm_add_epi32(_mm_add_epi32(HashMul4(HashBits4(pX + i), WELD_HASH_PRIME_0), HashMul4(HashBits4(pY + i), WELD_HASH_PRIME_1)),
+									HashMul4(HashBits4(pZ + i), WELD_HASH_PRIME_2));
+		_mm_storeu_si128((__m128i *) (pHashes + i), HashMix4(h));
+	}
+
+	HashVec3sScalar(pX + i, pY + i, pZ + i, cnt - i, pHashes + i);
+}
+
+
+
+static void HashTexCoordsScalar(const float *pU, const float *pV, size_t cnt, unsigned int *pHashes)
+{
+	WeldHashTexCoord hash;
+
+	for(size_t i = 0; i < cnt; i++)
+		pHashes[i] = hash(TexCoord(pU[i], pV[i]));
+}
+
+
+
+static void HashTexCoordsSSE41(const float *pU, const float *pV, size_t cnt, unsigned int *pHashes)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128i h = _mm_add_epi32(HashMul4(HashBits4(pU + i), WELD_HASH_PRIME_0), HashMul4(HashBits4(pV + i), WELD_HASH_PRIME_1));
+		_mm_storeu_si128((__m128i *) (pHashes + i), HashMix4(h));
+	}
+
+	HashTexCoordsScalar(pU + i, pV + i, cnt - i, pHashes + i);
+}
+
+
+
+static void HashColorsScalar(const float *pR, const float *pG, const float *pB, const float *pA, size_t cnt, unsigned int *pHashes)
+{
+	WeldHashColor hash;
+
+	for(size_t i = 0; i < cnt; i++)
+		pHashes[i] = hash(ColorRGBA(pR[i], pG[i], pB[i], pA[i]));
+}
+
+
+
+static void HashColorsSSE41(const float *pR, const float *pG, const float *pB, const float *pA, size_t cnt, unsigned int *pHashes)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128i rg = _mm_add_epi32(HashMul4(HashBits4(pR + i), WELD_HASH_PRIME_0), HashMul4(HashBits4(pG + i), WELD_HASH_PRIME_1));
+		__m128i ba = _mm_add_epi32(HashMul4(HashBits4(pB + i), WELD_HASH_PRIME_2), HashMul4(HashBits4(pA + i), WELD_HASH_PRIME_3));
+		_mm_storeu_si128((__m128i *) (pHashes + i), HashMix4(_mm_add_epi32(rg, ba)));
+	}
+
+	HashColorsScalar(pR + i, pG + i, pB + i, pA + i, cnt - i, pHashes + i);
+}
+
+
+
+typedef void (*HashVec3sFn)(const float *pX, const float *pY, const float *pZ, size_t cnt, unsigned int *pHashes);
+typedef void (*HashTexCoordsFn)(const float *pU, const float *pV, size_t cnt, unsigned int *pHashes);
+typedef void (*HashColorsFn)(const float *pR, const float *pG, const float *pB, const float *pA, size_t cnt, unsigned int *pHashes);
+
+static const HashVec3sFn G_hashVec3s[CPU_LEVEL_COUNT] = { HashVec3sScalar, HashVec3sSSE41, NULL };
+static const HashTexCoordsFn G_hashTexCoords[CPU_LEVEL_COUNT] = { HashTexCoordsScalar, HashTexCoordsSSE41, NULL };
+static const HashColorsFn G_hashColors[CPU_LEVEL_COUNT] = { HashColorsScalar, HashColorsSSE41, NULL };
+
+void HashVec3s(const float *pX, const float *pY, const float *pZ, size_t cnt, unsigned int *pHashes)
+{
+	CpuSelect(G_hashVec3s)(pX, pY, pZ, cnt, pHashes);
+}
+
+void HashTexCoords(const float *pU, const float *pV, size_t cnt, unsigned int *pHashes)
+{
+	CpuSelect(G_hashTexCoords)(pU, pV, cnt, pHashes);
+}
+
+void HashColors(const float *pR, const float *pG, const float *pB, const float *pA, size_t cnt, unsigned int *pHashes)
+{
+	CpuSelect(G_hashColors)(pR, pG, pB, pA, cnt, pHashes);
+}
+
+CpuLevel GetHashLevel()
+{
+	return CpuSelectedLevel(G_hashVec3s);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// INDEX REMAP
+// The lookups themselves can't be vectorized without a gather (AVX2), but the rest
+// can: 4 indices in, negative ones clamped to 0 for the lookup and blended back in
+// afterwards, no branch per index
+////////////////////////////////////////////////////////////////////////////////////////
+static void RemapIndicesScalar(int *pIdxs, size_t cnt, const size_t *pXrefs)
+{
+	for(size_t i = 0; i < cnt; i++)
+	{
+		if(pIdxs[i] >= 0)
+			pIdxs[i] = (int) pXrefs[pIdxs[i]];
+	}
+}
+
+
+
+static void RemapIndicesSSE41(int *pIdxs, size_t cnt, const size_t *pXrefs)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128i idx = _mm_loadu_si128((const __m128i *) (pIdxs + i));
+		__m128i neg = _mm_srai_epi32(idx, 31);				// all ones where idx < 0
+		__m128i safe = _mm_andnot_si128(neg, idx);			// 0 where idx < 0
+
+		__m128i mapped = _mm_setr_epi32((int) pXrefs[_mm_extract_epi32(safe, 0)], (int) pXrefs[_mm_extract_epi32(safe, 1)],
+										(int) pXrefs[_mm_extract_epi32(safe, 2)], (int) pXrefs[_mm_extract_epi32(safe, 3)]);
+
+		_mm_storeu_si128((__m128i *) (pIdxs + i), _mm_blendv_epi8(mapped, idx, neg));
+	}
+
+	RemapIndicesScalar(pIdxs + i, cnt - i, pXrefs);
+}
+
+
+
+typedef void (*RemapIndicesFn)(int *pIdxs, size_t cnt, const size_t *pXrefs);
+static const RemapIndicesFn G_remapIndices[CPU_LEVEL_COUNT] = { RemapIndicesScalar, RemapIndicesSSE41, NULL };
+
+void RemapIndices(int *pIdxs, size_t cnt, const size_t *pXrefs)
+{
+	CpuSelect(G_remapIndices)(pIdxs, cnt, pXrefs);
+}
+
+CpuLevel GetRemapLevel()
+{
+	return CpuSelectedLevel(G_remapIndices);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// BOUNDS
+// min/max are exact, so the order values are looked at in doesn't change the result
+////////////////////////////////////////////////////////////////////////////////////////
+static void BoundsLaneScalar(const float *pLane, size_t cnt, float & low, float & high)
+{
+	for(size_t i = 0; i < cnt; i++)
+	{
+		low = pLane[i] < low ? pLane[i] : low;
+		high = pLane[i] > high ? pLane[i] : high;
+	}
+}
+
+
+
+static void ComputeBoundsScalar(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax)
+{
+	BoundsLaneScalar(pX, cnt, pMin[0], pMax[0]);
+	BoundsLaneScalar(pY, cnt, pMin[1], pMax[1]);
+	BoundsLaneScalar(pZ, cnt, pMin[2], pMax[2]);
+}
+
+
+
+static void BoundsLaneSSE41(const float *pLane, size_t cnt, float & low, float & high)
+{
+	__m128 lo = _mm_set1_ps(low);
+	__m128 hi = _mm_set1_ps(high);
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(pLane + i);
+		lo = _mm_min_ps(v, lo);
+		hi = _mm_max_ps(v, hi);
+	}
+
+	float l[4], h[4];
+	_mm_storeu_ps(l, lo);
+	_mm_storeu_ps(h, hi);
+	for(int k = 0; k < 4; k++)
+	{
+		low = l[k] < low ? l[k] : low;
+		high = h[k] > high ? h[k] : high;
+	}
+
+	BoundsLaneScalar(pLane + i, cnt - i, low, high);
+}
+
+
+
+static void ComputeBoundsSSE41(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax)
+{
+	BoundsLaneSSE41(pX, cnt, pMin[0], pMax[0]);
+	BoundsLaneSSE41(pY, cnt, pMin[1], pMax[1]);
+	BoundsLaneSSE41(pZ, cnt, pMin[2], pMax[2]);
+}
+
+
+
+static void BoundsLaneAVX(const float *pLane, size_t cnt, float & low, float & high)
+{
+	__m256 lo = _mm256_set1_ps(low);
+	__m256 hi = _mm256_set1_ps(high);
+	size_t i = 0;
+
+	for(; i + 8 <= cnt; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(pLane + i);
+		lo = _mm256_min_ps(v, lo);
+		hi = _mm256_max_ps(v, hi);
+	}
+
+	float l[8], h[8];
+	_mm256_storeu_ps(l, lo);
+	_mm256_storeu_ps(h, hi);
+	_mm256_zeroupper();
+
+	for(int k = 0; k < 8; k++)
+	{
+		low = l[k] < low ? l[k] : low;
+		high = h[k] > high ? h[k] : high;
+	}
+
+	BoundsLaneScalar(pLane + i, cnt - i, low, high);
+}
+
+
+
+static void ComputeBoundsAVX(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax)
+{
+	BoundsLaneAVX(pX, cnt, pMin[0], pMax[0]);
+	BoundsLaneAVX(pY, cnt, pMin[1], pMax[1]);
+	BoundsLaneAVX(pZ, cnt, pMin[2], pMax[2]);
+}
+
+
+
+typedef void (*ComputeBoundsFn)(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax);
+static const ComputeBoundsFn G_computeBounds[CPU_LEVEL_COUNT] = { ComputeBoundsScalar, ComputeBoundsSSE41, ComputeBoundsAVX };
+
+void ComputeBounds(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax)
+{
+	CpuSelect(G_computeBounds)(pX, pY, pZ, cnt, pMin, pMax);
+}
+
+CpuLevel GetBoundsLevel()
+{
+	return CpuSelectedLevel(G_computeBounds);
+}
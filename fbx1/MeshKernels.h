@@ -0,0 +1,53 @@
+////////////////////////////////////////////////
+// MESHKERNELS.H
+//
+// Number crunching loops of the weld stage,
+// over whole arrays: hashing vertex values for
+// welding, remapping triangle indices once the
+// values are welded, and the bounding box of
+// the positions.  They work on SoAArray lanes
+// and flat index arrays, with SSE4.1/AVX
+// versions picked at run time (CpuDispatch.h).
+// Every version gives the same results.
+////////////////////////////////////////////////
+
+
+#ifndef _MESH_KERNELS_H_
+#define _MESH_KERNELS_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <stddef.h>
+
+#include "CpuDispatch.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// Weld hashes of 'cnt' values given as lanes, into 'pHashes'.  The same as the WeldHash* functors (WeldHash.h)
+void HashVec3s(const float *pX, const float *pY, const float *pZ, size_t cnt, unsigned int *pHashes);
+void HashTexCoords(const float *pU, const float *pV, size_t cnt, unsigned int *pHashes);
+void HashColors(const float *pR, const float *pG, const float *pB, const float *pA, size_t cnt, unsigned int *pHashes);
+
+// idx = pXrefs[idx] for all 'cnt' indices.  Negative ones (component not found) are left alone
+void RemapIndices(int *pIdxs, size_t cnt, const size_t *pXrefs);
+
+// grow the box pMin/pMax (x, y, z each) to hold 'cnt' points.  Start it at FLT_MAX/-FLT_MAX
+void ComputeBounds(const float *pX, const float *pY, const float *pZ, size_t cnt, float *pMin, float *pMax);
+
+// versions picked for this CPU
+CpuLevel GetHashLevel();
+CpuLevel GetRemapLevel();
+CpuLevel GetBoundsLevel();
+
+
+
+#endif // _MESH_KERNELS_H_
@@ -1,7 +1,9 @@
 #ifndef _PERFORMANCE_COUNTER_H
+#define _PERFORMANCE_COUNTER_H
 
-
+#ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
+#endif
 
 #include <windows.h>
 #include <iostream>
@@ -63,6 +65,13 @@ class TimerPerformanceCounter
 			// Return duration in seconds...
 			return end_time - start_time;
 		}
+
+		double IntervalSeconds()
+		{
+			unsigned __int64 freq;
+			QueryPerformanceFrequency(reinterpret_cast<LARGE_INTEGER*>(&freq));
+			return (double) (end_time - start_time) / (double) freq;
+		}
 };
 
 template<class Timer, class Test, unsigned SleepRepeat, unsigned QuantumRepeat=1>
@@ -0,0 +1,313 @@
+//
+// Run every file through the load -> extract -> weld -> write stages
+//
+
+
+
+//
+// System headers
+//
+#include <process.h> // thread library ('_beginthreadex')
+
+
+//
+// Project Includes
+//
+#include "Pipeline.h"
+#include "ProcessContent.h"
+#include "PerformanceCounter.h"
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////
+Pipeline::Pipeline(WorkQueue<FbxLibAndFilename *> *pInputQueue, BatchScheduler *pScheduler, const PipelineSettings & settings)
+{
+	m_settings = settings;
+	m_pScheduler = pScheduler;
+
+	m_pQueues[STAGE_LOAD] = pInputQueue;
+	for(int i = STAGE_LOAD + 1; i < STAGE_COUNT; i++)
+		m_pQueues[i] = new WorkQueue<FbxLibAndFilename *>(m_settings.queueDepth);
+
+	for(int i = 0; i < STAGE_COUNT; i++)
+		m_running[i] = 0;
+
+	m_pFreeContexts = NULL;
+}
+
+
+
+Pipeline::~Pipeline()
+{
+	for(int i = STAGE_LOAD + 1; i < STAGE_COUNT; i++)
+		delete m_pQueues[i];
+
+	delete m_pFreeContexts;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Default thread counts for a machine with 'hardwareThreads' threads.  Load is mostly
+// waiting on the disk, extract and weld are the CPU heavy stages.  Their threads mostly
+// hand out tasks and help run them (see TaskGroup::Wait), the task pool gets the rest
+// of the cores: see TaskWorkerCount
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::DefaultSettings(int hardwareThreads, PipelineSettings & settings)
+{
+	if(hardwareThreads < 1)
+		hardwareThreads = 1;
+
+	settings.threads[STAGE_LOAD] = hardwareThreads / 4 > 1 ? hardwareThreads / 4 : 1;
+	settings.threads[STAGE_EXTRACT] = hardwareThreads / 4 > 1 ? hardwareThreads / 4 : 1;
+	settings.threads[STAGE_WELD] = hardwareThreads / 4 > 1 ? hardwareThreads / 4 : 1;
+	settings.threads[STAGE_WRITE] = 1;
+	settings.queueDepth = PIPELINE_DEFAULT_QUEUE_DEPTH;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Task pool workers that go with 'settings': whatever the CPU heavy stages leave of the
+// 'hardwareThreads', so every core runs about one busy thread.  0 when they already
+// take it all: the stages run their tasks themselves then
+///////////////////////////////////////////////////////////////////////////////////////
+int Pipeline::TaskWorkerCount(int hardwareThreads, const PipelineSettings & settings)
+{
+	int workerCnt = hardwareThreads - settings.threads[STAGE_EXTRACT] - settings.threads[STAGE_WELD];
+
+	return workerCnt > 0 ? workerCnt : 0;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Create the SDK contexts and start all stage threads.  If a thread can't be created
+// the ones already running are left waiting for work: close the input queue and Join
+///////////////////////////////////////////////////////////////////////////////////////
+bool Pipeline::Start()
+{
+	////////////////////////////////////////////////////////////////
+	// SDK CONTEXTS
+	// Enough for every load thread, every scene waiting in front of the
+	// extract stage and every extract thread.  Created here rather than
+	// in the threads so SDK start up is serialized
+	int contextCnt = m_settings.threads[STAGE_LOAD] + m_settings.queueDepth + m_settings.threads[STAGE_EXTRACT];
+
+	m_contexts.resize(contextCnt);
+	m_pFreeContexts = new WorkQueue<FbxLib *>(contextCnt);
+
+	for(int i = 0; i < contextCnt; i++)
+	{
+		InitializeSdkObjects(m_contexts[i].lSdkManager, m_contexts[i].lScene);
+		m_pFreeContexts->Push(&m_contexts[i]);
+	}
+
+
+
+	////////////////////////////////////////////////////////////////
+	// THREADS
+	int threadCnt = 0;
+	for(int i = 0; i < STAGE_COUNT; i++)
+	{
+		m_running[i] = m_settings.threads[i];
+		threadCnt += m_settings.threads[i];
+	}
+
+	m_threads.resize(threadCnt);
+
+	int t = 0;
+	for(int i = 0; i < STAGE_COUNT; i++)
+	{
+		for(int j = 0; j < m_settings.threads[i]; j++, t++)
+		{
+			m_threads[t].pPipeline = this;
+			m_threads[t].stage = (PipelineStage) i;
+			m_threads[t].hThread = (HANDLE) _beginthreadex(NULL, 0, StageThreadStart, (void *) &m_threads[t], 0, NULL);
+
+			// A stage missing a thread would stall the whole pipeline
+			if(m_threads[t].hThread == 0)
+			{
+				LOG_ERROR("***   Error in Pipeline.cpp creating thread #%d for stage %d\n", j, i);
+
+				// Only count the threads that did start, so the last one out of every stage
+				// still closes the next queue (once).  They're all waiting on their queues:
+				// the caller closes the input queue and joins, as after a normal run
+				m_running[i] = j;
+				for(int k = i + 1; k < STAGE_COUNT; k++)
+					m_running[k] = 0;
+
+				m_threads.resize(t);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Wait for every stage to drain, then tear down the SDK contexts
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::Join()
+{
+	for(size_t i = 0; i < m_threads.size(); i++)
+	{
+		WaitForSingleObject(m_threads[i].hThread, INFINITE);
+		CloseHandle(m_threads[i].hThread);
+	}
+
+	m_threads.clear();
+
+	for(size_t i = 0; i < m_contexts.size(); i++)
+		DestroySdkObjects(m_contexts[i].lSdkManager, false);
+
+	m_contexts.clear();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Entry point for every stage thread
+///////////////////////////////////////////////////////////////////////////////////////
+unsigned __stdcall Pipeline::StageThreadStart(void *pData)
+{
+	StageThread *pThread = static_cast<StageThread *>(pData);
+
+	pThread->pPipeline->RunStage(pThread->stage);
+
+	return 0;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Keep pulling files from the stage's queue, work on them and hand them to the next
+// stage, until the queue is closed and empty
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::RunStage(PipelineStage stage)
+{
+	FbxLibAndFilename *pFbxInfo;
+
+	while(m_pQueues[stage]->Pop(pFbxInfo))
+	{
+		TimerPerformanceCounter timer;
+		bool goOn = true;
+
+		// a slot just freed up in the input queue: the biggest file held back takes it
+		if(stage == STAGE_LOAD)
+			m_pScheduler->Feed();
+
+		Log::SetTag(pFbxInfo->fileName.c_str()); // whatever gets logged from here on is about this file
+		timer.Start();
+
+		switch(stage)
+		{
+			case STAGE_LOAD:	goOn = Load(pFbxInfo);	break;
+			case STAGE_EXTRACT:	Extract(pFbxInfo);		break;
+			case STAGE_WELD:	Weld(pFbxInfo);			break;
+			case STAGE_WRITE:	Write(pFbxInfo);		break;
+		}
+
+		timer.Stop();
+		pFbxInfo->workSec += timer.IntervalSeconds();
+
+		if(goOn && stage + 1 < STAGE_COUNT)
+		{
+			m_pQueues[stage + 1]->Push(pFbxInfo); // blocks while the next stage is backed up
+		}
+		else
+		{
+			// done with this file, one way or another
+			m_pScheduler->ReportDone(pFbxInfo, pFbxInfo->workSec);
+			delete pFbxInfo->pContent; // only still around if the file didn't make it to the write stage
+			delete pFbxInfo;
+		}
+
+		Log::SetTag(NULL);
+	}
+
+	// last thread of this stage out: nothing more is coming for the next stage
+	if(InterlockedDecrement(&m_running[stage]) == 0 && stage + 1 < STAGE_COUNT)
+		m_pQueues[stage + 1]->Close();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// LOAD: parse the file into a free SDK context.  Returns false if the file is unusable
+///////////////////////////////////////////////////////////////////////////////////////
+bool Pipeline::Load(FbxLibAndFilename *pFbxInfo)
+{
+	LOG_VERBOSE("\t\tProcessing: %s...\n", pFbxInfo->fileName.c_str());
+
+	m_pFreeContexts->Pop(pFbxInfo->pFbxLib); // blocks until an extract thread gives one back
+
+	bool lResult = LoadScene(pFbxInfo->pFbxLib->lSdkManager, pFbxInfo->pFbxLib->lScene, pFbxInfo->fileName.c_str());
+
+    if(lResult == false)
+    {
+		LOG_ERROR("***  An error occurred while loading the scene \"%s\" (Pipeline.cpp->Load->LoadScene)...\n", pFbxInfo->fileName.c_str());
+
+		pFbxInfo->pFbxLib->lScene->Clear();
+		m_pFreeContexts->Push(pFbxInfo->pFbxLib);
+		pFbxInfo->pFbxLib = NULL;
+    }
+
+	return lResult;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// EXTRACT: turn the scene into our own data, then give the SDK context back
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::Extract(FbxLibAndFilename *pFbxInfo)
+{
+	pFbxInfo->pContent = new ProcessContent(pFbxInfo->fileName);	// create the data structure that will hold all of the file's data
+	pFbxInfo->pContent->Extract(pFbxInfo->pFbxLib->lScene);			// extract all data
+
+	// empty the scene so the next file loaded in this context starts from scratch
+	pFbxInfo->pFbxLib->lScene->Clear();
+	m_pFreeContexts->Push(pFbxInfo->pFbxLib);
+	pFbxInfo->pFbxLib = NULL;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// WELD: remove duplicates and drop unused materials
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::Weld(FbxLibAndFilename *pFbxInfo)
+{
+	pFbxInfo->pContent->Weld();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// WRITE: last stage.  Finish the .res file (the parts were saved while welding), then
+// release the file's data
+///////////////////////////////////////////////////////////////////////////////////////
+void Pipeline::Write(FbxLibAndFilename *pFbxInfo)
+{
+	pFbxInfo->pContent->Write();
+
+	delete pFbxInfo->pContent;
+	pFbxInfo->pContent = NULL;
+}
@@ -0,0 +1,124 @@
+//
+// Run every file through the load -> extract -> weld -> write stages
+//
+
+
+#ifndef __PIPELINE__H
+#define __PIPELINE__H
+
+
+
+//
+// System headers
+//
+#include <vector>
+
+
+//
+// Project headers
+//
+#include "fbxdefs.h"
+#include "WorkQueue.h"
+#include "BatchScheduler.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+//////////////////////////////////////////
+// DEFINES
+//////////////////////////////////////////
+#define PIPELINE_DEFAULT_QUEUE_DEPTH	2	// files waiting between two stages
+
+
+
+//////////////////////////////////////////
+// ENUMS/STRUCTS
+//////////////////////////////////////////
+enum PipelineStage
+{
+	STAGE_LOAD,		// LoadScene() into an SDK context (disk I/O + SDK parsing)
+	STAGE_EXTRACT,	// ProcessContent::Extract(), then the SDK context is released
+	STAGE_WELD,		// ProcessContent::Weld()
+	STAGE_WRITE,	// output + bookkeeping, releases the file's data
+	STAGE_COUNT
+};
+
+
+
+struct PipelineSettings
+{
+	int threads[STAGE_COUNT];	// thread count for every stage
+	int queueDepth;				// max files waiting in front of every stage (after load)
+};
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Every stage has its own threads and a bounded queue
+// in front of it, so loading file N+1 overlaps with
+// welding file N.  A full queue blocks the stage that
+// feeds it (backpressure), which also caps the memory:
+// at most 'queueDepth' files wait in front of a stage.
+//
+// Loaded scenes live in SDK contexts (an FbxManager/
+// FbxScene pair) taken from a fixed pool.  A context is
+// only ever used by one thread at a time: it's taken by
+// a load thread and given back by the extract thread
+// once the scene has been turned into plain data.
+//
+// The first queue (files to load) is fed by the
+// scheduler; when it's closed and every stage has
+// drained, the threads exit.
+///////////////////////////////////////////////////////
+class Pipeline
+{
+	public:
+		Pipeline(WorkQueue<FbxLibAndFilename *> *pInputQueue, BatchScheduler *pScheduler, const PipelineSettings & settings);
+		~Pipeline();
+
+		bool Start();	// create the SDK contexts and start all threads.  Join even if it fails
+		void Join();	// wait for every file to make it through
+
+		static void DefaultSettings(int hardwareThreads, PipelineSettings & settings);
+		static int TaskWorkerCount(int hardwareThreads, const PipelineSettings & settings);	// size of the task pool that goes with the stage threads
+
+	private:
+		struct StageThread
+		{
+			Pipeline *pPipeline;
+			PipelineStage stage;
+			HANDLE hThread;
+		};
+
+		PipelineSettings m_settings;
+		BatchScheduler *m_pScheduler;
+
+		WorkQueue<FbxLibAndFilename *> *m_pQueues[STAGE_COUNT];	// queue in front of every stage. [STAGE_LOAD] is owned by the caller
+		volatile LONG m_running[STAGE_COUNT];					// threads still running per stage, the last one out closes the next queue
+
+		vector<FbxLib> m_contexts;
+		WorkQueue<FbxLib *> *m_pFreeContexts;
+
+		vector<StageThread> m_threads;
+
+		static unsigned __stdcall StageThreadStart(void *pData);
+		void RunStage(PipelineStage stage);
+
+		bool Load(FbxLibAndFilename *pFbxInfo);
+		void Extract(FbxLibAndFilename *pFbxInfo);
+		void Weld(FbxLibAndFilename *pFbxInfo);
+		void Write(FbxLibAndFilename *pFbxInfo);
+
+		// not copyable
+		Pipeline(const Pipeline &);
+		Pipeline & operator =(const Pipeline &);
+};
+
+
+
+#endif
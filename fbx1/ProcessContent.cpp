@@ -20,9 +20,9 @@
 
 ///////////////////////////////////////////////////////////////////////////////////////
 // CONSTRUCTOR
-// This class has a member variables (for example, m_procMesh) with a compulsory initialization parameter (WriteData)
+// This class has a member variables (for example, m_procMat) with a compulsory initialization parameter (WriteData)
 ///////////////////////////////////////////////////////////////////////////////////////
-ProcessContent::ProcessContent(string in_filename) : m_procMesh(&m_writeData), m_procMat(&m_writeData), m_procLight(&m_writeData)
+ProcessContent::ProcessContent(string in_filename) : m_procMat(&m_writeData), m_procLight(&m_writeData), m_meshGroup(G_pTaskScheduler)
 {
 	m_filename = in_filename;
 	m_writeData.SetFilename(m_filename);
@@ -30,11 +30,21 @@ ProcessContent::ProcessContent(string in_filename) : m_procMesh(&m_writeData), m
 
 
 
+ProcessContent::~ProcessContent()
+{
+	m_meshGroup.Wait(); // never leave tasks running on our data
+
+	for(map<FbxMesh *, MeshTask *>::iterator it = m_meshTasks.begin(); it != m_meshTasks.end(); ++it)
+		delete it->second;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Go through all the children of the root node and call a function that
 // recursively iterates through the rest of the tree
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProcessContent::Start(FbxScene* pScene)
+void ProcessContent::Extract(FbxScene* pScene)
 {
     int i;
     FbxNode* lNode = pScene->GetRootNode();
@@ -57,12 +67,61 @@ void ProcessContent::Start(FbxScene* pScene)
         }
     }
 
+	// wait for the mesh tasks and gather their data
+	CollectMeshes();
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Post process the extracted data.  Runs on its own pipeline stage, so the
+// scene is long gone by now
+///////////////////////////////////////////////////////////////////////////////////////
+void ProcessContent::Weld()
+{
+	// Get rid of unused materials.  The materials, textures and lights are final then: save them
+	// and free them before welding needs the memory
+	m_procMat.DeleteUnused();
+
+	m_writeData.OpenOutput();
+	m_writeData.SaveMaterials();
 
 	// Weld all components that can be matched and fix indices into triangle list
 	m_writeData.WeldData();
 
-	// Get rid of unused materials
-	m_procMat.DeleteUnused();
+	const MeshData & mesh = m_writeData.GetFileDataPtr()->meshData;
+	if(!mesh.vPos.empty())
+		LOG_VERBOSE("\t\tBounds: (%g, %g, %g) - (%g, %g, %g)\n", mesh.bbMin.x, mesh.bbMin.y, mesh.bbMin.z, mesh.bbMax.x, mesh.bbMax.y, mesh.bbMax.z);
+
+	// One index per corner into vertices with all the components.  How much the positions got
+	// split up by differing normals, uvs, etc: vertices per position
+	m_writeData.BuildVertexBuffer();
+
+	const VertexBuffer & vb = mesh.vb;
+	if(!vb.indices.empty())
+	{
+		size_t vertexCnt = vb.vertices.size() / vb.stride;
+
+		LOG_INFO("\t\tVertices: %u for %u corners, %u positions (split ratio %.2f), %u floats each\n", (unsigned int) vertexCnt,
+				(unsigned int) vb.indices.size(), (unsigned int) mesh.vPos.size(), (double) vertexCnt / mesh.vPos.size(), vb.stride);
+	}
+
+	// and the mesh is final too
+	m_writeData.SaveMesh();
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Finish the file.  Everything in it got saved as soon as it was final (see Weld).  With
+// write-behind it's only on disk (and logged as saved) once the I/O thread gets to it
+///////////////////////////////////////////////////////////////////////////////////////
+bool ProcessContent::Write()
+{
+	return m_writeData.CloseOutput();
 }
 
 
@@ -80,8 +139,7 @@ void ProcessContent::RecurThroughChildren(FbxNode* pNode)
 
     if(pNode->GetNodeAttribute() == NULL)
     {
-		if(G_bVerbose)
-	        FBXSDK_printf("\t\t\t* NULL Node Attribute\n");
+		LOG_VERBOSE("\t\t\t* NULL Node Attribute\n");
     }
     else
     {
@@ -92,7 +150,7 @@ void ProcessContent::RecurThroughChildren(FbxNode* pNode)
 			//____________ MESHES + MATERIALS + TEXTURES _____________________________________________
 			case FbxNodeAttribute::eMesh:
 			{
-				m_procMesh.Start(pNode, &m_procMat);
+				QueueMesh(pNode);
 				
 				break;
 			}
@@ -116,12 +174,80 @@ void ProcessContent::RecurThroughChildren(FbxNode* pNode)
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////
+// Record the materials of the mesh (the material list is shared by all meshes so this
+// is done right here, in traversal order) and extract the rest of it as a task.
+// It may look a bit weird to find mesh processing calling ProcessMaterials, but those
+// two things are coupled together and we only want to record materials we have mesh
+// information for.
+// Further instances of a mesh reuse the task of the first one: the materials are looked
+// up on the mesh's first node anyway, so they'd come out the same
+///////////////////////////////////////////////////////////////////////////////////////
+void ProcessContent::QueueMesh(FbxNode* pNode)
+{
+    FbxMesh* lMesh = (FbxMesh*) pNode->GetNodeAttribute();
+	if(!lMesh)
+		return;
+
+	LOG_VERBOSE("\t\t\tMesh Name: %s\n", pNode->GetName());
+
+	map<FbxMesh *, MeshTask *>::iterator it = m_meshTasks.find(lMesh);
+	if(it != m_meshTasks.end())
+	{
+		it->second->m_instanceCnt++;
+		m_meshInstances.push_back(lMesh);
+		return;
+	}
+
+	MeshTask *pTask = new MeshTask(lMesh);
+
+	// Fist make a list of all the materials this mesh uses and record them in my global list of materials
+	m_procMat.Start(lMesh, pTask->m_matXref);
+
+	pTask->m_instanceCnt = 1;
+	m_meshTasks[lMesh] = pTask;
+	m_meshInstances.push_back(lMesh);
+	m_meshGroup.Run(pTask);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Wait for every mesh task and append their data in traversal order, so the result
+// is the same as extracting the meshes one after the other
+///////////////////////////////////////////////////////////////////////////////////////
+void ProcessContent::CollectMeshes()
+{
+	m_meshGroup.Wait();
+
+	for(size_t i = 0; i < m_meshInstances.size(); i++)
+	{
+		map<FbxMesh *, MeshTask *>::iterator it = m_meshTasks.find(m_meshInstances[i]);
+		MeshTask *pTask = it->second;
+
+		m_writeData.AppendMeshData(pTask->m_fragment.GetFileDataPtr()->meshData);
+
+		// done with the fragment after its last instance, free it right away
+		if(--pTask->m_instanceCnt == 0)
+		{
+			delete pTask;
+			m_meshTasks.erase(it);
+		}
+	}
+
+	m_meshInstances.clear();
+}
+
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Load pertinent data stored in the fbx global data area
 ///////////////////////////////////////////////////////////////////////////////////////
 void ProcessContent::ProcessGlobalData(FbxGlobalSettings* pGlobalSettings)
 {
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	    DisplayColor("\t\t\tAmbient Color: ", pGlobalSettings->GetAmbientColor());
 	
 	FbxColor value = pGlobalSettings->GetAmbientColor();
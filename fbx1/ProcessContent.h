@@ -7,6 +7,8 @@
 #define __PROCESS_CONTENT__H
 
 
+#include <map>
+
 //
 // Project headers
 //
@@ -31,17 +33,28 @@ class ProcessContent
 {
 	public:
 		ProcessContent(string filename);
-		void Start(FbxScene* pScene);
+		~ProcessContent();
+		void Extract(FbxScene* pScene);	// pull all data out of the scene.  The scene isn't needed after this
+		void Weld();					// remove duplicates and unused materials, saving each part once it's final.  No SDK calls
+		bool Write();					// finish the .res file
 
 	private:
 		string m_filename;
 		WriteData m_writeData;
-		ProcessMesh m_procMesh;
 		ProcessMaterials m_procMat;
 		ProcessLights m_procLight;
 
+		// meshes are extracted as tasks while we keep walking the tree
+		TaskGroup m_meshGroup;
+		// An instanced mesh hangs off several nodes: it's extracted once (two tasks on the same
+		// mesh would share its SDK layer arrays) and its data appended for every instance
+		map<FbxMesh *, MeshTask *> m_meshTasks;	// one per mesh, owns the tasks
+		vector<FbxMesh *> m_meshInstances;		// in traversal order, a mesh may show up more than once
+
 		// ProcessContent-specific functions
 		void RecurThroughChildren(FbxNode* pNode);
+		void QueueMesh(FbxNode* pNode);
+		void CollectMeshes();
 		void ProcessGlobalData(FbxGlobalSettings* pGlobalSettings);
 };
 
@@ -29,7 +29,7 @@ void ProcessLights::Start(FbxNode* pNode)
 	LightData lightData;
     FbxLight* lLight = (FbxLight*) pNode->GetNodeAttribute();
 
-  	if(G_bVerbose)
+  	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	{
 	    DisplayString("\t\t\tLight Name: ", (char *) pNode->GetName());
 	    DisplayMetaDataConnections(lLight);
@@ -47,7 +47,7 @@ void ProcessLights::Start(FbxNode* pNode)
 
     if (!(lLight->FileName.Get().IsEmpty()))
     {
-	  	if(G_bVerbose)
+	  	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		{
 			DisplayString("\t\t\t\tGobo");
 
@@ -69,7 +69,7 @@ void ProcessLights::Start(FbxNode* pNode)
 	FbxColor lColor(c[0], c[1], c[2]);
 	ColorRGBA color((float) c[0], (float) c[1], (float) c[2], 1.0f);
 
-  	if(G_bVerbose)
+  	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	{
 		DisplayString("\t\t\t\tDefault Animation Values");
 		DisplayColor("\t\t\t\t\tDefault Color: ", lColor);
@@ -11,6 +11,7 @@
 // System headers
 //
 #include <assert.h>
+#include <algorithm>	// find
 
 
 
@@ -93,8 +94,7 @@ void ProcessMaterials::Start(FbxMesh *pMesh, MaterialMeshXref &matXref)
 			continue; // WARNING!!! For this 'continue' to be safe, make sure nothing important gets done at the end of this loop
 		}
 
-	  	if(G_bVerbose)
-		    printf("\t\t\tMaterial Name: %s\n", (char *) pMaterial->GetName());
+	  	LOG_VERBOSE("\t\t\tMaterial Name: %s\n", (char *) pMaterial->GetName());
 
 		// if a valid material, record it's xref index
 		matIdx = RecordMaterial(pMaterial, i);
@@ -138,14 +138,13 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		recordedData = true;
 
 		matDat.shadingModel = SHADING_MODEL_LAMBERT;
-	  	if(G_bVerbose)
-			printf("\t\t\t\tLambert:\n");
+	  	LOG_VERBOSE("\t\t\t\tLambert:\n");
 
 		// We found a Lambert material. Display its properties.
 		// Display the Ambient Color
 		lKFbxDouble3=((FbxSurfaceLambert *)pMaterial)->Ambient;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tAmbient: ", theColor);
 		matDat.ambient.r = (float) theColor.mRed;
 		matDat.ambient.g = (float) theColor.mGreen;
@@ -155,7 +154,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		// Display the Diffuse Color
 		lKFbxDouble3 =((FbxSurfaceLambert *)pMaterial)->Diffuse;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tDiffuse: ", theColor);
 		matDat.diffuse.r = (float) theColor.mRed;
 		matDat.diffuse.g = (float) theColor.mGreen;
@@ -165,7 +164,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		// Display the Emissive
 		lKFbxDouble3 =((FbxSurfaceLambert *)pMaterial)->Emissive;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tEmissive: ", theColor);
 		matDat.emissive.r = (float) theColor.mRed;
 		matDat.emissive.g = (float) theColor.mGreen;
@@ -174,7 +173,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 
 		// Display the Opacity
 		lKFbxDouble1 =((FbxSurfaceLambert *)pMaterial)->TransparencyFactor;
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayDouble("\t\t\t\t\tOpacity: ", 1.0-lKFbxDouble1.Get());
 		matDat.opacity = (float) lKFbxDouble1.Get();
 	}
@@ -183,13 +182,12 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		recordedData = true;
 
 		// We found a Phong material.  Display its properties.
-		if(G_bVerbose)
-			printf("\t\t\t\tPhong:\n");
+		LOG_VERBOSE("\t\t\t\tPhong:\n");
 
 		// Display the Ambient Color
 		lKFbxDouble3 =((FbxSurfacePhong *) pMaterial)->Ambient;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tAmbient: ", theColor);
 		matDat.ambient.r = (float) theColor.mRed;
 		matDat.ambient.g = (float) theColor.mGreen;
@@ -199,7 +197,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		// Display the Diffuse Color
 		lKFbxDouble3 =((FbxSurfacePhong *) pMaterial)->Diffuse;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tDiffuse: ", theColor);
 		matDat.diffuse.r = (float) theColor.mRed;
 		matDat.diffuse.g = (float) theColor.mGreen;
@@ -209,7 +207,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		// Display the Specular Color (unique to Phong materials)
 		lKFbxDouble3 =((FbxSurfacePhong *) pMaterial)->Specular;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tSpecular: ", theColor);
 		matDat.specular.r = (float) theColor.mRed;
 		matDat.specular.g = (float) theColor.mGreen;
@@ -219,7 +217,7 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 		// Display the Emissive Color
 		lKFbxDouble3 =((FbxSurfacePhong *) pMaterial)->Emissive;
 		theColor.Set(lKFbxDouble3.Get()[0], lKFbxDouble3.Get()[1], lKFbxDouble3.Get()[2]);
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayColor("\t\t\t\t\tEmissive: ", theColor);
 		matDat.emissive.r = (float) theColor.mRed;
 		matDat.emissive.g = (float) theColor.mGreen;
@@ -228,23 +226,23 @@ int ProcessMaterials::RecordMaterial(FbxSurfaceMaterial *pMaterial, int material
 
 		//Opacity is Transparency factor now
 		lKFbxDouble1 =((FbxSurfacePhong *) pMaterial)->TransparencyFactor;
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayDouble("\t\t\t\t\tOpacity: ", 1.0-lKFbxDouble1.Get());
 		matDat.opacity = (float) lKFbxDouble1.Get();
 
 		// Display the Shininess
 		lKFbxDouble1 =((FbxSurfacePhong *) pMaterial)->Shininess;
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayDouble("\t\t\t\t\tShininess: ", lKFbxDouble1.Get());
 		matDat.shininess = (float) lKFbxDouble1.Get();
 
 		// Display the Reflectivity
 		lKFbxDouble1 =((FbxSurfacePhong *) pMaterial)->ReflectionFactor;
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 			DisplayDouble("\t\t\t\t\tReflectivity: ", lKFbxDouble1.Get());
 		matDat.reflectivity = (float) lKFbxDouble1.Get();
 	}
-	else if(G_bVerbose)
+	else if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		DisplayString("\t\t\t\tUnknown type of Material");
 
 
@@ -323,7 +321,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
 			if (lLayeredTexture)
 			{
 				texDat.isLayered = true;
-				if(G_bVerbose)
+				if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	                DisplayInt("\t\t\t\t\tLayered Texture: ", j);
                 FbxLayeredTexture *lLayeredTexture = pProperty.GetSrcObject<FbxLayeredTexture>(j);
                 int lNbTextures = lLayeredTexture->GetSrcObjectCount<FbxTexture>();
@@ -335,7 +333,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
                     {
                         if(pDisplayHeader)
 						{
-							if(G_bVerbose)
+							if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	                            DisplayInt("\t\t\t\t\tTextures connected to Material ", materialIndex);
                             pDisplayHeader = false;
                         }
@@ -346,7 +344,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
 
                         FbxLayeredTexture::EBlendMode lBlendMode;
                         lLayeredTexture->GetTextureBlendMode(k, lBlendMode);
-						if(G_bVerbose)
+						if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 						{
 	                        DisplayString("\t\t\t\t\tTextures for ", pProperty.GetName());
 		                    DisplayInt("\t\t\t\t\tTexture ", k);
@@ -356,7 +354,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
 						int texId = IsTextureAlreadyRecorded(lTexture);
 						if(texId >= 0)
 						{
-							GetFileDataPtr()->textures[texId].usedByMaterials.push_back(texId);
+							GetFileDataPtr()->textures[texId].usedByMaterials.push_back((int) GetFileDataPtr()->materials.size()); // the material being recorded goes there
 						}
 						else
 						{
@@ -376,7 +374,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
                     //display connected Material header only at the first time
                     if(pDisplayHeader)
 					{
-						if(G_bVerbose)
+						if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	                        DisplayInt("\t\t\t\t\tTextures connected to Material ", materialIndex);
                         pDisplayHeader = false;
                     }
@@ -388,7 +386,7 @@ void ProcessMaterials::FindTextureInfoByProperty(FbxProperty pProperty, bool &pD
 					int texId = IsTextureAlreadyRecorded(lTexture);
 					if(texId >= 0)
 					{
-						GetFileDataPtr()->textures[texId].usedByMaterials.push_back(texId);
+						GetFileDataPtr()->textures[texId].usedByMaterials.push_back((int) GetFileDataPtr()->materials.size()); // the material being recorded goes there
 					}
 					else
 					{
@@ -474,13 +472,13 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
 	FbxFileTexture *lFileTexture = FbxCast<FbxFileTexture>(pTexture);
 	FbxProceduralTexture *lProceduralTexture = FbxCast<FbxProceduralTexture>(pTexture);
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	    DisplayString("\t\t\t\t\t\tName: \"", (char *) pTexture->GetName(), "\"");
 	pTexDat->name = pTexture->GetName();
 
 	if (lFileTexture)
 	{
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		{
 			DisplayString("\t\t\t\t\t\tType: File Texture");
 			DisplayString("\t\t\t\t\t\tFile Name: \"", (char *) lFileTexture->GetFileName(), "\"");
@@ -489,14 +487,14 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
 	}
 	else if (lProceduralTexture)
 	{
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		{
 			DisplayString("\t\t\t\t\t\tType: Procedural Texture");
 		}
 		pTexDat->isProcedural = true;
 	}
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	{
 		DisplayDouble("\t\t\t\t\t\tScale U: ", pTexture->GetScaleU());
 		DisplayDouble("\t\t\t\t\t\tScale V: ", pTexture->GetScaleV());
@@ -522,7 +520,7 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
 
     const char* lAlphaSources[] = { "None", "RGB Intensity", "Black" };
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	{
 		DisplayString("\t\t\t\t\t\tAlpha Source: ", lAlphaSources[pTexture->GetAlphaSource()]);
 		DisplayDouble("\t\t\t\t\t\tCropping Left: ", pTexture->GetCroppingLeft());
@@ -541,7 +539,7 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
     const char* lMappingTypes[] = { "Null", "Planar", "Spherical", "Cylindrical", 
         "Box", "Face", "UV", "Environment" };
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	    DisplayString("\t\t\t\t\t\tMapping Type: ", lMappingTypes[pTexture->GetMappingType()]);
 
 	pTexDat->mappingType = (TexMappingType) pTexture->GetMappingType();
@@ -550,7 +548,7 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
     {
         const char* lPlanarMappingNormals[] = { "X", "Y", "Z" };
 
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	        DisplayString("\t\t\t\t\t\tPlanar Mapping Normal: ", lPlanarMappingNormals[pTexture->GetPlanarMappingNormal()]);
 
 		pTexDat->planarNormals = (TexPlanarMappingNormals) pTexture->GetPlanarMappingNormal();
@@ -559,13 +557,13 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
     const char* lBlendModes[]   = { "Translucent", "Add", "Modulate", "Modulate2" };   
     if(blendMode >= 0)
 	{
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	        DisplayString("\t\t\t\t\t\tBlend Mode: ", lBlendModes[blendMode]);
 
 		pTexDat->blendMode = (TexBlendModes) blendMode;
 	}
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	    DisplayDouble("\t\t\t\t\t\tAlpha: ", pTexture->GetDefaultAlpha());
 
 	pTexDat->defaultAlpha = (float) pTexture->GetDefaultAlpha();
@@ -573,7 +571,7 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
 	if (lFileTexture)
 	{
 		const char* lMaterialUses[] = { "Model Material", "Default Material" };
-		if(G_bVerbose)
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 		    DisplayString("\t\t\t\t\t\tMaterial Use: ", lMaterialUses[lFileTexture->GetMaterialUse()]);
 
 		int material_index = GetFileDataPtr()->materials.size(); // this will be the index of the material currently being added
@@ -583,7 +581,7 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
     const char* pTextureUses[] = { "Standard", "Shadow Map", "Light Map", 
         "Spherical Reflexion Map", "Sphere Reflexion Map", "Bump Normal Map" };
 
-	if(G_bVerbose)
+	if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
 	{
 	    DisplayString("\t\t\t\t\t\tTexture Use: ", pTextureUses[pTexture->GetTextureUse()]);
 		DisplayString("");
@@ -594,50 +592,104 @@ void ProcessMaterials::RecordTextureInfo(FbxTexture *pTexture, int blendMode, Te
 
 
 
+////////////////////////////////////////////////////////////////////////////////////////
+// idx = newIdxs[idx] for every index of the list.  Indices of removed entries (-1) are
+// dropped
+////////////////////////////////////////////////////////////////////////////////////////
+static void RemapIndexList(vector<int> & idxs, const vector<int> & newIdxs)
+{
+	size_t kept = 0;
+
+	for(size_t i = 0; i < idxs.size(); i++)
+	{
+		int idx = idxs[i] >= 0 && idxs[i] < (int) newIdxs.size() ? newIdxs[idxs[i]] : -1;
+		if(idx >= 0)
+			idxs[kept++] = idx;
+	}
+
+	idxs.resize(kept);
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Remove unused materials and textures
+// Remove unused materials and textures.  Everything that refers to them by index (the triangles, the
+// materials' texture lists, the textures' material lists) gets the new indices
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void ProcessMaterials::DeleteUnused()
 {
-	int size = (int) GetFileDataPtr()->materials.size();
-	int i = 0;
+	FileData *pData = GetFileDataPtr();
+	vector<int> newMatIdx(pData->materials.size(), -1);
+	vector<int> newTexIdx(pData->textures.size(), -1);
+	size_t i, j;
 
-	while(i < size)
+	// textures are used if a used material refers to them, from either side
+	for(i = 0; i < pData->materials.size(); i++)
 	{
-		if(GetFileDataPtr()->materials[i].used == false)
+		const MaterialData & mat = pData->materials[i];
+
+		for(j = 0; mat.used && j < mat.textureIdx.size(); j++)
 		{
-			RemoveStdVectorIndex(GetFileDataPtr()->materials, i);
-			size--;
+			if(mat.textureIdx[j] >= 0 && mat.textureIdx[j] < (int) pData->textures.size())
+				pData->textures[mat.textureIdx[j]].used = true;
 		}
-		else
-		{
-			MaterialData *pMatPtr = &GetFileDataPtr()->materials[i];
+	}
 
-			// flag textures referenced by this material as used
-			for(unsigned int j=0; j < pMatPtr->textureIdx.size(); j++)
-			{
-				int texIndex = pMatPtr->textureIdx[j];
-				GetFileDataPtr()->textures[j].used = true;
-			}
+	for(i = 0; i < pData->textures.size(); i++)
+	{
+		TextureData & tex = pData->textures[i];
 
-			i++;
+		for(j = 0; j < tex.usedByMaterials.size(); j++)
+		{
+			int matIdx = tex.usedByMaterials[j];
+			if(matIdx >= 0 && matIdx < (int) pData->materials.size() && pData->materials[matIdx].used)
+				tex.used = true;
 		}
 	}
 
-	// Remove unused textures
-	i = 0;
-	size = (int) GetFileDataPtr()->textures.size();
+	// keep the used ones, in order
+	size_t kept = 0;
+	for(i = 0; i < pData->materials.size(); i++)
+	{
+		if(!pData->materials[i].used)
+			continue;
 
-	while(i < size)
+		newMatIdx[i] = (int) kept;
+		if(kept != i)
+			pData->materials[kept] = pData->materials[i];
+		kept++;
+	}
+	pData->materials.resize(kept);
+
+	kept = 0;
+	for(i = 0; i < pData->textures.size(); i++)
 	{
-		if(GetFileDataPtr()->textures[i].used == false)
-		{
-			RemoveStdVectorIndex(GetFileDataPtr()->textures, i);
-			size--;
-		}
-		else
+		if(!pData->textures[i].used)
+			continue;
+
+		newTexIdx[i] = (int) kept;
+		if(kept != i)
+			pData->textures[kept] = pData->textures[i];
+		kept++;
+	}
+	pData->textures.resize(kept);
+
+	// new indices.  The materials' texture lists also get the textures that only know their materials
+	for(i = 0; i < pData->materials.size(); i++)
+		RemapIndexList(pData->materials[i].textureIdx, newTexIdx);
+
+	for(i = 0; i < pData->textures.size(); i++)
+	{
+		vector<int> & matIdxs = pData->textures[i].usedByMaterials;
+
+		RemapIndexList(matIdxs, newMatIdx);
+		for(j = 0; j < matIdxs.size(); j++)
 		{
-			i++;
+			vector<int> & texIdxs = pData->materials[matIdxs[j]].textureIdx;
+			if(find(texIdxs.begin(), texIdxs.end(), (int) i) == texIdxs.end())
+				texIdxs.push_back((int) i);
 		}
 	}
+
+	pData->meshData.tris.iMat.RemapIds(newMatIdx);
 }
@@ -22,11 +22,11 @@
 //
 // Project Includes
 //
-#include "DisplayCommon.h"
 #include "DataTypes.h"
 #include "ProcessMesh.h"
 #include "WriteData.h"
 #include "ProcessContent.h"
+#include "Triangulate.h"
 
 
 
@@ -48,17 +48,71 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 #define COMPONENT_NOT_FOUND_IDX		-1
 
+// Vertex fields a polygon kernel (ProcessMesh::ProcessPolygons) handles.  Positions are always there
+#define FIELD_COLOR					0x01
+#define FIELD_TEXCOORD				0x02
+#define FIELD_NORMAL				0x04
+#define FIELD_TANGENT				0x08
+#define FIELD_BINORMAL				0x10
+#define FIELD_COMBINATIONS			0x20
 
+#define MESH_CHUNK_POLYGONS			65536	// polygons per task when a single mesh is split up
+#define MESH_CHUNKS_PER_THREAD		4		// more chunks than threads, so a slow chunk doesn't hold everybody up
 
 
-// Macros for recording vertex component raw data, and updating indices.
+
+
+// Macros for recording vertex component raw data, and updating indices (of corner j of the current polygon).
 // made into macros as to not obfuscate member functions with pointers or references to arbitrary data, abstracting simple operations making it difficult to follow
-#define RECORD_VERTEX_COORD(arg) { GetWrtDataPtr()->RecordVertCoord(arg); pos.idxs[j] = posIdx; posIdx++; }
-#define RECORD_VERTEX_COLOR(arg) { GetWrtDataPtr()->RecordVertColor(arg); col.idxs[j] = colIdx; colIdx++; }
-#define RECORD_VERTEX_TEX_COORD(arg) { GetWrtDataPtr()->RecordVertTexCoord(arg); uvs.idxs[j] = uvsIdx; uvsIdx++; }
-#define RECORD_VERTEX_NORM(arg) { GetWrtDataPtr()->RecordVertNormal(arg); nrm.idxs[j] = nrmIdx; nrmIdx++; }
-#define RECORD_VERTEX_TANG(arg) { GetWrtDataPtr()->RecordVertTangent(arg); tan.idxs[j] = tanIdx; tanIdx++; }
-#define RECORD_VERTEX_BINORM(arg) { GetWrtDataPtr()->RecordVertBinormal(arg); bin.idxs[j] = binIdx; binIdx++; }
+#define RECORD_VERTEX_COORD(arg) { GetWrtDataPtr()->RecordVertCoord(arg); cPos[j] = posIdx; posIdx++; }
+#define RECORD_VERTEX_COLOR(arg) { GetWrtDataPtr()->RecordVertColor(arg); cCol[j] = colIdx; colIdx++; }
+#define RECORD_VERTEX_TEX_COORD(arg) { GetWrtDataPtr()->RecordVertTexCoord(arg); cUvs[j] = uvsIdx; uvsIdx++; }
+#define RECORD_VERTEX_NORM(arg) { GetWrtDataPtr()->RecordVertNormal(arg); cNrm[j] = nrmIdx; nrmIdx++; }
+#define RECORD_VERTEX_TANG(arg) { GetWrtDataPtr()->RecordVertTangent(arg); cTan[j] = tanIdx; tanIdx++; }
+#define RECORD_VERTEX_BINORM(arg) { GetWrtDataPtr()->RecordVertBinormal(arg); cBin[j] = binIdx; binIdx++; }
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CLASSES
+//
+// A range of polygons of a huge mesh.  First extracted into its own fragment (indices
+// starting at 0), then copied to its spot in the mesh's data: every chunk is copied at
+// the same time, to spots worked out beforehand from the sizes of the chunks before it
+////////////////////////////////////////////////////////////////////////////////////////
+class MeshChunkTask : public Task
+{
+	public:
+		MeshChunkTask(FbxMesh *pMesh, const MeshElements *pElements, const MaterialMeshXref *pMatXref, int firstPoly, int endPoly) :
+			m_pMesh(pMesh), m_pElements(pElements), m_pMatXref(pMatXref), m_firstPoly(firstPoly), m_endPoly(endPoly),
+			m_procMesh(&m_fragment), m_recordedAny(false), m_pDst(NULL) {}
+
+		virtual void Run()
+		{
+			if(!m_pDst)
+				m_recordedAny = m_procMesh.ProcessPolygonInfo(m_pMesh, *m_pElements, *m_pMatXref, m_firstPoly, m_endPoly);
+			else
+				WriteData::StitchMeshData(*m_pDst, m_fragment.GetFileDataPtr()->meshData, m_at);
+		}
+
+		// second run: copy the fragment into 'pDst' at 'at'
+		void SetStitch(MeshData *pDst, const MeshDataSizes & at) { m_pDst = pDst; m_at = at; }
+
+		FbxMesh *m_pMesh;
+		const MeshElements *m_pElements;
+		const MaterialMeshXref *m_pMatXref;
+		int m_firstPoly, m_endPoly;
+
+		WriteData m_fragment;
+		ProcessMesh m_procMesh;
+		bool m_recordedAny;
+
+		MeshData *m_pDst;
+		MeshDataSizes m_at;
+};
 
 
 
@@ -66,44 +120,210 @@
 
 
 ///////////////////////////////////////////////////////////////////////////////////////
-// Go through the root node extracting all pertinent info
-// If we find any poly data in this mesh, we will go ahead and iterate through all the
-// materials used by this mesh and record any used ones.  It may look a bit weird to
-// find ProcessMesh calling ProcessMaterials, but those two things are coupled together
-// and we only want to record materials we have mesh information for.
+// Extract all pertinent info out of the mesh.
+// The mesh's materials have already been recorded (ProcessContent does that during the
+// traversal, since the material list is shared by all meshes); matXref maps the mesh's
+// material indices to my global list of materials.
+// Materials used by valid polygons get flagged when the mesh data is appended to the
+// file's data.
+// Safe to run on any thread as long as every thread writes to its own WriteData.
 ///////////////////////////////////////////////////////////////////////////////////////
-void ProcessMesh::Start(FbxNode* pNode, ProcessMaterials *pProcMat)
+bool ProcessMesh::Start(FbxMesh* pMesh, const MaterialMeshXref &matXref)
 {
-    FbxMesh* lMesh = (FbxMesh*) pNode->GetNodeAttribute();
-	if(!lMesh)
-		return;
+	if(!pMesh)
+		return false;
+
+	int polyCnt = pMesh->GetPolygonCount();
+	int chunkCnt = GetChunkCount(polyCnt);
+	bool recordedAny;
+
+	m_degenerateCnt = 0;
+	m_triangulatedCnt = 0;
+	m_concaveCnt = 0;
+
+	// sort out the mesh's layer elements once, for every polygon (and every chunk)
+	MeshElements elements(pMesh, (int) matXref.newIndices.size());
+
+	// extract data out of mesh
+	if(chunkCnt > 1)
+		recordedAny = ProcessChunks(pMesh, elements, matXref, chunkCnt);
+	else
+		recordedAny = ProcessPolygonInfo(pMesh, elements, matXref, 0, polyCnt);
 
-	if(G_bVerbose)
-	    printf("\t\t\tMesh Name: %s\n", (char *) pNode->GetName());
+	// The triangles point at the control points (offset by however many values came before this mesh), and
+	// nothing got recorded in those lists while going through the polygons: the control points go right there
+	if(G_bControlPoints && recordedAny)
+		RecordControlPoints(pMesh, elements);
 
-	MaterialMeshXref matXref;
+	if(m_degenerateCnt > 0)
+		LOG_WARNING("***  WARNING: %d polygons with less than 3 corners in mesh %s.  They are discarded\n", m_degenerateCnt, pMesh->GetName());
 
-	// Fist make a list of all the materials this mesh uses and record them in my global list of materials
-	pProcMat->Start(lMesh, matXref);
+	if(m_triangulatedCnt > 0)
+		LOG_VERBOSE("\t\t\tTriangulated %d polygons (%d concave)\n", m_triangulatedCnt, m_concaveCnt);
 
-	// extract data out of mesh.  Mark materials used by any valid polygons.
-	ProcessPolygonInfo(lMesh, matXref);
+	return recordedAny;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Control point mode: record every control point once, in order, so triangles can use
+// the control point indices straight away.  Same goes for colors and uv's mapped by
+// control point
+///////////////////////////////////////////////////////////////////////////////////////
+void ProcessMesh::RecordControlPoints(FbxMesh* pMesh, const MeshElements &elements)
+{
+	int i, cnt = pMesh->GetControlPointsCount();
+	MeshDataSizes from;
+
+	GetWrtDataPtr()->RecordVertCoords(pMesh->GetControlPoints(), cnt);
+
+	WriteData::GetMeshDataSizes(GetFileDataPtr()->meshData, from); // positions are rounded already
+
+	if(elements.color.IsValid() && elements.color.ByControlPoint())
+	{
+		for(i = 0; i < cnt; i++)
+			GetWrtDataPtr()->RecordVertColor(elements.color.Get(i, 0));
+	}
+
+	if(elements.uv.IsValid() && elements.uv.ByControlPoint())
+	{
+		for(i = 0; i < cnt; i++)
+			GetWrtDataPtr()->RecordVertTexCoord(elements.uv.Get(i, 0));
+	}
+
+	GetWrtDataPtr()->QuantizeFrom(from);
 }
 
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////
+// How many tasks to split a mesh into.  Only huge meshes are worth it.  Verbose output
+// lists every vertex, that has to come out in order, so no splitting then
+///////////////////////////////////////////////////////////////////////////////////////
+int ProcessMesh::GetChunkCount(int polygonCount)
+{
+	if(!G_pTaskScheduler || LOG_ENABLED(LOG_LEVEL_VERBOSE))
+		return 1;
+
+	int chunkCnt = (polygonCount + MESH_CHUNK_POLYGONS - 1) / MESH_CHUNK_POLYGONS;
+	int maxChunks = MESH_CHUNKS_PER_THREAD * G_pTaskScheduler->GetThreadCount();
+
+	return chunkCnt < maxChunks ? chunkCnt : maxChunks;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Extract chunks of polygons at the same time, each one into its own fragment, then
+// stitch them together in polygon order: a running sum of the fragment sizes says
+// where each one goes, so the copies can run at the same time too.  The result is the
+// same as extracting the whole mesh in one go
+///////////////////////////////////////////////////////////////////////////////////////
+bool ProcessMesh::ProcessChunks(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int chunkCnt)
+{
+	int polyCnt = pMesh->GetPolygonCount();
+	vector<MeshChunkTask *> chunks(chunkCnt);
+	TaskGroup group(G_pTaskScheduler);
+	int c;
+
+	//////////////////////////////////////////////////
+	// EXTRACT
+	for(c = 0; c < chunkCnt; c++)
+	{
+		int firstPoly = (int) ((__int64) polyCnt * c / chunkCnt);
+		int endPoly = (int) ((__int64) polyCnt * (c + 1) / chunkCnt);
+
+		chunks[c] = new MeshChunkTask(pMesh, &elements, &matXref, firstPoly, endPoly);
+		group.Run(chunks[c]);
+	}
+
+	group.Wait();
+
+
+	//////////////////////////////////////////////////
+	// STITCH
+	MeshData *pDst = &GetWrtDataPtr()->GetFileDataPtr()->meshData;
+	MeshDataSizes at, sizes;
+	bool recordedAny = false;
+
+	WriteData::GetMeshDataSizes(*pDst, at);
+
+	for(c = 0; c < chunkCnt; c++)
+	{
+		chunks[c]->SetStitch(pDst, at);
+
+		WriteData::GetMeshDataSizes(chunks[c]->m_fragment.GetFileDataPtr()->meshData, sizes);
+		WriteData::AddMeshDataSizes(at, sizes);
+
+		recordedAny |= chunks[c]->m_recordedAny;
+		m_degenerateCnt += chunks[c]->m_procMesh.m_degenerateCnt;
+		m_triangulatedCnt += chunks[c]->m_procMesh.m_triangulatedCnt;
+		m_concaveCnt += chunks[c]->m_procMesh.m_concaveCnt;
+	}
+
+	WriteData::ResizeMeshData(*pDst, at);
+
+	for(c = 0; c < chunkCnt; c++)
+		group.Run(chunks[c]);
+
+	group.Wait();
+
+	for(c = 0; c < chunkCnt; c++)
+		delete chunks[c];
+
+	return recordedAny;
+}
 
 
 
 
 ///////////////////////////////////////////////////////////////////////////////////////
 // Go through the Mesh node and break it down into vertices, normals, uv's, etc.
+// Only polygons [firstPoly, endPoly) are looked at, so a huge mesh can be split up.
+// Which vertex fields the mesh has is known up front, so we jump straight into the
+// version of the polygon loop made for exactly those fields: no tests, no code at all
+// for the missing ones
 // Return whether it managed to record any data off of this mesh
 ///////////////////////////////////////////////////////////////////////////////////////
-bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
+typedef bool (ProcessMesh::*PolygonKernel)(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int firstPoly, int endPoly);
+
+#define POLYGON_KERNELS_4(fields)	&ProcessMesh::ProcessPolygons<fields>, &ProcessMesh::ProcessPolygons<fields + 1>, \
+									&ProcessMesh::ProcessPolygons<fields + 2>, &ProcessMesh::ProcessPolygons<fields + 3>
+
+bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int firstPoly, int endPoly)
+{
+	// indexed by FIELD_* bits
+	static const PolygonKernel kernels[FIELD_COMBINATIONS] =
+	{
+		POLYGON_KERNELS_4(0x00), POLYGON_KERNELS_4(0x04), POLYGON_KERNELS_4(0x08), POLYGON_KERNELS_4(0x0c),
+		POLYGON_KERNELS_4(0x10), POLYGON_KERNELS_4(0x14), POLYGON_KERNELS_4(0x18), POLYGON_KERNELS_4(0x1c)
+	};
+
+	UsingFields fields = elements.GetUsingFields();
+	unsigned mask = (fields.vcolor ? FIELD_COLOR : 0) |
+					(fields.vtexCoord ? FIELD_TEXCOORD : 0) |
+					(fields.vnorm ? FIELD_NORMAL : 0) |
+					(fields.vtangent ? FIELD_TANGENT : 0) |
+					(fields.vbinormal ? FIELD_BINORMAL : 0);
+
+	return (this->*kernels[mask])(pMesh, elements, matXref, firstPoly, endPoly);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// The polygon loop, for a given set of vertex fields.
+// The layer elements have been sorted out beforehand (MeshElements), so every corner
+// is just a few array lookups
+///////////////////////////////////////////////////////////////////////////////////////
+template <unsigned FIELDS>
+bool ProcessMesh::ProcessPolygons(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int firstPoly, int endPoly)
 {
-	bool nonTriangleFound = false;
 	bool recordedAny = false;
 
 	 
@@ -111,7 +331,7 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 
 	//////////////////////////////////////////////////
 	// IMPORTANT: Keep track of component indices
-	// We have a running list of all raw data added for entire file (not just this mesh)
+	// We have a running list of all raw data added to our WriteData (the whole file, or just this mesh when run as a task)
 	// These indices correspond in the order into the MeshData structure
 	// *** NOTE: at this point all component indices will match: vPos[0] refers to the same vertex as vNorm[0], vTex[0], etc.  This will change later in the process
 	int posIdx = GetWrtDataPtr()->GetCurrVertCoordIndex();
@@ -121,74 +341,74 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 	int binIdx = GetWrtDataPtr()->GetCurrVertBinormIndex();
 	int tanIdx = GetWrtDataPtr()->GetCurrVertTangIndex();
 
+	// everything recorded from here on gets rounded in one go at the end
+	MeshDataSizes from;
+	WriteData::GetMeshDataSizes(GetFileDataPtr()->meshData, from);
 
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// list of component indices for the triangle lists (one for each component: coord, color, uv, etc)
 	Int3 pos, col, uvs, nrm, bin, tan;
 
+	// component indices of every corner of the current polygon, and the polygon's triangles (as corners of the polygon)
+	vector<int> cPos, cCol, cUvs, cNrm, cBin, cTan;
+	vector<Int3> polyTris;
+	vector<int> matIds; // materials of the current polygon, one per material element
+	Triangulator triangulator;
+
 
 	
 	/////////////////////////////////////
-	// Fbx vertex index for current mesh
-    int vertexId = 0;
+	// Fbx vertex index for current mesh (polygon vertex of firstPoly's first corner)
+    int vertexId = firstPoly < endPoly ? pMesh->GetPolygonVertexIndex(firstPoly) : 0;
 
 
 
 	//////////////////////////
 	// Iteration vars
 	// to help go through all mesh data in the fbx file
-    int i, j, lPolygonCount = pMesh->GetPolygonCount();
+    int i, j;
     FbxVector4* lControlPoints = pMesh->GetControlPoints();
-    char header[100];
+	const int *lPolygonVertices = pMesh->GetPolygonVertices(); // control point of every polygon vertex
+	const size_t materialCnt = elements.materials.size();
+
+	// Control point mode: these are recorded once per control point after the polygons (RecordControlPoints),
+	// the triangles just point at them
+	const bool cpPos = G_bControlPoints;
+	const bool cpColor = G_bControlPoints && elements.color.ByControlPoint();
+	const bool cpUV = G_bControlPoints && elements.uv.ByControlPoint();
 
 
 
 
 	////////////////////////////////
 	// Iterate through polygon data
-    for (i = 0; i < lPolygonCount; i++)
+    for (i = firstPoly; i < endPoly; i++)
     {
-        int l;
-
 		//////////////////////////
 		// FIND GROUP ASSIGNMENTS
+		// (only ever printed out)
 		//////////////////////////
-		int polyGroupCount = pMesh->GetElementPolygonGroupCount();
+		if(LOG_ENABLED(LOG_LEVEL_VERBOSE))
+		{
+			int polyGroupCount = pMesh->GetElementPolygonGroupCount();
 
-        for (l = 0; l < polyGroupCount; l++)
-        {
-            FbxGeometryElementPolygonGroup* lePolgrp = pMesh->GetElementPolygonGroup(l);
-			//
-			switch (lePolgrp->GetMappingMode())
+			for (int l = 0; l < polyGroupCount; l++)
 			{
-				//_______________________________________
-				case FbxGeometryElement::eByPolygon:
+				FbxGeometryElementPolygonGroup* lePolgrp = pMesh->GetElementPolygonGroup(l);
+
+				if (lePolgrp->GetMappingMode() == FbxGeometryElement::eByPolygon && lePolgrp->GetReferenceMode() == FbxGeometryElement::eIndex)
 				{
-					if (lePolgrp->GetReferenceMode() == FbxGeometryElement::eIndex)
-					{
-						if(G_bVerbose)
-						{
-							int polyGroupId = lePolgrp->GetIndexArray().GetAt(i);
-							printf("\t\t\t\tAssigned to group: %d\n", polyGroupId);
-						}
-						break;
-					}
-					// no break
+					int polyGroupId = lePolgrp->GetIndexArray().GetAt(i);
+					LOG_VERBOSE("\t\t\t\tAssigned to group: %d\n", polyGroupId);
 				}
-
-				//_______________________________________
-				default:
+				else
 				{
 					// any other mapping modes don't make sense
-					if(G_bVerbose)
-						printf("\t\t\t\t\"unsupported group assignment\"");
-					break;
+					LOG_VERBOSE("\t\t\t\t\"unsupported group assignment\"\n");
 				}
-
-			} // end of switch
-
-		} // end of for(...pMesh->GetElementPolygonGroupCount()...)
+			}
+		}
 
 
 
@@ -197,13 +417,9 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 		// FIND RAW DATA (verts, uv's, norms, etc)
 		///////////////////////////////////////////
         int lPolygonSize = pMesh->GetPolygonSize(i);
-		if(lPolygonSize != 3)
+		if(lPolygonSize < 3)
 		{
-			if(!nonTriangleFound)
-			{
-				printf("***  WARNING: non-triangles in mesh %s.  ALL non-triangles are discarded\n", pMesh->GetName());
-				nonTriangleFound = true;
-			}
+			m_degenerateCnt++; // reported once the whole mesh is done
 
 			vertexId += lPolygonSize;
 
@@ -211,203 +427,69 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 			continue;
 		}
 
-		for (j = 0; j < lPolygonSize; j++)
+		// quads and n-gons get split up.  Corners are recorded once, shared by the polygon's triangles
+		if(lPolygonSize > 3)
 		{
-			int lControlPointIndex = pMesh->GetPolygonVertex(i, j);
+			if(!triangulator.Triangulate(lControlPoints, lPolygonVertices + vertexId, lPolygonSize, polyTris))
+				m_concaveCnt++;
+
+			m_triangulatedCnt++;
+		}
+
+		if((int) cPos.size() < lPolygonSize)
+		{
+			cPos.resize(lPolygonSize);
+			cCol.resize(lPolygonSize);
+			cUvs.resize(lPolygonSize);
+			cNrm.resize(lPolygonSize);
+			cBin.resize(lPolygonSize);
+			cTan.resize(lPolygonSize);
+		}
+
+		for (j = 0; j < lPolygonSize; j++, vertexId++)
+		{
+			int lControlPointIndex = lPolygonVertices[vertexId];
 
 			///////////////////////////////////
 			// VERTEX COORDINATES
 			///////////////////////////////////
-			RECORD_VERTEX_COORD(lControlPoints[lControlPointIndex]);
+			if(cpPos)
+				cPos[j] = posIdx + lControlPointIndex;
+			else
+				RECORD_VERTEX_COORD(lControlPoints[lControlPointIndex]);
+
 			recordedAny = true; // yay, we found something!
 
-			if(G_bVerbose)
-				Display3DVector("\t\t\t\tCoordinates: ", lControlPoints[lControlPointIndex]);
+			LOG_VERBOSE("\t\t\t\tCoordinates: %g, %g, %g\n", lControlPoints[lControlPointIndex][0], lControlPoints[lControlPointIndex][1], lControlPoints[lControlPointIndex][2]);
 
 
 			///////////////////////////////////
 			// VERTEX COLORS
 			///////////////////////////////////
-			bool storedColor = false;
-			for (l = 0; l < pMesh->GetElementVertexColorCount(); l++)
+			if(FIELDS & FIELD_COLOR)
 			{
-				FbxGeometryElementVertexColor* leVtxc = pMesh->GetElementVertexColor( l);
-				if(G_bVerbose)
-					FBXSDK_sprintf(header, 100, "\t\t\t\tColor vertex: "); 
+				const FbxColor & color = elements.color.Get(lControlPointIndex, vertexId);
+				LOG_VERBOSE("\t\t\t\tColor vertex: %g (red), %g (green), %g (blue)\n", color.mRed, color.mGreen, color.mBlue);
 
-				switch (leVtxc->GetMappingMode())
-				{
-					case FbxGeometryElement::eByControlPoint:
-					{
-						switch (leVtxc->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								if(G_bVerbose)
-									DisplayColor(header, leVtxc->GetDirectArray().GetAt(lControlPointIndex));
-								
-								RECORD_VERTEX_COLOR(leVtxc->GetDirectArray().GetAt(lControlPointIndex));
-								storedColor = true;
-
-								break;
-							}
-
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								int id = leVtxc->GetIndexArray().GetAt(lControlPointIndex);
-								if(G_bVerbose)
-									DisplayColor(header, leVtxc->GetDirectArray().GetAt(id));
-
-								RECORD_VERTEX_COLOR(leVtxc->GetDirectArray().GetAt(id));
-								storedColor = true;
-
-								break;
-							}
-
-							default:
-								break; // other reference modes not shown here!
-						}
-						break;
-					}
-
-					case FbxGeometryElement::eByPolygonVertex:
-					{
-						switch (leVtxc->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								if(G_bVerbose)
-									DisplayColor(header, leVtxc->GetDirectArray().GetAt(vertexId));
-								
-								RECORD_VERTEX_COLOR(leVtxc->GetDirectArray().GetAt(vertexId));
-								storedColor = true;
-
-								break;
-							}
-
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								int id = leVtxc->GetIndexArray().GetAt(vertexId);
-								if(G_bVerbose)
-									DisplayColor(header, leVtxc->GetDirectArray().GetAt(id));
-
-								RECORD_VERTEX_COLOR(leVtxc->GetDirectArray().GetAt(id));
-								storedColor = true;
-
-								break;
-							}
-
-							default:
-								break; // other reference modes not shown here!
-						}
-
-						break;
-					}
-
-					case FbxGeometryElement::eByPolygon: // doesn't make much sense for UVs
-					case FbxGeometryElement::eAllSame:   // doesn't make much sense for UVs
-					case FbxGeometryElement::eNone:       // doesn't make much sense for UVs
-					{
-						break;
-					}
-
-				} // end of switch (GetWrappingMode)
-
-			} // end of for(vertexColorCount)
-
-			// if no color found, store a "not found" value
-			if(!storedColor)
-			{
-				col.idxs[j] = COMPONENT_NOT_FOUND_IDX;
+				if(cpColor)
+					cCol[j] = colIdx + lControlPointIndex;
+				else
+					RECORD_VERTEX_COLOR(color);
 			}
 
 			
 			///////////////////////////////////
 			// VERTEX UV's
 			///////////////////////////////////
-			bool storedUV = false;
-
-			for (l = 0; l < pMesh->GetElementUVCount(); ++l)
+			if(FIELDS & FIELD_TEXCOORD)
 			{
-				FbxGeometryElementUV* leUV = pMesh->GetElementUV( l);
-				if(G_bVerbose)
-					FBXSDK_sprintf(header, 100, "\t\t\t\tTexture UV: "); 
-
-				switch (leUV->GetMappingMode())
-				{
-					case FbxGeometryElement::eByControlPoint:
-					{
-						switch (leUV->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							{
-								if(G_bVerbose)
-									Display2DVector(header, leUV->GetDirectArray().GetAt(lControlPointIndex));
-
-								RECORD_VERTEX_TEX_COORD(leUV->GetDirectArray().GetAt(lControlPointIndex));
-								storedUV = true;
-
-								break;
-							}
-
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								int id = leUV->GetIndexArray().GetAt(lControlPointIndex);
-								if(G_bVerbose)
-									Display2DVector(header, leUV->GetDirectArray().GetAt(id));
-
-								RECORD_VERTEX_TEX_COORD(leUV->GetDirectArray().GetAt(id));
-								storedUV = true;
-
-								break;
-							}
-
-							default:
-								break; // other reference modes not shown here!
-						}
-
-						break;
-					}
+				const FbxVector2 & uv = elements.uv.Get(lControlPointIndex, vertexId);
+				LOG_VERBOSE("\t\t\t\tTexture UV: %g, %g\n", uv[0], uv[1]);
 
-					case FbxGeometryElement::eByPolygonVertex:
-					{
-						int lTextureUVIndex = pMesh->GetTextureUVIndex(i, j);
-
-						switch (leUV->GetReferenceMode())
-						{
-							case FbxGeometryElement::eDirect:
-							case FbxGeometryElement::eIndexToDirect:
-							{
-								if(G_bVerbose)
-									Display2DVector(header, leUV->GetDirectArray().GetAt(lTextureUVIndex));
-
-								RECORD_VERTEX_TEX_COORD(leUV->GetDirectArray().GetAt(lTextureUVIndex));
-								storedUV = true;
-
-								break;
-							}
-
-							default:
-								break; // other reference modes not shown here!
-						}
-
-						break;
-					}
-
-					case FbxGeometryElement::eByPolygon: // doesn't make much sense for UVs
-					case FbxGeometryElement::eAllSame:   // doesn't make much sense for UVs
-					case FbxGeometryElement::eNone:       // doesn't make much sense for UVs
-					{
-						break;
-					}
-
-				} // end of switch(GetMappingMode)
-
-			} // end of for(...GetElementUVCount...)
-
-			if(!storedUV)
-			{
-				uvs.idxs[j] = COMPONENT_NOT_FOUND_IDX;
+				if(cpUV)
+					cUvs[j] = uvsIdx + lControlPointIndex;
+				else
+					RECORD_VERTEX_TEX_COORD(uv);
 			}
 
 
@@ -415,164 +497,38 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 			///////////////////////////////////
 			// VERTEX NORMALS
 			///////////////////////////////////
-			bool foundNormal = false;
-
-			for( l = 0; l < pMesh->GetElementNormalCount(); ++l)
+			if(FIELDS & FIELD_NORMAL)
 			{
-				FbxGeometryElementNormal* leNormal = pMesh->GetElementNormal( l);
-				if(G_bVerbose)
-					FBXSDK_sprintf(header, 100, "\t\t\t\tNormal: "); 
-
-				if(leNormal->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
-				{
-					switch (leNormal->GetReferenceMode())
-					{
-						case FbxGeometryElement::eDirect:
-						{
-							if(G_bVerbose)
-								Display3DVector(header, leNormal->GetDirectArray().GetAt(vertexId));
-
-							RECORD_VERTEX_NORM(leNormal->GetDirectArray().GetAt(vertexId));
-							foundNormal = true;
-
-							break;
-						}
-
-						case FbxGeometryElement::eIndexToDirect:
-						{
-							int id = leNormal->GetIndexArray().GetAt(vertexId);
-							if(G_bVerbose)
-								Display3DVector(header, leNormal->GetDirectArray().GetAt(id));
-
-							RECORD_VERTEX_NORM(leNormal->GetDirectArray().GetAt(id));
-							foundNormal = true;
-
-							break;
-						}
-
-						default:
-							break; // other reference modes not shown here!
-
-					} // end of switch(...GetReferenceMode..)
-
-				} // end of if(...
-
-			}// end of for(...GetElementNormalCount...)
+				const FbxVector4 & normal = elements.normal.Get(lControlPointIndex, vertexId);
+				LOG_VERBOSE("\t\t\t\tNormal: %g, %g, %g\n", normal[0], normal[1], normal[2]);
 
-			if(!foundNormal)
-			{
-				nrm.idxs[j] = COMPONENT_NOT_FOUND_IDX;
+				RECORD_VERTEX_NORM(normal);
 			}
 
 
 			///////////////////////////////////
 			// VERTEX TANGENT VECTOR
 			///////////////////////////////////
-			bool foundTang = false;
-
-			for( l = 0; l < pMesh->GetElementTangentCount(); ++l)
+			if(FIELDS & FIELD_TANGENT)
 			{
-				FbxGeometryElementTangent* leTangent = pMesh->GetElementTangent( l);
-				if(G_bVerbose)
-					FBXSDK_sprintf(header, 100, "\t\t\t\tTangent: ");
-
-				if(leTangent->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
-				{
-					switch (leTangent->GetReferenceMode())
-					{
-						case FbxGeometryElement::eDirect:
-						{
-							if(G_bVerbose)
-								Display3DVector(header, leTangent->GetDirectArray().GetAt(vertexId));
-
-							RECORD_VERTEX_TANG(leTangent->GetDirectArray().GetAt(vertexId));
-							foundTang = true;
-
-							break;
-						}
-
-						case FbxGeometryElement::eIndexToDirect:
-						{
-							int id = leTangent->GetIndexArray().GetAt(vertexId);
-							if(G_bVerbose)
-								Display3DVector(header, leTangent->GetDirectArray().GetAt(id));
-
-							RECORD_VERTEX_TANG(leTangent->GetDirectArray().GetAt(id));
-							foundTang = true;
-
-							break;
-						}
-
-						default:
-							break; // other reference modes not shown here!
-
-					} // end of switch(...GetReferenceMode())
+				const FbxVector4 & tangent = elements.tangent.Get(lControlPointIndex, vertexId);
+				LOG_VERBOSE("\t\t\t\tTangent: %g, %g, %g\n", tangent[0], tangent[1], tangent[2]);
 
-				} // end of if(...
-
-			} // end of tangent vector for(...GetElementTangentCount...)
-
-			if(!foundTang)
-			{
-				tan.idxs[j] = COMPONENT_NOT_FOUND_IDX;
+				RECORD_VERTEX_TANG(tangent);
 			}
 
 
 			///////////////////////////////////
 			// VERTEX BINORMAL VECTOR
 			///////////////////////////////////
-			bool foundBinormal = false;
-
-			for( l = 0; l < pMesh->GetElementBinormalCount(); ++l)
+			if(FIELDS & FIELD_BINORMAL)
 			{
-				FbxGeometryElementBinormal* leBinormal = pMesh->GetElementBinormal( l);
-
-				if(G_bVerbose)
-					FBXSDK_sprintf(header, 100, "\t\t\t\tBinormal: ");
-
-				if(leBinormal->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
-				{
-					switch (leBinormal->GetReferenceMode())
-					{
-						case FbxGeometryElement::eDirect:
-						{
-							if(G_bVerbose)
-								Display3DVector(header, leBinormal->GetDirectArray().GetAt(vertexId));
-
-							RECORD_VERTEX_BINORM(leBinormal->GetDirectArray().GetAt(vertexId));
-							foundBinormal = true;
-
-							break;
-						}
-
-						case FbxGeometryElement::eIndexToDirect:
-						{
-							int id = leBinormal->GetIndexArray().GetAt(vertexId);
-							if(G_bVerbose)
-								Display3DVector(header, leBinormal->GetDirectArray().GetAt(id));
-
-							RECORD_VERTEX_BINORM(leBinormal->GetDirectArray().GetAt(id));
-							foundBinormal = true;
+				const FbxVector4 & binormal = elements.binormal.Get(lControlPointIndex, vertexId);
+				LOG_VERBOSE("\t\t\t\tBinormal: %g, %g, %g\n", binormal[0], binormal[1], binormal[2]);
 
-							break;
-						}
-
-						default:
-							break; // other reference modes not shown here!
-
-					} // end of switch(...GetReferenceMode())
-
-				} // end of if(...
-
-			} // end of binormal loop: for(...GetElementBinormalCount...)
-
-			if(!foundBinormal)
-			{
-				bin.idxs[j] = COMPONENT_NOT_FOUND_IDX;
+				RECORD_VERTEX_BINORM(binormal);
 			}
 
-			vertexId++;
-
 		} // for polygonSize
 
 
@@ -584,55 +540,73 @@ bool ProcessMesh::ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref)
 
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		// MATERIAL INDEX
-		// Find material index (the fbx per-mesh index) for this poly
-		// Later we'll fix this list to reflect the indices into my global list of materials
-		// Determine which mesh part this vertex index should be added to based on the material that affects it.
+		// Find material index (the fbx per-mesh index) for this poly, one per material element, and
+		// record the index into my global list of materials for the whole file
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		MatList matList;
-		int meshPartIndex = -1;
-		int myMatIndex = 0;
-		const int elementMaterialCount = pMesh->GetElementMaterialCount();
+		matIds.resize(materialCnt);
+		for (size_t k = 0; k < materialCnt; ++k)
+			matIds[k] = matXref.newIndices[elements.materials[k].Get(i)];
 
-		// Should find a better way to do this, not every vertex :/
-		if(elementMaterialCount == 0)
-		{
-			// one material for the entire mesh, easy
-			FbxGeometryElementMaterial* elementMaterial = pMesh->GetElementMaterial(0);
-
-			FbxSurfaceMaterial* fbxMaterial = pMesh->GetNode()->GetMaterial(elementMaterial->GetIndexArray().GetAt(0));    
-			meshPartIndex = elementMaterial->GetIndexArray().GetAt(0);
-			myMatIndex = matXref.newIndices[meshPartIndex]; // find the mesh material in my global list of materials for the whole file and record it
-			GetWrtDataPtr()->SetMaterialAsUsed(myMatIndex); // I keep track of used materials so I can get rid of non-used ones
-			matList.list.push_back(myMatIndex);
-		}
-		else 
+
+
+		////////////////////////////////////////////////
+		// Add found polygon indices, one triangle at a time.  Missing components get a "not found" value
+		int triCnt = lPolygonSize - 2;
+
+		for (int t = 0; t < triCnt; t++)
 		{
-			// we have multiple materials for the mesh
-			for (int k = 0; k < elementMaterialCount; ++k)
+			for (int k = 0; k < 3; k++)
 			{
-				FbxGeometryElementMaterial* elementMaterial = pMesh->GetElementMaterial(k);
-				meshPartIndex = elementMaterial->GetIndexArray().GetAt(i);
-				myMatIndex = matXref.newIndices[meshPartIndex]; // find the mesh material in my global list of materials for the whole file and record it
-				GetWrtDataPtr()->SetMaterialAsUsed(myMatIndex); // I keep track of used materials so I can get rid of non-used ones
-				matList.list.push_back(myMatIndex);
+				int c = lPolygonSize == 3 ? k : polyTris[t].idxs[k]; // corner of the polygon
+
+				pos.idxs[k] = cPos[c];
+				col.idxs[k] = (FIELDS & FIELD_COLOR) ? cCol[c] : COMPONENT_NOT_FOUND_IDX;
+				uvs.idxs[k] = (FIELDS & FIELD_TEXCOORD) ? cUvs[c] : COMPONENT_NOT_FOUND_IDX;
+				nrm.idxs[k] = (FIELDS & FIELD_NORMAL) ? cNrm[c] : COMPONENT_NOT_FOUND_IDX;
+				tan.idxs[k] = (FIELDS & FIELD_TANGENT) ? cTan[c] : COMPONENT_NOT_FOUND_IDX;
+				bin.idxs[k] = (FIELDS & FIELD_BINORMAL) ? cBin[c] : COMPONENT_NOT_FOUND_IDX;
 			}
+
+			GetWrtDataPtr()->AddCoordTriIdxs(pos);
+			GetWrtDataPtr()->AddColorTriIdxs(col);
+			GetWrtDataPtr()->AddTexCoordTriIdxs(uvs);
+			GetWrtDataPtr()->AddNormTriIdxs(nrm);
+			GetWrtDataPtr()->AddTangTriIdxs(tan);
+			GetWrtDataPtr()->AddBinormTriIdxs(bin);
+			GetWrtDataPtr()->AddMaterialIdx(matIds.empty() ? NULL : &matIds[0], (int) materialCnt);
 		}
 
 
 
-		////////////////////////////////////////////////
-		// Add found polygon indices
-		GetWrtDataPtr()->AddCoordTriIdxs(pos);
-		GetWrtDataPtr()->AddColorTriIdxs(col);
-		GetWrtDataPtr()->AddTexCoordTriIdxs(uvs);
-		GetWrtDataPtr()->AddNormTriIdxs(nrm);
-		GetWrtDataPtr()->AddTangTriIdxs(tan);
-		GetWrtDataPtr()->AddBinormTriIdxs(bin);
-		GetWrtDataPtr()->AddMaterialIdx(matList);
+    } // for polygonCount
 
 
 
-    } // for polygonCount
+	GetWrtDataPtr()->QuantizeFrom(from);
+
+
+
+	////////////////////////////////////////////////
+	// Flag what got recorded per triangle corner, those are the ones that need welding
+	if(recordedAny)
+	{
+		UsingFields & usingFields = GetFileDataPtr()->meshData.m_usingFields;
+		UsingFields & perCorner = GetFileDataPtr()->meshData.m_perCorner;
+
+		usingFields.vpos = 1;
+		usingFields.vcolor |= (FIELDS & FIELD_COLOR) != 0;
+		usingFields.vtexCoord |= (FIELDS & FIELD_TEXCOORD) != 0;
+		usingFields.vnorm |= (FIELDS & FIELD_NORMAL) != 0;
+		usingFields.vtangent |= (FIELDS & FIELD_TANGENT) != 0;
+		usingFields.vbinormal |= (FIELDS & FIELD_BINORMAL) != 0;
+
+		perCorner.vpos |= !cpPos;
+		perCorner.vcolor |= (FIELDS & FIELD_COLOR) && !cpColor;
+		perCorner.vtexCoord |= (FIELDS & FIELD_TEXCOORD) && !cpUV;
+		perCorner.vnorm |= (FIELDS & FIELD_NORMAL) != 0;
+		perCorner.vtangent |= (FIELDS & FIELD_TANGENT) != 0;
+		perCorner.vbinormal |= (FIELDS & FIELD_BINORMAL) != 0;
+	}
 
 	return recordedAny;
 }
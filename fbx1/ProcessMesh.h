@@ -14,6 +14,8 @@
 #include "WriteData.h"
 #include "BaseProc.h"
 #include "ProcessMaterials.h"
+#include "TaskScheduler.h"
+#include "MeshElements.h"
 
 
 
@@ -28,11 +30,53 @@
 class ProcessMesh : public BaseProc
 {
 	public:
-		ProcessMesh(WriteData *pWrtData) : BaseProc(pWrtData) {} // this constructor has a compulsory argument that gets propagated to the base class
-		void Start(FbxNode *pNode, ProcessMaterials *pProcMat);
+		ProcessMesh(WriteData *pWrtData) : BaseProc(pWrtData), m_degenerateCnt(0), m_triangulatedCnt(0), m_concaveCnt(0) {} // this constructor has a compulsory argument that gets propagated to the base class
+		bool Start(FbxMesh *pMesh, const MaterialMeshXref &matXref);
 
 	private:
-		bool ProcessPolygonInfo(FbxMesh* pMesh, MaterialMeshXref &matXref); // go through all polygon data and record it into the m_pWriteData structure. Mark any materials used in my global list of materials
+		friend class MeshChunkTask;
+
+		// polygon counts for the mesh being processed
+		int m_degenerateCnt;	// less than 3 corners: discarded
+		int m_triangulatedCnt;	// quads and n-gons split into triangles
+		int m_concaveCnt;		// the ones of those that needed ear clipping
+
+		int GetChunkCount(int polygonCount);
+		void RecordControlPoints(FbxMesh* pMesh, const MeshElements &elements); // control point mode: positions (and colors/uv's mapped by control point) once per control point
+		bool ProcessChunks(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int chunkCnt); // split the polygons of a huge mesh over several tasks
+		bool ProcessPolygonInfo(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int firstPoly, int endPoly); // go through polygons [firstPoly, endPoly) and record them into the m_pWriteData structure
+
+		// the actual work of ProcessPolygonInfo, compiled once for every combination of vertex fields (FIELD_* bits in ProcessMesh.cpp)
+		template <unsigned FIELDS>
+		bool ProcessPolygons(FbxMesh* pMesh, const MeshElements &elements, const MaterialMeshXref &matXref, int firstPoly, int endPoly);
+};
+
+
+
+///////////////////////////////////////////////////////
+// One mesh extracted as a task, possibly on another
+// thread.  The mesh's materials must already be in
+// the file's material list (matXref): that list is
+// shared, so it's only touched during the traversal.
+// Everything else goes into the task's own fragment,
+// with indices starting at 0, which gets appended to
+// the file's data (WriteData::AppendMeshData) once
+// all tasks are done, in traversal order.  That keeps
+// the output identical to a serial run.
+///////////////////////////////////////////////////////
+class MeshTask : public Task
+{
+	public:
+		MeshTask(FbxMesh *pMesh) : m_instanceCnt(0), m_pMesh(pMesh), m_procMesh(&m_fragment) {}
+		virtual void Run() { m_procMesh.Start(m_pMesh, m_matXref); }
+
+		MaterialMeshXref m_matXref;	// filled in during the traversal, before the task is queued
+		WriteData m_fragment;		// this mesh's data only
+		int m_instanceCnt;			// nodes the mesh hangs off that haven't had the fragment appended yet
+
+	private:
+		FbxMesh *m_pMesh;
+		ProcessMesh m_procMesh;
 };
 
 
@@ -0,0 +1,263 @@
+//
+// Rounding of vertex values, whole arrays at a time
+//
+
+
+
+//
+// System headers
+//
+#include <immintrin.h>	// SSE4.1, AVX
+#include <stdlib.h>		// strtod
+#include <string.h>
+#include <float.h>		// FLT_MIN, FLT_MAX
+
+
+//
+// Project Includes
+//
+#include "Quantize.h"
+#include "CpuDispatch.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+QuantizePrecision G_precision =
+{
+	DEFAULT_PRECISION_POS, DEFAULT_PRECISION_NRM, DEFAULT_PRECISION_TEX,
+	DEFAULT_PRECISION_COL, DEFAULT_PRECISION_TAN, DEFAULT_PRECISION_BIN
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// FLOATS, in place
+////////////////////////////////////////////////////////////////////////////////////////
+static void QuantizeFloatsSSE41(float *pValues, size_t cnt, float precision)
+{
+	__m128 p = _mm_set1_ps(precision);
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(pValues + i);
+		_mm_storeu_ps(pValues + i, _mm_div_ps(_mm_floor_ps(_mm_mul_ps(v, p)), p));
+	}
+
+	for(; i < cnt; i++)
+		pValues[i] = QuantizeValue(pValues[i], precision);
+}
+
+
+
+static void QuantizeFloatsAVX(float *pValues, size_t cnt, float precision)
+{
+	__m256 p = _mm256_set1_ps(precision);
+	size_t i = 0;
+
+	for(; i + 8 <= cnt; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(pValues + i);
+		_mm256_storeu_ps(pValues + i, _mm256_div_ps(_mm256_floor_ps(_mm256_mul_ps(v, p)), p));
+	}
+
+	_mm256_zeroupper(); // no penalty for whatever SSE code runs next
+
+	for(; i < cnt; i++)
+		pValues[i] = QuantizeValue(pValues[i], precision);
+}
+
+
+
+static void QuantizeFloatsScalar(float *pValues, size_t cnt, float precision)
+{
+	for(size_t i = 0; i < cnt; i++)
+		pValues[i] = QuantizeValue(pValues[i], precision);
+}
+
+
+
+typedef void (*QuantizeFloatsFn)(float *pValues, size_t cnt, float precision);
+static const QuantizeFloatsFn G_quantizeFloats[CPU_LEVEL_COUNT] = { QuantizeFloatsScalar, QuantizeFloatsSSE41, QuantizeFloatsAVX };
+
+void QuantizeFloats(float *pValues, size_t cnt, float precision)
+{
+	CpuSelect(G_quantizeFloats)(pValues, cnt, precision);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// FBXVECTOR4'S: doubles in, one float lane per component out
+////////////////////////////////////////////////////////////////////////////////////////
+static void QuantizeVector4sScalar(const double *pSrc, size_t first, size_t cnt, float *pX, float *pY, float *pZ, float precision)
+{
+	for(size_t i = first; i < cnt; i++)
+	{
+		pX[i] = QuantizeValue((float) pSrc[4 * i + 0], precision);
+		pY[i] = QuantizeValue((float) pSrc[4 * i + 1], precision);
+		pZ[i] = QuantizeValue((float) pSrc[4 * i + 2], precision);
+	}
+}
+
+
+
+// 4 vectors at a time: (x,y) and (z,w) halves converted, then shuffled into x's, y's and z's
+static void QuantizeVector4sSSE41(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision)
+{
+	__m128 p = _mm_set1_ps(precision);
+	size_t i = 0;
+
+	for(; i + 4 <= cnt; i += 4)
+	{
+		const double *s = pSrc + 4 * i;
+
+		__m128 xy01 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 0)), _mm_cvtpd_ps(_mm_loadu_pd(s + 4)));	// x0 y0 x1 y1
+		__m128 xy23 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 8)), _mm_cvtpd_ps(_mm_loadu_pd(s + 12)));	// x2 y2 x3 y3
+		__m128 zw01 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 2)), _mm_cvtpd_ps(_mm_loadu_pd(s + 6)));	// z0 w0 z1 w1
+		__m128 zw23 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 10)), _mm_cvtpd_ps(_mm_loadu_pd(s + 14)));	// z2 w2 z3 w3
+
+		__m128 x = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 y = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 z = _mm_shuffle_ps(zw01, zw23, _MM_SHUFFLE(2, 0, 2, 0));
+
+		_mm_storeu_ps(pX + i, _mm_div_ps(_mm_floor_ps(_mm_mul_ps(x, p)), p));
+		_mm_storeu_ps(pY + i, _mm_div_ps(_mm_floor_ps(_mm_mul_ps(y, p)), p));
+		_mm_storeu_ps(pZ + i, _mm_div_ps(_mm_floor_ps(_mm_mul_ps(z, p)), p));
+	}
+
+	QuantizeVector4sScalar(pSrc, i, cnt, pX, pY, pZ, precision);
+}
+
+
+
+// 4 vectors transposed in registers (4x4 doubles), twice, then rounded 8 at a time
+static inline void TransposeVector4s(const double *s, __m128 & x, __m128 & y, __m128 & z)
+{
+	__m256d r0 = _mm256_loadu_pd(s + 0);
+	__m256d r1 = _mm256_loadu_pd(s + 4);
+	__m256d r2 = _mm256_loadu_pd(s + 8);
+	__m256d r3 = _mm256_loadu_pd(s + 12);
+
+	__m256d t0 = _mm256_unpacklo_pd(r0, r1);	// x0 x1 z0 z1
+	__m256d t1 = _mm256_unpackhi_pd(r0, r1);	// y0 y1 w0 w1
+	__m256d t2 = _mm256_unpacklo_pd(r2, r3);	// x2 x3 z2 z3
+	__m256d t3 = _mm256_unpackhi_pd(r2, r3);	// y2 y3 w2 w3
+
+	x = _mm256_cvtpd_ps(_mm256_permute2f128_pd(t0, t2, 0x20));
+	y = _mm256_cvtpd_ps(_mm256_permute2f128_pd(t1, t3, 0x20));
+	z = _mm256_cvtpd_ps(_mm256_permute2f128_pd(t0, t2, 0x31));
+}
+
+
+
+static void QuantizeVector4sAVX(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision)
+{
+	__m256 p = _mm256_set1_ps(precision);
+	size_t i = 0;
+
+	for(; i + 8 <= cnt; i += 8)
+	{
+		__m128 x0, y0, z0, x1, y1, z1;
+
+		TransposeVector4s(pSrc + 4 * i, x0, y0, z0);
+		TransposeVector4s(pSrc + 4 * i + 16, x1, y1, z1);
+
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+		__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+
+		_mm256_storeu_ps(pX + i, _mm256_div_ps(_mm256_floor_ps(_mm256_mul_ps(x, p)), p));
+		_mm256_storeu_ps(pY + i, _mm256_div_ps(_mm256_floor_ps(_mm256_mul_ps(y, p)), p));
+		_mm256_storeu_ps(pZ + i, _mm256_div_ps(_mm256_floor_ps(_mm256_mul_ps(z, p)), p));
+	}
+
+	_mm256_zeroupper();
+
+	QuantizeVector4sScalar(pSrc, i, cnt, pX, pY, pZ, precision);
+}
+
+
+
+static void QuantizeVector4sAll(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision)
+{
+	QuantizeVector4sScalar(pSrc, 0, cnt, pX, pY, pZ, precision);
+}
+
+
+
+typedef void (*QuantizeVector4sFn)(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision);
+static const QuantizeVector4sFn G_quantizeVector4s[CPU_LEVEL_COUNT] = { QuantizeVector4sAll, QuantizeVector4sSSE41, QuantizeVector4sAVX };
+
+void QuantizeVector4s(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision)
+{
+	CpuSelect(G_quantizeVector4s)(pSrc, cnt, pX, pY, pZ, precision);
+}
+
+
+
+CpuLevel GetQuantizeLevel()
+{
+	return CpuSelectedLevel(G_quantizeFloats);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// "pos=10000,nrm=1000" etc.  Names not given keep their value.  Anything but a number
+// right up to the next ',' (i.e. "pos=10x") fails
+////////////////////////////////////////////////////////////////////////////////////////
+bool ParseAttributeFloats(const char *pList, AttributeFloats & values, float minValue)
+{
+	struct { const char *pName; float *pValue; } fields[] =
+	{
+		{ "pos", &values.pos }, { "nrm", &values.nrm }, { "tex", &values.tex },
+		{ "col", &values.col }, { "tan", &values.tan }, { "bin", &values.bin }
+	};
+	const int fieldCnt = sizeof(fields) / sizeof(fields[0]);
+
+	while(*pList)
+	{
+		const char *pEqual = strchr(pList, '=');
+		if(!pEqual)
+			return false;
+
+		int f;
+		size_t nameLen = pEqual - pList;
+		for(f = 0; f < fieldCnt; f++)
+		{
+			if(strlen(fields[f].pName) == nameLen && strncmp(pList, fields[f].pName, nameLen) == 0)
+				break;
+		}
+
+		char *pEnd;
+		double value = strtod(pEqual + 1, &pEnd);
+		if(f == fieldCnt || pEnd == pEqual + 1 || (*pEnd != ',' && *pEnd != 0))
+			return false;
+
+		// also rejects nan, and anything a float can't hold
+		if(!(value >= minValue && value <= FLT_MAX))
+			return false;
+
+		*fields[f].pValue = (float) value;
+
+		if(!*pEnd)
+			break;
+		pList = pEnd + 1;
+	}
+
+	return true;
+}
+
+
+
+bool ParsePrecision(const char *pList, QuantizePrecision & precision)
+{
+	return ParseAttributeFloats(pList, precision, FLT_MIN); // no rounding to steps of 0
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////
+// QUANTIZE.H
+//
+// Rounding of vertex values, so values that are
+// 'close enough' end up identical and weld
+// together: value = floor(value * precision) /
+// precision.
+// Works on whole arrays (the lanes of a
+// SoAArray) instead of one float at a time:
+// SSE4.1 and AVX versions do 4 or 8 floats per
+// instruction, picked at run time (see
+// CpuDispatch.h).  All versions give bit
+// identical results (same float multiply, floor
+// and divide, nothing fused or approximated).
+// The precision of every kind of value can be
+// set from the command line (-p).
+////////////////////////////////////////////////
+
+
+#ifndef _QUANTIZE_H_
+#define _QUANTIZE_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stddef.h>
+
+#include "DataTypes.h"
+#include "CpuDispatch.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+// defaults: steps of 1/10000th of a unit.  A tenth of a millimeter for positions in meters
+#define DEFAULT_PRECISION_POS	10000.0f
+#define DEFAULT_PRECISION_NRM	10000.0f
+#define DEFAULT_PRECISION_TEX	10000.0f
+#define DEFAULT_PRECISION_COL	10000.0f
+#define DEFAULT_PRECISION_TAN	10000.0f
+#define DEFAULT_PRECISION_BIN	10000.0f
+
+
+
+
+/*----------------------------------------------------------------------------
+	Types:
+----------------------------------------------------------------------------*/
+
+typedef AttributeFloats QuantizePrecision;	// steps per unit for every kind of vertex value
+
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+extern QuantizePrecision G_precision;
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// One value.  What every version of the kernels computes, kept in float all the way
+inline float QuantizeValue(float value, float precision)
+{
+	return floorf(value * precision) / precision;
+}
+
+// round 'cnt' floats in place
+void QuantizeFloats(float *pValues, size_t cnt, float precision);
+
+// Convert 'cnt' FbxVector4's (4 doubles each, w is ignored) to floats and round them in the same pass,
+// x's to 'pX', y's to 'pY' and z's to 'pZ'
+void QuantizeVector4s(const double *pSrc, size_t cnt, float *pX, float *pY, float *pZ, float precision);
+
+// Parse "pos=10000,nrm=1000,tex=4096,col=255,tan=1000,bin=1000" (any subset) into 'precision'
+bool ParsePrecision(const char *pList, QuantizePrecision & precision);
+
+// Same list, for any per attribute setting.  Values below 'minValue' are refused
+bool ParseAttributeFloats(const char *pList, AttributeFloats & values, float minValue);
+
+CpuLevel GetQuantizeLevel();	// the version picked for this CPU
+
+
+
+#endif // _QUANTIZE_H_
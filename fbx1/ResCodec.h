@@ -0,0 +1,138 @@
+////////////////////////////////////////////////
+// RESCODEC.H
+//
+// Compressing and decompressing the chunks of
+// compressed .res sections (see ResFormat.h),
+// for the writer and for readers alike.
+// LZ4 is always there (Lz4.h).  Zstandard needs
+// the library: build with FBX1_HAVE_ZSTD defined,
+// zstd.h on the include path and libzstd linked.
+// Without it Zstd sections can't be written or
+// read.
+////////////////////////////////////////////////
+
+
+#ifndef _RES_CODEC_H_
+#define _RES_CODEC_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <string.h>		// strcmp
+
+#include "ResFormat.h"
+#include "Lz4.h"
+
+#ifdef FBX1_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define RES_ZSTD_LEVEL		3		// zstd's own default: most of the gain at a fraction of the time
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+inline const char *GetResCodecName(ResCodec codec)
+{
+	static const char * const names[RES_CODEC_COUNT] = { "none", "lz4", "zstd" };
+	return codec >= 0 && codec < RES_CODEC_COUNT ? names[codec] : "unknown";
+}
+
+
+
+// built in?
+inline bool IsResCodecAvailable(ResCodec codec)
+{
+#ifdef FBX1_HAVE_ZSTD
+	return codec >= 0 && codec < RES_CODEC_COUNT;
+#else
+	return codec == RES_CODEC_NONE || codec == RES_CODEC_LZ4;
+#endif
+}
+
+
+
+// "none", "lz4" or "zstd"
+inline bool ParseResCodec(const char *pName, ResCodec & codec)
+{
+	for(int c = 0; c < RES_CODEC_COUNT; c++)
+	{
+		if(strcmp(pName, GetResCodecName((ResCodec) c)) == 0)
+		{
+			codec = (ResCodec) c;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+// compressed size, or 0 if it didn't fit in 'capacity' bytes (or the codec isn't built in)
+inline size_t ResCompressChunk(ResCodec codec, const void *pSrc, size_t size, void *pDst, size_t capacity)
+{
+	switch(codec)
+	{
+		case RES_CODEC_LZ4:
+			return Lz4Compress(pSrc, size, pDst, capacity);
+
+#ifdef FBX1_HAVE_ZSTD
+		case RES_CODEC_ZSTD:
+		{
+			size_t result = ZSTD_compress(pDst, capacity, pSrc, size, RES_ZSTD_LEVEL);
+			return ZSTD_isError(result) ? 0 : result;
+		}
+#endif
+
+		default:
+			return 0;
+	}
+}
+
+
+
+// false if the chunk is damaged, doesn't decompress to exactly 'dstSize' bytes, or the codec isn't built in
+inline bool ResDecompressChunk(ResCodec codec, const void *pSrc, size_t srcSize, void *pDst, size_t dstSize)
+{
+	switch(codec)
+	{
+		case RES_CODEC_NONE:
+			if(srcSize != dstSize)
+				return false;
+			memcpy(pDst, pSrc, srcSize);
+			return true;
+
+		case RES_CODEC_LZ4:
+			return Lz4Decompress(pSrc, srcSize, pDst, dstSize);
+
+#ifdef FBX1_HAVE_ZSTD
+		case RES_CODEC_ZSTD:
+		{
+			size_t result = ZSTD_decompress(pDst, dstSize, pSrc, srcSize);
+			return !ZSTD_isError(result) && result == dstSize;
+		}
+#endif
+
+		default:
+			return false;
+	}
+}
+
+
+
+#endif // _RES_CODEC_H_
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////
+// RESFORMAT.H
+//
+// Layout of the .res files we write: made to be
+// mapped into memory and used in place, with no
+// parsing and no allocation at load time.
+// - a header, then a table of sections (maybe
+//   with unused room after it), then the
+//   sections, each one starting on a 64 byte
+//   boundary (cache line, and plenty for SIMD
+//   loads)
+// - a section is an array of fixed size records
+//   or plain values, found by type in the table
+// - every reference is an offset or an index:
+//   strings are byte offsets into the strings
+//   section, materials index the materials
+//   section, etc.  No pointers
+// - big arrays may be compressed (ResSection::
+//   codec), cut into chunks that each decompress
+//   on their own: any part of the section can be
+//   read without the rest, and the chunks spread
+//   over every core.  Such a section holds the
+//   compressed chunks back to back, then (on an
+//   8 byte boundary) the ResChunk table, which
+//   ends the section.  Everything else is stored
+//   as is and used in place
+// - every section has an xxHash64 of its data
+//   (uncompressed), for readers to check when
+//   they want to: nothing needs it to load
+// - little endian, like every machine we load on
+// Only fixed size types in here, so the layout
+// is the same for every compiler: the sizes are
+// checked below.
+// Readers should check the magic, the version
+// and the endian tag, then look sections up by
+// type; unknown section types are skipped, so
+// new ones can be added without a new version.
+// ResReader.h reads them.
+////////////////////////////////////////////////
+
+
+#ifndef _RES_FORMAT_H_
+#define _RES_FORMAT_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#if !defined(_MSC_VER) && !defined(__int64)
+#define __int64 long long	// readers built with other compilers
+#endif
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define RES_MAGIC				0x52584246	// "FBXR"
+#define RES_VERSION				3			// 2: compressed sections.  3: section hashes
+#define RES_ENDIAN_TAG			0x01020304	// reads back as 0x04030201 on the wrong endianness
+#define RES_SECTION_ALIGNMENT	64
+#define RES_CHUNK_ALIGNMENT		8			// of the chunk table of a compressed section
+#define RES_CHUNK_SIZE			(1 << 18)	// uncompressed bytes per chunk: big enough to compress well, small enough for L2
+
+#define RES_VERTEX_COMPONENTS	6			// VertexComponent: pos, nrm, tex, col, tan, bin
+#define RES_NO_OFFSET			-1			// ResScene::vertexOffsets of components the vertices don't have
+#define RES_MATERIALS_MIXED		-1			// ResScene::materialStride: triangles don't all have as many materials
+
+// ResTexture::flags
+#define RES_TEXTURE_PROCEDURAL			0x01
+#define RES_TEXTURE_LAYERED				0x02
+#define RES_TEXTURE_DEFAULT_MATERIAL	0x04
+#define RES_TEXTURE_SWAP_UV				0x08
+
+// ResLight::flags
+#define RES_LIGHT_CAST					0x01
+#define RES_LIGHT_GOBO					0x02
+#define RES_LIGHT_GOBO_TO_GROUND		0x04
+#define RES_LIGHT_GOBO_VOLUMETRIC		0x08
+#define RES_LIGHT_GOBO_FRONT_VOLUMETRIC	0x10
+
+
+
+
+/*----------------------------------------------------------------------------
+	Sections:  what's in each of them.  Counts are in the section table
+----------------------------------------------------------------------------*/
+
+enum ResSectionType
+{
+	RES_SECTION_SCENE = 1,				// 1 ResScene
+	RES_SECTION_STRINGS,				// chars: zero terminated strings, back to back
+	RES_SECTION_VERTICES,				// floats: ResScene::vertexStride bytes per vertex, all the components interleaved
+	RES_SECTION_INDICES,				// unsigned ints: 3 per triangle, into the vertices
+	RES_SECTION_POSITIONS,				// float[3] each: welded values, what the component indices point at
+	RES_SECTION_NORMALS,				// float[3]
+	RES_SECTION_TEXCOORDS,				// float[2]
+	RES_SECTION_COLORS,					// float[4]
+	RES_SECTION_TANGENTS,				// float[3]
+	RES_SECTION_BINORMALS,				// float[3]
+	RES_SECTION_POSITION_INDICES,		// ints: 3 per triangle, into the positions (shared corners, for adjacency, collision, ...)
+	RES_SECTION_TRIANGLE_MATERIALS,		// ints: the materials of every triangle, back to back, -1 = none.  ResScene::materialStride per triangle
+	RES_SECTION_TRIANGLE_MATERIAL_OFFSETS,	// unsigned ints, only if that's RES_MATERIALS_MIXED: triangle t's materials go from [t] up to [t + 1]
+	RES_SECTION_MATERIALS,				// ResMaterial each
+	RES_SECTION_MATERIAL_TEXTURES,		// unsigned ints: texture indices of all the materials, back to back
+	RES_SECTION_TEXTURES,				// ResTexture each
+	RES_SECTION_LIGHTS,					// ResLight each
+
+	RES_SECTION_TYPE_END				// one past the last type
+};
+
+
+
+
+enum ResCodec
+{
+	RES_CODEC_NONE,						// stored as is
+	RES_CODEC_LZ4,						// LZ4 blocks: fast to decompress
+	RES_CODEC_ZSTD,						// Zstandard frames: smaller, slower
+	RES_CODEC_COUNT
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Structs:
+----------------------------------------------------------------------------*/
+
+struct ResHeader
+{
+	unsigned int magic;					// RES_MAGIC
+	unsigned int version;				// RES_VERSION
+	unsigned int endianTag;				// RES_ENDIAN_TAG
+	unsigned int headerSize;			// sizeof(ResHeader)
+	unsigned int sectionCount;
+	unsigned int sectionSize;			// sizeof(ResSection)
+	unsigned __int64 sectionTableOffset;
+	unsigned __int64 fileSize;
+	unsigned __int64 reserved64;		// must be 0.  The data is covered by the section hashes
+	unsigned int reserved[4];
+};
+
+struct ResSection
+{
+	unsigned int type;					// ResSectionType
+	unsigned int elementSize;			// bytes per element
+	unsigned __int64 offset;			// from the start of the file, a multiple of RES_SECTION_ALIGNMENT
+	unsigned __int64 size;				// bytes, uncompressed
+	unsigned __int64 count;				// elements
+	unsigned __int64 storedSize;		// bytes in the file, chunk table included.  'size' if not compressed
+	unsigned int codec;					// ResCodec.  RES_CODEC_NONE = the data's right there, use it in place
+	unsigned int chunkSize;				// compressed: uncompressed bytes per chunk, the last one can be short
+	unsigned __int64 hash;				// xxHash64 (seed 0) of the 'size' bytes of data, once uncompressed
+};
+
+// one chunk of a compressed section.  Chunk i decompresses to bytes [i * chunkSize, (i + 1) * chunkSize)
+// of the section
+struct ResChunk
+{
+	unsigned __int64 offset;			// from the start of the section
+	unsigned int storedSize;			// bytes
+	unsigned int codec;					// RES_CODEC_NONE if it didn't get any smaller: stored as is
+};
+
+struct ResScene
+{
+	float bbMin[3];						// bounding box of the positions
+	float bbMax[3];
+	float ambient[4];					// global ambient color
+	unsigned int vertexCount;
+	unsigned int vertexStride;			// bytes per vertex
+	int vertexOffsets[RES_VERTEX_COMPONENTS];	// where each component starts in a vertex, in bytes.  RES_NO_OFFSET if missing
+	unsigned int triangleCount;
+	int materialStride;					// materials per triangle, or RES_MATERIALS_MIXED
+};
+
+struct ResMaterial
+{
+	unsigned int name;					// in the strings
+	unsigned int shadingModel;			// ShadingModel
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float emissive[4];
+	float opacity;
+	float shininess;
+	float reflectivity;
+	unsigned int firstTexture;			// in RES_SECTION_MATERIAL_TEXTURES
+	unsigned int textureCount;
+	unsigned int reserved;
+};
+
+struct ResTexture
+{
+	unsigned int name;					// in the strings
+	unsigned int filename;				// in the strings, full path
+	unsigned int alphaSource;			// TexAlphaSource
+	unsigned int mappingType;			// TexMappingType
+	unsigned int planarNormals;			// TexPlanarMappingNormals
+	unsigned int blendMode;				// TexBlendModes
+	unsigned int usedFor;				// TexUsedFor
+	unsigned int flags;					// RES_TEXTURE_*
+	float scaleU, scaleV;
+	float translateU, translateV;
+	float rotateU, rotateV, rotateW;
+	float cropLeft, cropTop, cropRight, cropBottom;
+	float defaultAlpha;
+};
+
+struct ResLight
+{
+	unsigned int name;					// in the strings
+	unsigned int type;					// LightTypes
+	unsigned int flags;					// RES_LIGHT_*
+	unsigned int goboFilename;			// in the strings
+	float color[4];
+	float intensity;
+	float outerAngle;
+	float fog;
+	unsigned int reserved;
+};
+
+
+
+// the layout may not depend on the compiler
+static_assert(sizeof(ResHeader) == 64, "ResHeader layout");
+static_assert(sizeof(ResSection) == 56, "ResSection layout");
+static_assert(sizeof(ResChunk) == 16, "ResChunk layout");
+static_assert(sizeof(ResScene) == 80, "ResScene layout");
+static_assert(sizeof(ResMaterial) == 96, "ResMaterial layout");
+static_assert(sizeof(ResTexture) == 80, "ResTexture layout");
+static_assert(sizeof(ResLight) == 48, "ResLight layout");
+
+
+
+#endif // _RES_FORMAT_H_
@@ -0,0 +1,389 @@
+////////////////////////////////////////////////
+// RESREADER.H
+//
+// Reads the .res files we write (ResFormat.h),
+// for the engine and the tools alike.  Header
+// only: nothing to link, but libzstd for files
+// with Zstd sections (see ResCodec.h).
+// - Open maps the file and checks the header
+//   and the section table.  Nothing else gets
+//   touched until it's asked for
+// - sections come out as typed spans, of the
+//   same types as FileData (Vec3, Int3, ...) or
+//   of the Res records.  Uncompressed sections
+//   point straight into the mapping; compressed
+//   ones are decompressed the first time
+//   they're asked for, and kept
+// - the section hashes are only checked by
+//   VerifySection / Verify, never on the way in
+// Not thread safe: decompressing changes the
+// reader.  Get the sections needed from one
+// thread first, or use a reader per thread.
+////////////////////////////////////////////////
+
+
+#ifndef _RES_READER_H_
+#define _RES_READER_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>		// sprintf
+#include <string.h>		// memcpy
+#include <assert.h>
+#include <string>
+#include <vector>
+
+#include "ResFormat.h"
+#include "ResCodec.h"
+#include "XXHash64.h"
+#include "DataTypes.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+// the spans cast the arrays straight to these
+static_assert(sizeof(Vec3) == 3 * sizeof(float) && sizeof(TexCoord) == 2 * sizeof(float) && sizeof(ColorRGBA) == 4 * sizeof(float) &&
+			  sizeof(Int3) == 3 * sizeof(int), "FileData types don't match the .res arrays");
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+// A read only view of 'count' T's, in the mapping or in the reader's own memory.  Good until
+// the reader is closed
+template <class T> class ResSpan
+{
+	public:
+		ResSpan() : m_p(NULL), m_count(0) {}
+		ResSpan(const T *p, size_t count) : m_p(p), m_count(count) {}
+
+		size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+		const T *data() const { return m_p; }
+		const T *begin() const { return m_p; }
+		const T *end() const { return m_p + m_count; }
+		const T & operator [](size_t i) const { assert(i < m_count); return m_p[i]; }
+
+	private:
+		const T *m_p;
+		size_t m_count;
+};
+
+
+
+class ResReader
+{
+	public:
+		ResReader() : m_pBase(NULL), m_size(0) {}
+		~ResReader() { Close(); }
+
+		// false if it can't be mapped or isn't a .res file of this version: GetError says why
+		bool Open(const char *pFilename)
+		{
+			Close();
+
+			if(!Map(pFilename))
+				return false;
+
+			if(!CheckLayout())
+			{
+				string error = m_error;
+				Close();
+				m_error = error;
+				return false;
+			}
+
+			m_data.assign(GetSectionCount(), (const void *) NULL);
+			m_decompressed.resize(GetSectionCount());
+			return true;
+		}
+
+		void Close()
+		{
+			if(m_pBase)
+			{
+#ifdef _WIN32
+				UnmapViewOfFile(m_pBase);
+#else
+				munmap((void *) m_pBase, m_size);
+#endif
+			}
+
+			m_pBase = NULL;
+			m_size = 0;
+			m_data.clear();
+			vector< vector<char> >().swap(m_decompressed);
+			m_error.clear();
+		}
+
+		bool IsOpen() const { return m_pBase != NULL; }
+		const char *GetError() const { return m_error.c_str(); }
+
+		const ResHeader & GetHeader() const { assert(IsOpen()); return *(const ResHeader *) m_pBase; }
+		unsigned int GetSectionCount() const { return GetHeader().sectionCount; }
+		const ResSection *GetSection(unsigned int i) const { assert(i < GetSectionCount()); return (const ResSection *) (m_pBase + GetHeader().sectionTableOffset) + i; }
+
+		// NULL if the file doesn't have one
+		const ResSection *FindSection(ResSectionType type) const
+		{
+			for(unsigned int i = 0; i < GetSectionCount(); i++)
+			{
+				if(GetSection(i)->type == (unsigned int) type)
+					return GetSection(i);
+			}
+
+			return NULL;
+		}
+
+		// the section's bytes, uncompressed.  NULL if a compressed section is damaged
+		const void *GetData(const ResSection *pSection)
+		{
+			unsigned int i = (unsigned int) (pSection - GetSection(0));
+			assert(i < GetSectionCount());
+
+			if(!m_data[i])
+			{
+				if(pSection->codec == RES_CODEC_NONE)
+					m_data[i] = m_pBase + pSection->offset;
+				else if(Decompress(pSection, m_decompressed[i]))
+					m_data[i] = m_decompressed[i].empty() ? m_pBase + pSection->offset : &m_decompressed[i][0];
+			}
+
+			return m_data[i];
+		}
+
+		// a section as T's.  Empty if it's missing, damaged, or doesn't split into T's
+		template <class T> ResSpan<T> GetSpan(ResSectionType type)
+		{
+			const ResSection *pSection = FindSection(type);
+			if(!pSection || pSection->size % sizeof(T) != 0)
+				return ResSpan<T>();
+
+			// whole elements per T (Int3 out of ints), or whole T's per element (floats out of vertices)
+			if(sizeof(T) % pSection->elementSize != 0 && pSection->elementSize % sizeof(T) != 0)
+				return ResSpan<T>();
+
+			const T *p = (const T *) GetData(pSection);
+			return p ? ResSpan<T>(p, (size_t) (pSection->size / sizeof(T))) : ResSpan<T>();
+		}
+
+		// typed access to the sections WriteData saves
+		const ResScene *GetScene() { ResSpan<ResScene> scene = GetSpan<ResScene>(RES_SECTION_SCENE); return scene.empty() ? NULL : &scene[0]; }
+
+		ResSpan<float> GetVertices() { return GetSpan<float>(RES_SECTION_VERTICES); }						// ResScene::vertexStride bytes each
+		ResSpan<unsigned int> GetIndices() { return GetSpan<unsigned int>(RES_SECTION_INDICES); }
+
+		ResSpan<Vec3> GetPositions() { return GetSpan<Vec3>(RES_SECTION_POSITIONS); }
+		ResSpan<Vec3> GetNormals() { return GetSpan<Vec3>(RES_SECTION_NORMALS); }
+		ResSpan<TexCoord> GetTexCoords() { return GetSpan<TexCoord>(RES_SECTION_TEXCOORDS); }
+		ResSpan<ColorRGBA> GetColors() { return GetSpan<ColorRGBA>(RES_SECTION_COLORS); }
+		ResSpan<Vec3> GetTangents() { return GetSpan<Vec3>(RES_SECTION_TANGENTS); }
+		ResSpan<Vec3> GetBinormals() { return GetSpan<Vec3>(RES_SECTION_BINORMALS); }
+		ResSpan<Int3> GetPositionIndices() { return GetSpan<Int3>(RES_SECTION_POSITION_INDICES); }			// a triangle each, into GetPositions
+
+		ResSpan<int> GetTriangleMaterials() { return GetSpan<int>(RES_SECTION_TRIANGLE_MATERIALS); }
+		ResSpan<unsigned int> GetTriangleMaterialOffsets() { return GetSpan<unsigned int>(RES_SECTION_TRIANGLE_MATERIAL_OFFSETS); }
+
+		ResSpan<ResMaterial> GetMaterials() { return GetSpan<ResMaterial>(RES_SECTION_MATERIALS); }
+		ResSpan<unsigned int> GetMaterialTextures() { return GetSpan<unsigned int>(RES_SECTION_MATERIAL_TEXTURES); }
+		ResSpan<ResTexture> GetTextures() { return GetSpan<ResTexture>(RES_SECTION_TEXTURES); }
+		ResSpan<ResLight> GetLights() { return GetSpan<ResLight>(RES_SECTION_LIGHTS); }
+
+		// "" if it's out of range
+		const char *GetString(unsigned int offset)
+		{
+			ResSpan<char> strings = GetSpan<char>(RES_SECTION_STRINGS);
+			return offset < strings.size() && strings[strings.size() - 1] == '\0' ? &strings[offset] : "";
+		}
+
+		// hash the section's data (decompressing it if need be) and check it against the table
+		bool VerifySection(const ResSection *pSection)
+		{
+			const void *pData = GetData(pSection);
+			if(!pData)
+				return false;
+
+			if(XXHash64::Hash(pData, (size_t) pSection->size) != pSection->hash)
+				return Fail("section of type %u doesn't match its hash", pSection->type);
+
+			return true;
+		}
+
+		// every section.  Stops at the first bad one
+		bool Verify()
+		{
+			for(unsigned int i = 0; i < GetSectionCount(); i++)
+			{
+				if(!VerifySection(GetSection(i)))
+					return false;
+			}
+
+			return true;
+		}
+
+	private:
+		const char *m_pBase;					// the mapping, the whole file
+		size_t m_size;
+		vector<const void *> m_data;			// per section: its uncompressed bytes, NULL = not asked for yet
+		vector< vector<char> > m_decompressed;	// per section: the bytes of compressed sections
+		string m_error;
+
+		bool Fail(const char *pFormat, unsigned int value = 0)
+		{
+			char text[256];
+			sprintf(text, pFormat, value);
+			m_error = text;
+			return false;
+		}
+
+		bool Map(const char *pFilename)
+		{
+#ifdef _WIN32
+			HANDLE hFile = CreateFileA(pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(hFile == INVALID_HANDLE_VALUE)
+				return Fail("can't open the file");
+
+			LARGE_INTEGER size;
+			if(!GetFileSizeEx(hFile, &size) || (unsigned __int64) size.QuadPart < sizeof(ResHeader) || (unsigned __int64) size.QuadPart > (size_t) -1)
+			{
+				CloseHandle(hFile);
+				return Fail("not a .res file (or too big to map)");
+			}
+
+			// the view keeps the file open
+			HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			CloseHandle(hFile);
+			if(!hMapping)
+				return Fail("can't map the file");
+
+			m_pBase = (const char *) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(hMapping);
+			m_size = (size_t) size.QuadPart;
+#else
+			int fd = open(pFilename, O_RDONLY);
+			if(fd < 0)
+				return Fail("can't open the file");
+
+			struct stat info;
+			if(fstat(fd, &info) != 0 || (unsigned __int64) info.st_size < sizeof(ResHeader) || (unsigned __int64) info.st_size > (size_t) -1)
+			{
+				close(fd);
+				return Fail("not a .res file (or too big to map)");
+			}
+
+			// the mapping keeps the file open
+			void *p = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			m_pBase = p != MAP_FAILED ? (const char *) p : NULL;
+			m_size = (size_t) info.st_size;
+#endif
+
+			if(!m_pBase)
+			{
+				m_size = 0;
+				return Fail("can't map the file");
+			}
+
+			return true;
+		}
+
+		// everything Open promises: the header's ours, every section lies within the file
+		bool CheckLayout()
+		{
+			const ResHeader & header = GetHeader();
+
+			if(header.magic != RES_MAGIC)
+				return Fail("not a .res file");
+			if(header.endianTag != RES_ENDIAN_TAG)
+				return Fail("written with the other endianness");
+			if(header.version != RES_VERSION)
+				return Fail("version %u, not the one this reader reads", header.version);
+			if(header.headerSize != sizeof(ResHeader) || header.sectionSize != sizeof(ResSection) || header.fileSize != m_size)
+				return Fail("damaged header");
+			if(header.sectionTableOffset % sizeof(unsigned __int64) != 0 || header.sectionTableOffset > m_size ||
+			   header.sectionCount > (m_size - header.sectionTableOffset) / sizeof(ResSection))
+				return Fail("damaged section table");
+
+			for(unsigned int i = 0; i < header.sectionCount; i++)
+			{
+				const ResSection & section = *GetSection(i);
+
+				// divided, not multiplied: a crafted count could wrap count * elementSize around to the size
+				if(section.offset % RES_SECTION_ALIGNMENT != 0 || section.offset > m_size || section.storedSize > m_size - section.offset ||
+				   section.elementSize == 0 || section.size % section.elementSize != 0 || section.count != section.size / section.elementSize ||
+				   section.size > (size_t) -1)
+					return Fail("damaged section of type %u", section.type);
+
+				if(section.codec == RES_CODEC_NONE ? section.storedSize != section.size : section.chunkSize == 0)
+					return Fail("damaged section of type %u", section.type);
+			}
+
+			return true;
+		}
+
+		bool Decompress(const ResSection *pSection, vector<char> & data)
+		{
+			if(!IsResCodecAvailable((ResCodec) pSection->codec))
+				return Fail("section of type %u needs a codec this reader wasn't built with", pSection->type);
+
+			// the chunk table ends the section
+			unsigned __int64 chunkCnt = pSection->size / pSection->chunkSize + (pSection->size % pSection->chunkSize != 0 ? 1 : 0);
+			if(chunkCnt > pSection->storedSize / sizeof(ResChunk))
+				return Fail("damaged section of type %u", pSection->type);
+
+			unsigned __int64 tableOffset = pSection->storedSize - chunkCnt * sizeof(ResChunk);
+			if(tableOffset % RES_CHUNK_ALIGNMENT != 0)
+				return Fail("damaged section of type %u", pSection->type);
+
+			const char *pStored = m_pBase + pSection->offset;
+			const ResChunk *pChunks = (const ResChunk *) (pStored + tableOffset);
+
+			data.resize((size_t) pSection->size);
+
+			for(size_t c = 0; c < (size_t) chunkCnt; c++)
+			{
+				const ResChunk & chunk = pChunks[c];
+				size_t first = c * pSection->chunkSize;
+				size_t size = (size_t) pSection->size - first < pSection->chunkSize ? (size_t) pSection->size - first : pSection->chunkSize;
+
+				if(chunk.offset > tableOffset || chunk.storedSize > tableOffset - chunk.offset ||
+				   !ResDecompressChunk((ResCodec) chunk.codec, pStored + chunk.offset, chunk.storedSize, &data[first], size))
+				{
+					vector<char>().swap(data);
+					return Fail("damaged section of type %u", pSection->type);
+				}
+			}
+
+			return true;
+		}
+
+		// not copyable
+		ResReader(const ResReader &);
+		ResReader & operator =(const ResReader &);
+};
+
+
+
+#endif // _RES_READER_H_
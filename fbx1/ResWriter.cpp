@@ -0,0 +1,396 @@
+//
+// Stream a .res file (see ResFormat.h) out to disk, a section at a time
+//
+
+
+
+//
+// System headers
+//
+#include <string.h>		// memset
+#include <assert.h>
+
+
+//
+// Project Includes
+//
+#include "ResWriter.h"
+#include "ResCodec.h"
+#include "Log.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Round up to the next section boundary
+////////////////////////////////////////////////////////////////////////////////////////
+static unsigned __int64 AlignSection(unsigned __int64 offset)
+{
+	return (offset + RES_SECTION_ALIGNMENT - 1) & ~(unsigned __int64) (RES_SECTION_ALIGNMENT - 1);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CLASSES
+//
+// One chunk of a compressed section.  Only keeps the result if it's smaller: 0 = store
+// the chunk as is
+////////////////////////////////////////////////////////////////////////////////////////
+class ResChunkTask : public Task
+{
+	public:
+		ResChunkTask() : m_codec(RES_CODEC_NONE), m_pSrc(NULL), m_size(0), m_pDst(NULL), m_storedSize(0) {}
+
+		void Set(ResCodec codec, const char *pSrc, size_t size, char *pDst)
+		{
+			m_codec = codec; m_pSrc = pSrc; m_size = size; m_pDst = pDst;
+		}
+
+		virtual void Run()
+		{
+			m_storedSize = ResCompressChunk(m_codec, m_pSrc, m_size, m_pDst, m_size - 1);
+		}
+
+		size_t GetStoredSize() const { return m_storedSize; }
+
+	private:
+		ResCodec m_codec;
+		const char *m_pSrc;
+		size_t m_size;
+		char *m_pDst;			// room for m_size - 1 bytes
+		size_t m_storedSize;
+};
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// CONSTRUCTOR
+///////////////////////////////////////////////////////////////////////////////////////////
+ResWriter::ResWriter() : m_ok(false), m_offset(0), m_maxSections(0), m_inSection(false), m_pScheduler(NULL)
+{
+	for(int t = 0; t < RES_SECTION_TYPE_END; t++)
+		m_codecs[t] = RES_CODEC_NONE;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Create the file, with zeros where the header and the section table go for now
+///////////////////////////////////////////////////////////////////////////////////////////
+bool ResWriter::Open(const string & filename, AsyncWriter *pWriter, unsigned int maxSections)
+{
+	m_ok = m_file.Open(pWriter, filename);
+	if(!m_ok)
+		return false;
+
+	m_filename = filename;
+	m_offset = 0;
+	m_maxSections = maxSections;
+	m_sections.clear();
+	m_inSection = false;
+	m_strings.clear();
+
+	vector<char> zeros((size_t) AlignSection(sizeof(ResHeader) + maxSections * sizeof(ResSection)), 0);
+	return Write(&zeros[0], zeros.size());
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Sections and strings
+///////////////////////////////////////////////////////////////////////////////////////////
+bool ResWriter::BeginSection(ResSectionType type, size_t elementSize)
+{
+	assert(!m_inSection);
+
+	if(!m_ok)
+		return false;
+
+	if(m_sections.size() >= m_maxSections)
+		return Fail("***   Too many sections for %s\n");
+
+	// pad up to the boundary
+	static const char zeros[RES_SECTION_ALIGNMENT] = { 0 };
+	if(!Write(zeros, (size_t) (AlignSection(m_offset) - m_offset)))
+		return false;
+
+	ResSection section;
+	section.type = (unsigned int) type;
+	section.elementSize = (unsigned int) elementSize;
+	section.offset = m_offset;
+	section.size = 0;
+	section.count = 0;
+	section.storedSize = 0;
+	section.codec = (unsigned int) m_codecs[type];
+	section.chunkSize = section.codec != RES_CODEC_NONE ? RES_CHUNK_SIZE : 0;
+	section.hash = 0;
+
+	m_hash.Reset();
+
+	m_sections.push_back(section);
+	m_inSection = true;
+
+	return true;
+}
+
+
+
+bool ResWriter::WriteSection(const void *pData, size_t count)
+{
+	assert(m_inSection);
+
+	if(!m_ok)
+		return false;
+
+	ResSection & section = m_sections.back();
+	size_t size = count * section.elementSize;
+
+	section.count += count;
+	section.size += size;
+
+	m_hash.Update(pData, size);
+
+	if(section.codec == RES_CODEC_NONE)
+		return Write(pData, size);
+
+	// whole batches go straight from the caller's data, the rest waits in m_pending for more
+	const char *pBytes = (const char *) pData;
+	size_t batchSize = GetBatchSize();
+
+	while(size > 0)
+	{
+		if(m_pending.empty() && size >= batchSize)
+		{
+			if(!WriteChunks(pBytes, batchSize))
+				return false;
+
+			pBytes += batchSize;
+			size -= batchSize;
+			continue;
+		}
+
+		size_t cnt = batchSize - m_pending.size();
+		cnt = cnt < size ? cnt : size;
+
+		m_pending.insert(m_pending.end(), pBytes, pBytes + cnt);
+		pBytes += cnt;
+		size -= cnt;
+
+		if(m_pending.size() == batchSize)
+		{
+			if(!WriteChunks(&m_pending[0], batchSize))
+				return false;
+
+			m_pending.clear();
+		}
+	}
+
+	return true;
+}
+
+
+
+bool ResWriter::EndSection()
+{
+	assert(m_inSection);
+
+	m_inSection = false;
+
+	ResSection & section = m_sections.back();
+
+	// compressed: the last chunk (maybe short), then the chunk table
+	if(section.codec != RES_CODEC_NONE && m_ok)
+	{
+		if(!m_pending.empty())
+			WriteChunks(&m_pending[0], m_pending.size());
+
+		if(!m_chunks.empty())
+		{
+			static const char zeros[RES_CHUNK_ALIGNMENT] = { 0 };
+			Write(zeros, (size_t) ((RES_CHUNK_ALIGNMENT - (m_offset - section.offset) % RES_CHUNK_ALIGNMENT) % RES_CHUNK_ALIGNMENT));
+			Write(&m_chunks[0], m_chunks.size() * sizeof(ResChunk));
+		}
+	}
+
+	m_pending.clear();
+	m_chunks.clear();
+
+	if(!m_ok)
+		return false;
+
+	section.storedSize = m_offset - section.offset;
+	section.hash = m_hash.Digest();
+
+	// nothing went in: leave it out.  The padding before it stays, the next section starts there anyway
+	if(section.count == 0)
+		m_sections.pop_back();
+
+	return true;
+}
+
+
+
+bool ResWriter::AddSection(ResSectionType type, const void *pData, size_t elementSize, size_t count)
+{
+	if(count == 0)
+		return m_ok;
+
+	if(!BeginSection(type, elementSize))
+		return false;
+
+	WriteSection(pData, count);
+	return EndSection();
+}
+
+
+
+unsigned int ResWriter::AddString(const string & str)
+{
+	unsigned int offset = (unsigned int) m_strings.size();
+
+	m_strings.insert(m_strings.end(), str.begin(), str.end());
+	m_strings.push_back('\0');
+
+	return offset;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Strings last, then back to the start for the header and the section table
+///////////////////////////////////////////////////////////////////////////////////////////
+bool ResWriter::Finish()
+{
+	if(!m_file.IsOpen())
+		return false;
+
+	AddSection(RES_SECTION_STRINGS, m_strings);
+
+	ResHeader header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic = RES_MAGIC;
+	header.version = RES_VERSION;
+	header.endianTag = RES_ENDIAN_TAG;
+	header.headerSize = sizeof(ResHeader);
+	header.sectionCount = (unsigned int) m_sections.size();
+	header.sectionSize = sizeof(ResSection);
+	header.sectionTableOffset = sizeof(ResHeader);
+	header.fileSize = m_offset;
+
+	m_ok = m_ok && m_file.Write(0, &header, sizeof(header));
+	m_ok = m_ok && (m_sections.empty() || m_file.Write(header.sectionTableOffset, &m_sections[0], m_sections.size() * sizeof(ResSection)));
+
+	if(m_ok)
+		m_ok = m_file.Close();
+	else
+		m_file.Abandon();
+
+	// done with it all
+	vector<ResSection>().swap(m_sections);
+	vector<char>().swap(m_strings);
+	vector<char>().swap(m_pending);
+	vector<char>().swap(m_compressed);
+
+	return m_ok;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Errors stick: once a write fails, nothing else gets written and the file is deleted.
+// The file logs its own write errors
+///////////////////////////////////////////////////////////////////////////////////////////
+bool ResWriter::Write(const void *pData, size_t size)
+{
+	if(!m_ok)
+		return false;
+
+	m_ok = m_file.Write(m_offset, pData, size);
+	m_offset += size;
+
+	return m_ok;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Compress 'size' bytes of the current section, a chunk per task, and write the chunks in
+// order.  Only the last chunk of a section can be short
+///////////////////////////////////////////////////////////////////////////////////////////
+bool ResWriter::WriteChunks(const char *pData, size_t size)
+{
+	const ResSection & section = m_sections.back();
+	size_t chunkCnt = (size + RES_CHUNK_SIZE - 1) / RES_CHUNK_SIZE;
+
+	if(m_compressed.size() < chunkCnt * RES_CHUNK_SIZE)
+		m_compressed.resize(chunkCnt * RES_CHUNK_SIZE);
+
+	vector<ResChunkTask> tasks(chunkCnt);
+
+	{
+		TaskGroup group(m_pScheduler);
+
+		for(size_t c = 0; c < chunkCnt; c++)
+		{
+			size_t first = c * RES_CHUNK_SIZE;
+			size_t cnt = size - first < RES_CHUNK_SIZE ? size - first : RES_CHUNK_SIZE;
+
+			tasks[c].Set((ResCodec) section.codec, pData + first, cnt, &m_compressed[first]);
+			group.Run(&tasks[c]);
+		}
+
+		group.Wait();
+	}
+
+	for(size_t c = 0; c < chunkCnt && m_ok; c++)
+	{
+		size_t first = c * RES_CHUNK_SIZE;
+		size_t cnt = size - first < RES_CHUNK_SIZE ? size - first : RES_CHUNK_SIZE;
+
+		ResChunk chunk;
+		chunk.offset = m_offset - section.offset;
+		chunk.storedSize = (unsigned int) tasks[c].GetStoredSize();
+		chunk.codec = section.codec;
+
+		if(chunk.storedSize == 0)
+		{
+			chunk.storedSize = (unsigned int) cnt;
+			chunk.codec = RES_CODEC_NONE;
+			Write(pData + first, cnt);
+		}
+		else
+			Write(&m_compressed[first], chunk.storedSize);
+
+		m_chunks.push_back(chunk);
+	}
+
+	return m_ok;
+}
+
+
+
+// bytes compressed at once: enough chunks to keep every worker busy
+size_t ResWriter::GetBatchSize() const
+{
+	size_t chunkCnt = m_pScheduler ? RES_CHUNKS_PER_THREAD * (size_t) m_pScheduler->GetThreadCount() : 1;
+	return (chunkCnt < 1 ? 1 : chunkCnt) * RES_CHUNK_SIZE;
+}
+
+
+
+bool ResWriter::Fail(const char *pFormat)
+{
+	if(m_ok)
+		LOG_ERROR(pFormat, m_filename.c_str());
+
+	m_ok = false;
+	return false;
+}
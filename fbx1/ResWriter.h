@@ -0,0 +1,115 @@
+//
+// Stream a .res file (see ResFormat.h) out to disk, a section at a time
+//
+
+
+#ifndef __RES_WRITER__H
+#define __RES_WRITER__H
+
+
+
+//
+// System headers
+//
+#include <string>
+#include <vector>
+
+
+//
+// Project headers
+//
+#include "ResFormat.h"
+#include "AsyncWriter.h"
+#include "TaskScheduler.h"
+#include "XXHash64.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+#define RES_WRITER_MAX_SECTIONS		(RES_SECTION_TYPE_END - 1)	// room reserved in the section table: one of each type
+#define RES_CHUNKS_PER_THREAD		2							// chunks compressed at once, per worker thread
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Open reserves room for the header and the section
+// table at the front of the file.  Every section then
+// goes straight to disk at the next 64 byte boundary,
+// so the caller can free its copy of the data as soon
+// as the section is added.  Strings get collected as
+// they're added, and become the last section.  Finish
+// goes back and fills in the header and the table:
+// the file still maps in one go, the table right
+// after the header.
+// The file goes through an AsyncFile: with a writer
+// thread, saving never waits for the disk.  A file
+// that never gets finished is deleted.
+// Section types given a codec get compressed as
+// they stream in: a batch of chunks at a time, one
+// task per chunk on the scheduler, written in order.
+// A chunk that doesn't get smaller is stored as is.
+// Each section's hash is worked out on the way
+// through, before compression.
+///////////////////////////////////////////////////////
+class ResWriter
+{
+	public:
+		ResWriter();
+
+		void SetCodec(ResSectionType type, ResCodec codec) { m_codecs[type] = codec; }	// for the sections begun from now on
+		void SetScheduler(TaskScheduler *pScheduler) { m_pScheduler = pScheduler; }		// NULL = compress on this thread
+
+		bool Open(const string & filename, AsyncWriter *pWriter, unsigned int maxSections = RES_WRITER_MAX_SECTIONS);	// NULL writer = write on this thread
+		bool IsOpen() const { return m_file.IsOpen(); }
+
+		// copy 'count' elements of 'elementSize' bytes in as a section.  Empty sections are left out
+		bool AddSection(ResSectionType type, const void *pData, size_t elementSize, size_t count);
+		template <class T> bool AddSection(ResSectionType type, const vector<T> & data) { return AddSection(type, data.empty() ? NULL : &data[0], sizeof(T), data.size()); }
+
+		// a section written a piece at a time, for data that isn't laid out in one block
+		bool BeginSection(ResSectionType type, size_t elementSize);
+		bool WriteSection(const void *pData, size_t count);	// next 'count' elements
+		bool EndSection();
+
+		unsigned int AddString(const string & str);	// offset of the string in the strings section
+
+		bool Finish();	// strings, header and section table, then close.  With a writer, true = all queued
+
+	private:
+		AsyncFile m_file;				// abandons the file if we never get to Finish
+		string m_filename;
+		bool m_ok;						// no write failed so far
+		unsigned __int64 m_offset;		// end of what's been written
+		unsigned int m_maxSections;
+		vector<ResSection> m_sections;
+		bool m_inSection;				// between BeginSection and EndSection: the last of m_sections
+		vector<char> m_strings;
+
+		ResCodec m_codecs[RES_SECTION_TYPE_END];
+		TaskScheduler *m_pScheduler;
+		vector<char> m_pending;			// compressed section: the bytes short of a whole batch, waiting for more
+		vector<char> m_compressed;		// a batch of chunks, once compressed
+		vector<ResChunk> m_chunks;		// the chunk table of the section
+		XXHash64 m_hash;				// of the section's data so far
+
+		bool Write(const void *pData, size_t size);
+		bool WriteChunks(const char *pData, size_t size);
+		size_t GetBatchSize() const;
+		bool Fail(const char *pFormat);
+};
+
+
+
+//
+// Globals
+//
+extern ResCodec G_resCodec;		// for the big arrays.  RES_CODEC_NONE = everything used in place
+
+
+
+#endif
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////
+// SOAARRAY.H
+//
+// Structure of arrays storage for vertex
+// attributes.  Instead of x,y,z,x,y,z... every
+// component gets its own contiguous lane:
+// x,x,x... y,y,y... z,z,z...  That's what SIMD
+// code wants: 4/8/16 values of the same
+// component in one load, no shuffling.
+// Lanes start on a cache line (which covers
+// every vector width) and are padded to a whole
+// number of SOA_LANE_PAD floats, so a kernel
+// can always run full width over the tail.
+// operator[] gives an AoS view (reads and
+// writes whole Vec3/ColorRGBA/TexCoord values),
+// so generic code (i.e. Weld) works unchanged.
+////////////////////////////////////////////////
+
+
+#ifndef _SOA_ARRAY_H_
+#define _SOA_ARRAY_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifdef _MSC_VER
+#include <malloc.h>		// _aligned_malloc
+#else
+#include <stdlib.h>		// posix_memalign, for the tools built elsewhere that read our types (ResReader.h)
+inline void *_aligned_malloc(size_t size, size_t alignment) { void *p; return posix_memalign(&p, alignment, size) == 0 ? p : NULL; }
+inline void _aligned_free(void *p) { free(p); }
+#endif
+#include <string.h>		// memcpy
+#include <assert.h>
+#include <new>			// bad_alloc
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define SOA_ALIGNMENT		64		// bytes, every lane starts on a cache line
+#define SOA_LANE_PAD		16		// floats, lane capacities are a multiple of this (one AVX-512 register)
+
+
+
+
+/*----------------------------------------------------------------------------
+	Traits:  how a value type splits into lanes.  Specialized next to the types
+	(see DataTypes.h), with:
+		enum { LANES = <component count> };
+		static T Load(float * const *pLanes, size_t i);
+		static void Store(float * const *pLanes, size_t i, const T & value);
+----------------------------------------------------------------------------*/
+
+template <class T> struct SoATraits;
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+// vector<T> look-alike, stored one lane per component.  All the lanes live in one allocation
+template <class T>
+class SoAArray
+{
+	public:
+		typedef T value_type;
+		enum { LANES = SoATraits<T>::LANES };
+
+		// element access through operator[]: reads and writes whole values
+		class Ref
+		{
+			public:
+				Ref(float * const *pLanes, size_t i) : m_pLanes(pLanes), m_i(i) {}
+
+				operator T() const { return SoATraits<T>::Load(m_pLanes, m_i); }
+				Ref & operator =(const T & value) { SoATraits<T>::Store(m_pLanes, m_i, value); return *this; }
+				Ref & operator =(const Ref & ref) { return *this = (T) ref; }
+
+			private:
+				float * const *m_pLanes;
+				size_t m_i;
+		};
+
+		SoAArray() : m_pBlock(NULL), m_size(0), m_capacity(0) { SetLanes(); }
+		SoAArray(const SoAArray & other) : m_pBlock(NULL), m_size(0), m_capacity(0) { SetLanes(); *this = other; }
+		~SoAArray() { _aligned_free(m_pBlock); }
+
+		SoAArray & operator =(const SoAArray & other)
+		{
+			if(this != &other)
+			{
+				resize(other.m_size);
+				for(int k = 0; k < LANES; k++)
+					memcpy(m_pLanes[k], other.m_pLanes[k], m_size * sizeof(float));
+			}
+			return *this;
+		}
+
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		size_t capacity() const { return m_capacity; }
+
+		T operator [](size_t i) const { assert(i < m_size); return SoATraits<T>::Load(m_pLanes, i); }
+		Ref operator [](size_t i) { assert(i < m_size); return Ref(m_pLanes, i); }
+
+		// component 'k' of every element (i.e. lane 1 of a Vec3 array = all the y's).  Padded to capacity()
+		float *Lane(int k) { return m_pLanes[k]; }
+		const float *Lane(int k) const { return m_pLanes[k]; }
+
+		void push_back(const T & value)
+		{
+			if(m_size == m_capacity)
+				reserve(m_capacity ? 2 * m_capacity : SOA_LANE_PAD);
+
+			SoATraits<T>::Store(m_pLanes, m_size++, value);
+		}
+
+		void resize(size_t size)
+		{
+			if(size > m_capacity)
+				reserve(size);
+
+			// new elements are zeroed (vector<T> value-initializes them, close enough)
+			for(int k = 0; size > m_size && k < LANES; k++)
+				memset(m_pLanes[k] + m_size, 0, (size - m_size) * sizeof(float));
+
+			m_size = size;
+		}
+
+		void reserve(size_t capacity)
+		{
+			if(capacity <= m_capacity)
+				return;
+
+			// out of memory (or address space, in a 32-bit process): throw, like a vector growing would
+			if(capacity > ((size_t) -1) / (LANES * sizeof(float)) - SOA_LANE_PAD)
+				throw std::bad_alloc();
+
+			capacity = (capacity + SOA_LANE_PAD - 1) & ~(size_t) (SOA_LANE_PAD - 1);
+
+			float *pBlock = (float *) _aligned_malloc(capacity * LANES * sizeof(float), SOA_ALIGNMENT);
+			if(!pBlock)
+				throw std::bad_alloc();
+
+			for(int k = 0; k < LANES; k++)
+			{
+				if(m_size)
+					memcpy(pBlock + k * capacity, m_pLanes[k], m_size * sizeof(float));
+			}
+
+			_aligned_free(m_pBlock);
+			m_pBlock = pBlock;
+			m_capacity = capacity;
+			SetLanes();
+		}
+
+		void clear() { m_size = 0; }
+
+		void swap(SoAArray & other)
+		{
+			float *pBlock = m_pBlock;	m_pBlock = other.m_pBlock;	other.m_pBlock = pBlock;
+			size_t size = m_size;		m_size = other.m_size;		other.m_size = size;
+			size_t cap = m_capacity;	m_capacity = other.m_capacity;	other.m_capacity = cap;
+			SetLanes();
+			other.SetLanes();
+		}
+
+		// copy all of 'src' in, starting at element 'at' (must fit).  Different spots can be copied to on different threads
+		void CopyFrom(size_t at, const SoAArray & src)
+		{
+			assert(at + src.m_size <= m_size);
+
+			for(int k = 0; src.m_size && k < LANES; k++)
+				memcpy(m_pLanes[k] + at, src.m_pLanes[k], src.m_size * sizeof(float));
+		}
+
+	private:
+		float *m_pBlock;
+		float *m_pLanes[LANES];
+		size_t m_size;
+		size_t m_capacity;	// per lane
+
+		void SetLanes()
+		{
+			for(int k = 0; k < LANES; k++)
+				m_pLanes[k] = m_pBlock ? m_pBlock + k * m_capacity : NULL;
+		}
+};
+
+
+
+#endif // _SOA_ARRAY_H_
@@ -0,0 +1,290 @@
+//
+// Work-stealing task pool used to spread the work of a single file over all cores
+//
+
+
+
+//
+// System headers
+//
+#include <process.h> // thread library ('_beginthreadex')
+#include <assert.h>
+#include <string.h>
+
+
+//
+// Project Includes
+//
+#include "TaskScheduler.h"
+#include "Log.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Thread local: which worker of the pool (if any) the current thread is
+////////////////////////////////////////////////////////////////////////////////////////
+static __declspec(thread) int T_workerIndex = -1;
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// TASK GROUP
+//
+///////////////////////////////////////////////////////////////////////////////////////
+TaskGroup::TaskGroup(TaskScheduler *pScheduler) : m_pScheduler(pScheduler), m_pending(0)
+{
+	m_hDone = CreateEvent(NULL, TRUE, TRUE, NULL); // manual reset, signaled: nothing pending
+}
+
+
+
+// the last task to finish may still be on its way out of TaskDone: let it signal first
+TaskGroup::~TaskGroup()
+{
+	assert(m_pending == 0);
+	WaitForSingleObject(m_hDone, INFINITE);
+	CloseHandle(m_hDone);
+}
+
+
+
+void TaskGroup::Run(Task *pTask)
+{
+	if(!m_pScheduler)
+	{
+		pTask->Run();
+		return;
+	}
+
+	// a fresh batch.  The last task of the one before may have counted itself out but not
+	// signaled yet: wait for that, or its late signal would make the next Wait return early
+	if(m_pending == 0)
+	{
+		WaitForSingleObject(m_hDone, INFINITE);
+		ResetEvent(m_hDone);
+	}
+
+	InterlockedIncrement(&m_pending);
+
+	TaskScheduler::Entry entry;
+	entry.pTask = pTask;
+	entry.pGroup = this;
+	entry.pLogTag = Log::GetTag(); // thread local, stays put until the submitter moves on to another file (after waiting for us)
+
+	m_pScheduler->Submit(entry);
+}
+
+
+
+void TaskGroup::TaskDone()
+{
+	if(InterlockedDecrement(&m_pending) == 0)
+		SetEvent(m_hDone);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Don't just sleep: run queued tasks (ours or anybody's) until our group is done.
+// Only when there's nothing left to steal do we block, until our last tasks finish
+// on other threads (checking back now and then in case new work shows up).
+// m_pending reaching 0 isn't enough to return on: the thread that took it there still
+// has to signal m_hDone, and the group may be gone by then.  So wait for the signal too
+///////////////////////////////////////////////////////////////////////////////////////
+void TaskGroup::Wait()
+{
+	if(!m_pScheduler)
+		return;
+
+	while(m_pending > 0)
+	{
+		TaskScheduler::Entry entry;
+
+		if(m_pScheduler->Steal(T_workerIndex >= 0 ? T_workerIndex : 0, entry))
+			TaskScheduler::Execute(entry);
+		else
+			WaitForSingleObject(m_hDone, 1);
+	}
+
+	WaitForSingleObject(m_hDone, INFINITE);
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// SCHEDULER
+//
+///////////////////////////////////////////////////////////////////////////////////////
+TaskScheduler::TaskScheduler(int threadCnt)
+{
+	if(threadCnt < 1)
+		threadCnt = 1;
+
+	m_hWork = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+	m_nextWorker = 0;
+	m_quit = 0;
+
+	// create every deque before any thread starts stealing from them
+	for(int i = 0; i < threadCnt; i++)
+	{
+		Worker *pWorker = new Worker;
+		pWorker->pScheduler = this;
+		pWorker->index = i;
+		pWorker->hThread = 0;
+		InitializeCriticalSection(&pWorker->lock);
+
+		m_workers.push_back(pWorker);
+	}
+
+	for(int i = 0; i < threadCnt; i++)
+	{
+		m_workers[i]->hThread = (HANDLE) _beginthreadex(NULL, 0, WorkerThreadStart, (void *) m_workers[i], 0, NULL);
+
+		if(m_workers[i]->hThread == 0)
+			LOG_ERROR("***   Error in TaskScheduler.cpp creating task thread #%d\n", i); // the other workers (and waiting threads) pick up its share
+	}
+}
+
+
+
+TaskScheduler::~TaskScheduler()
+{
+	InterlockedExchange(&m_quit, 1);
+	ReleaseSemaphore(m_hWork, (LONG) m_workers.size(), NULL);
+
+	for(size_t i = 0; i < m_workers.size(); i++)
+	{
+		if(m_workers[i]->hThread)
+		{
+			WaitForSingleObject(m_workers[i]->hThread, INFINITE);
+			CloseHandle(m_workers[i]->hThread);
+		}
+	}
+
+	for(size_t i = 0; i < m_workers.size(); i++)
+	{
+		assert(m_workers[i]->tasks.empty());
+		DeleteCriticalSection(&m_workers[i]->lock);
+		delete m_workers[i];
+	}
+
+	CloseHandle(m_hWork);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Workers queue on their own deque, everybody else round robin
+///////////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::Submit(const Entry & entry)
+{
+	int target = T_workerIndex;
+	if(target < 0 || target >= (int) m_workers.size())
+		target = (int) ((unsigned long) InterlockedIncrement(&m_nextWorker) % m_workers.size());
+
+	Worker *pWorker = m_workers[target];
+
+	EnterCriticalSection(&pWorker->lock);
+	pWorker->tasks.push_back(entry);
+	LeaveCriticalSection(&pWorker->lock);
+
+	ReleaseSemaphore(m_hWork, 1, NULL);
+}
+
+
+
+bool TaskScheduler::TakeOwn(Worker *pWorker, Entry & entry)
+{
+	bool found = false;
+
+	EnterCriticalSection(&pWorker->lock);
+	if(!pWorker->tasks.empty())
+	{
+		entry = pWorker->tasks.back();
+		pWorker->tasks.pop_back();
+		found = true;
+	}
+	LeaveCriticalSection(&pWorker->lock);
+
+	return found;
+}
+
+
+
+// oldest task of the first non empty deque, starting at 'firstVictim'
+bool TaskScheduler::Steal(int firstVictim, Entry & entry)
+{
+	size_t cnt = m_workers.size();
+
+	for(size_t i = 0; i < cnt; i++)
+	{
+		Worker *pVictim = m_workers[(firstVictim + i) % cnt];
+		bool found = false;
+
+		EnterCriticalSection(&pVictim->lock);
+		if(!pVictim->tasks.empty())
+		{
+			entry = pVictim->tasks.front();
+			pVictim->tasks.pop_front();
+			found = true;
+		}
+		LeaveCriticalSection(&pVictim->lock);
+
+		if(found)
+			return true;
+	}
+
+	return false;
+}
+
+
+
+void TaskScheduler::Execute(const Entry & entry)
+{
+	char savedTag[LOG_TAG_SIZE];
+	strcpy(savedTag, Log::GetTag());
+
+	Log::SetTag(entry.pLogTag);
+	entry.pTask->Run();
+	Log::SetTag(savedTag);
+
+	entry.pGroup->TaskDone();
+}
+
+
+
+unsigned __stdcall TaskScheduler::WorkerThreadStart(void *pData)
+{
+	Worker *pWorker = static_cast<Worker *>(pData);
+
+	T_workerIndex = pWorker->index;
+	pWorker->pScheduler->WorkerLoop(pWorker);
+
+	return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Own deque first, then steal.  Sleep when there's nothing anywhere.  A wake up may
+// find nothing (a waiting thread helped itself to the task), that's fine
+///////////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::WorkerLoop(Worker *pWorker)
+{
+	for(;;)
+	{
+		WaitForSingleObject(m_hWork, INFINITE);
+
+		if(m_quit)
+			break;
+
+		Entry entry;
+		while(TakeOwn(pWorker, entry) || Steal(pWorker->index + 1, entry))
+			Execute(entry);
+	}
+}
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////
+// TASKSCHEDULER.H
+//
+// Work-stealing task pool used to spread the
+// work of a single file over all cores (i.e.
+// one task per mesh).  Every worker thread has
+// its own deque: it pushes and pops at the back
+// (newest first, cache friendly) and idle
+// workers steal from the front of the others.
+// Threads outside the pool (the pipeline stages)
+// submit tasks round robin, and help out with
+// whatever is queued while they wait for their
+// own tasks to finish.
+////////////////////////////////////////////////
+
+
+#ifndef _TASK_SCHEDULER_H_
+#define _TASK_SCHEDULER_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <deque>
+#include <vector>
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+class TaskGroup;
+class TaskScheduler;
+
+
+
+// Derive from this and implement Run().  The scheduler never deletes tasks, they belong to whoever submitted them
+class Task
+{
+	public:
+		virtual ~Task() {}
+		virtual void Run() = 0;
+};
+
+
+
+// A batch of tasks that can be waited on as a whole
+class TaskGroup
+{
+	public:
+		TaskGroup(TaskScheduler *pScheduler);	// NULL scheduler = run every task inline
+		~TaskGroup();
+
+		void Run(Task *pTask);	// queue a task (or run it right away without a scheduler).  Only from the thread that owns the group
+		void Wait();			// help running queued tasks until every task of this group is done
+
+	private:
+		friend class TaskScheduler;
+
+		TaskScheduler *m_pScheduler;
+		volatile LONG m_pending;
+		HANDLE m_hDone;			// signaled when m_pending drops to 0
+
+		void TaskDone();
+
+		// not copyable
+		TaskGroup(const TaskGroup &);
+		TaskGroup & operator =(const TaskGroup &);
+};
+
+
+
+class TaskScheduler
+{
+	public:
+		TaskScheduler(int threadCnt);
+		~TaskScheduler();		// waits for the worker threads to exit.  All groups must be done by then
+
+		int GetThreadCount() { return (int) m_workers.size(); }
+
+	private:
+		friend class TaskGroup;
+
+		struct Entry
+		{
+			Task *pTask;
+			TaskGroup *pGroup;
+			const char *pLogTag;	// submitter's log tag: the task logs as if it ran there
+		};
+
+		struct Worker
+		{
+			TaskScheduler *pScheduler;
+			int index;
+			HANDLE hThread;
+			CRITICAL_SECTION lock;
+			std::deque<Entry> tasks;
+		};
+
+		std::vector<Worker *> m_workers;
+		HANDLE m_hWork;				// one count per queued task, idle workers sleep on it
+		volatile LONG m_nextWorker;	// round robin target for tasks submitted from outside the pool
+		volatile LONG m_quit;
+
+		void Submit(const Entry & entry);
+		bool TakeOwn(Worker *pWorker, Entry & entry);
+		bool Steal(int firstVictim, Entry & entry);
+		static void Execute(const Entry & entry);
+
+		static unsigned __stdcall WorkerThreadStart(void *pData);
+		void WorkerLoop(Worker *pWorker);
+
+		// not copyable
+		TaskScheduler(const TaskScheduler &);
+		TaskScheduler & operator =(const TaskScheduler &);
+};
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+extern TaskScheduler *G_pTaskScheduler;	// shared by all pipeline threads. NULL = no intra-file parallelism
+
+
+
+#endif // _TASK_SCHEDULER_H_
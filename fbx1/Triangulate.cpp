@@ -0,0 +1,227 @@
+//
+// Split quads and n-gons into triangles while extracting a mesh
+//
+
+
+
+//
+// Standard library includes
+//
+#include <math.h>
+
+
+
+//
+// Project Includes
+//
+#include "Triangulate.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// MACROS
+////////////////////////////////////////////////////////////////////////////////////////
+#define TRIANGULATE_EPSILON		1e-12	// relative to the polygon's size: anything below is considered flat
+
+// twice the signed area of triangle (a, b, c) in the flattened polygon
+#define CROSS_2D(a, b, c)		((m_u[b] - m_u[a]) * (m_v[c] - m_v[a]) - (m_v[b] - m_v[a]) * (m_u[c] - m_u[a]))
+
+
+
+
+inline Int3 MakeTri(int a, int b, int c)
+{
+	Int3 tri;
+
+	tri.idxs[0] = a;
+	tri.idxs[1] = b;
+	tri.idxs[2] = c;
+
+	return tri;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Convex polygons get a fan, concave ones ear clipping.  Polygons too flat to tell
+// (zero area) get a fan too: whatever we do, their triangles won't show
+///////////////////////////////////////////////////////////////////////////////////////
+bool Triangulator::Triangulate(const FbxVector4 *pControlPoints, const int *pCorners, int cornerCnt, vector<Int3> & tris)
+{
+	int i;
+
+	tris.clear();
+
+	if(cornerCnt < 3)
+		return true;
+
+	if(cornerCnt == 3)
+	{
+		tris.push_back(MakeTri(0, 1, 2));
+		return true;
+	}
+
+
+	//////////////////////////////////////////////////
+	// NORMAL (Newell's method, fine with concave polygons)
+	double normal[3] = {0.0, 0.0, 0.0};
+
+	for(i = 0; i < cornerCnt; i++)
+	{
+		const FbxVector4 & a = pControlPoints[pCorners[i]];
+		const FbxVector4 & b = pControlPoints[pCorners[(i + 1) % cornerCnt]];
+
+		normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+		normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+		normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+	}
+
+
+	//////////////////////////////////////////////////
+	// FLATTEN onto the plane of the two other axes
+	int axis = 0;
+	if(fabs(normal[1]) > fabs(normal[axis]))
+		axis = 1;
+	if(fabs(normal[2]) > fabs(normal[axis]))
+		axis = 2;
+
+	int uAxis = (axis + 1) % 3;
+	int vAxis = (axis + 2) % 3;
+
+	m_u.resize(cornerCnt);
+	m_v.resize(cornerCnt);
+
+	double area = 0.0, size = 0.0;
+	for(i = 0; i < cornerCnt; i++)
+	{
+		m_u[i] = pControlPoints[pCorners[i]][uAxis];
+		m_v[i] = pControlPoints[pCorners[i]][vAxis];
+	}
+
+	for(i = 0; i < cornerCnt; i++)
+	{
+		int next = (i + 1) % cornerCnt;
+
+		area += m_u[i] * m_v[next] - m_u[next] * m_v[i];
+		size += fabs(m_u[next] - m_u[i]) + fabs(m_v[next] - m_v[i]);
+	}
+
+	double epsilon = TRIANGULATE_EPSILON * size * size;
+
+	if(fabs(area) <= epsilon)
+	{
+		Fan(cornerCnt, tris);
+		return true;
+	}
+
+	double orientation = area > 0.0 ? 1.0 : -1.0; // which way the corners turn, in 2D
+
+
+	//////////////////////////////////////////////////
+	// CONVEX?  Every corner turns the same way
+	bool convex = true;
+
+	for(i = 0; i < cornerCnt && convex; i++)
+	{
+		int prev = (i + cornerCnt - 1) % cornerCnt;
+		int next = (i + 1) % cornerCnt;
+
+		convex = CROSS_2D(prev, i, next) * orientation >= -epsilon;
+	}
+
+	if(convex)
+	{
+		Fan(cornerCnt, tris);
+		return true;
+	}
+
+	EarClip(cornerCnt, orientation, tris);
+	return false;
+}
+
+
+
+
+void Triangulator::Fan(int cornerCnt, vector<Int3> & tris)
+{
+	for(int i = 1; i + 1 < cornerCnt; i++)
+		tris.push_back(MakeTri(0, i, i + 1));
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Keep cutting off ears (a convex corner whose triangle holds no other corner) until
+// a triangle is left.  Self intersecting polygons may run out of ears: then the first
+// corner left gets cut off anyway, so we always end up with cornerCnt - 2 triangles
+///////////////////////////////////////////////////////////////////////////////////////
+void Triangulator::EarClip(int cornerCnt, double orientation, vector<Int3> & tris)
+{
+	m_remaining.resize(cornerCnt);
+	for(int i = 0; i < cornerCnt; i++)
+		m_remaining[i] = i;
+
+	int k = 0;
+	while(m_remaining.size() > 3)
+	{
+		int cnt = (int) m_remaining.size();
+		bool clipped = false;
+
+		for(int tries = 0; tries < cnt; tries++, k = (k + 1) % cnt)
+		{
+			int prev = m_remaining[(k + cnt - 1) % cnt];
+			int curr = m_remaining[k];
+			int next = m_remaining[(k + 1) % cnt];
+
+			if(IsEar(prev, curr, next, orientation))
+			{
+				tris.push_back(MakeTri(prev, curr, next));
+				m_remaining.erase(m_remaining.begin() + k);
+				clipped = true;
+				break;
+			}
+		}
+
+		if(!clipped)
+		{
+			tris.push_back(MakeTri(m_remaining[cnt - 1], m_remaining[0], m_remaining[1]));
+			m_remaining.erase(m_remaining.begin());
+			k = 0;
+		}
+
+		k %= (int) m_remaining.size();
+	}
+
+	tris.push_back(MakeTri(m_remaining[0], m_remaining[1], m_remaining[2]));
+}
+
+
+
+
+bool Triangulator::IsEar(int prev, int curr, int next, double orientation)
+{
+	if(CROSS_2D(prev, curr, next) * orientation <= 0.0)
+		return false; // reflex (or flat) corner
+
+	for(size_t i = 0; i < m_remaining.size(); i++)
+	{
+		int p = m_remaining[i];
+		if(p == prev || p == curr || p == next)
+			continue;
+
+		// corners sitting on top of one of ours (polygons touching themselves) don't count
+		if((m_u[p] == m_u[prev] && m_v[p] == m_v[prev]) || (m_u[p] == m_u[curr] && m_v[p] == m_v[curr]) || (m_u[p] == m_u[next] && m_v[p] == m_v[next]))
+			continue;
+
+		// inside (or on the edge of) the triangle?
+		if(CROSS_2D(prev, curr, p) * orientation >= 0.0 &&
+			CROSS_2D(curr, next, p) * orientation >= 0.0 &&
+			CROSS_2D(next, prev, p) * orientation >= 0.0)
+			return false;
+	}
+
+	return true;
+}
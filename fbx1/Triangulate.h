@@ -0,0 +1,64 @@
+//
+// Split quads and n-gons into triangles while extracting a mesh
+//
+
+
+#ifndef __TRIANGULATE__H
+#define __TRIANGULATE__H
+
+
+
+//
+// System headers
+//
+#include <vector>
+
+
+//
+// Fbx library headers
+//
+#include "fbxdefs.h"
+
+
+//
+// Project headers
+//
+#include "DataTypes.h"
+
+
+
+using namespace std;	// to avoid having to write std:: every time I want to use a standard library func
+
+
+
+///////////////////////////////////////////////////////
+// CLASSES
+//
+// Convex polygons (the vast majority: quads, most
+// n-gons) are split as a fan off their first corner.
+// Concave ones get ear clipping, done in 2D: the
+// polygon is flattened onto the axis plane its normal
+// (Newell's method) is closest to.
+// Triangles are given as corners of the polygon (0 to
+// corner count - 1) and keep the polygon's winding.
+// Keeps its scratch buffers between polygons, so use
+// one per thread.
+///////////////////////////////////////////////////////
+class Triangulator
+{
+	public:
+		// 'pCorners' = control point of every corner, in order.  Returns false if the polygon is concave (ear clipped)
+		bool Triangulate(const FbxVector4 *pControlPoints, const int *pCorners, int cornerCnt, vector<Int3> & tris);
+
+	private:
+		vector<double> m_u, m_v;	// corners flattened to 2D
+		vector<int> m_remaining;	// corners not clipped off yet
+
+		void Fan(int cornerCnt, vector<Int3> & tris);
+		void EarClip(int cornerCnt, double orientation, vector<Int3> & tris);
+		bool IsEar(int prev, int curr, int next, double orientation);
+};
+
+
+
+#endif
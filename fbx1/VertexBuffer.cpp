@@ -0,0 +1,236 @@
+//
+// One index list for all the components: vertices from the welded component lists
+//
+
+
+
+//
+// System headers
+//
+#include <assert.h>
+#include <vector>
+
+
+//
+// Project Includes
+//
+#include "VertexBuffer.h"
+#include "WeldSort.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+static const int G_componentSizes[VERTEX_COMPONENT_COUNT] = { 3, 3, 2, 4, 3, 3 };
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// STRUCTS
+//
+// Where the components of the vertices come from: the corners' indices into each list,
+// and the list's lanes.  Components with no values don't go in the vertices
+////////////////////////////////////////////////////////////////////////////////////////
+struct VertexSources
+{
+	const vector<Int3> *pIndices[VERTEX_COMPONENT_COUNT];	// NULL if left out
+	const float *pLanes[VERTEX_COMPONENT_COUNT][4];
+
+	template <class T> void Set(VertexComponent component, const SoAArray<T> & values, const vector<Int3> & indices)
+	{
+		pIndices[component] = values.empty() ? NULL : &indices;
+		for(int k = 0; k < SoAArray<T>::LANES; k++)
+			pLanes[component][k] = values.Lane(k);
+	}
+};
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CLASSES
+//
+// A range of corners, then a range of vertices.  First run: the tuples of the corners
+// and their hashes.  Second run (once the tuples are welded): the values of the vertices,
+// interleaved
+////////////////////////////////////////////////////////////////////////////////////////
+class VertexRangeTask : public Task
+{
+	public:
+		VertexRangeTask() : m_pSources(NULL), m_pLayout(NULL), m_pTuples(NULL), m_pHashes(NULL), m_pVertices(NULL), m_first(0), m_end(0) {}
+
+		void SetGather(const VertexSources *pSources, VertexTuple *pTuples, unsigned int *pHashes, size_t firstCorner, size_t endCorner)
+		{
+			m_pSources = pSources; m_pTuples = pTuples; m_pHashes = pHashes; m_first = firstCorner; m_end = endCorner;
+		}
+
+		void SetInterleave(const VertexBuffer *pLayout, float *pVertices, size_t firstVertex, size_t endVertex)
+		{
+			m_pLayout = pLayout; m_pVertices = pVertices; m_first = firstVertex; m_end = endVertex;
+		}
+
+		virtual void Run()
+		{
+			if(!m_pVertices)
+				Gather();
+			else
+				Interleave();
+		}
+
+	private:
+		const VertexSources *m_pSources;
+		const VertexBuffer *m_pLayout;
+		VertexTuple *m_pTuples;
+		unsigned int *m_pHashes;
+		float *m_pVertices;
+		size_t m_first, m_end;
+
+		void Gather()
+		{
+			WeldHashVertexTuple hash;
+
+			for(size_t c = m_first; c < m_end; c++)
+			{
+				VertexTuple & tuple = m_pTuples[c];
+
+				for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++)
+				{
+					const vector<Int3> *pIndices = m_pSources->pIndices[k];
+					tuple.idxs[k] = pIndices ? (*pIndices)[c / 3].idxs[c % 3] : -1;
+				}
+
+				m_pHashes[c] = hash(tuple);
+			}
+		}
+
+		// corners missing a component the other vertices have get zeros
+		void Interleave()
+		{
+			unsigned int stride = m_pLayout->stride;
+
+			for(size_t v = m_first; v < m_end; v++)
+			{
+				const VertexTuple & tuple = m_pTuples[v];
+				float *pOut = m_pVertices + v * stride;
+
+				for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++)
+				{
+					if(m_pLayout->offsets[k] < 0)
+						continue;
+
+					int idx = tuple.idxs[k];
+					for(int l = 0; l < G_componentSizes[k]; l++)
+						pOut[m_pLayout->offsets[k] + l] = idx >= 0 ? m_pSources->pLanes[k][l][idx] : 0.0f;
+				}
+			}
+		}
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Split 'cnt' items into ranges for the tasks: a few per thread, none too small
+////////////////////////////////////////////////////////////////////////////////////////
+static int GetRangeCount(size_t cnt, TaskScheduler *pScheduler)
+{
+	if(!pScheduler)
+		return 1;
+
+	size_t rangeCnt = cnt / VERTEX_TASK_MIN_CORNERS;
+	size_t maxCnt = VERTEX_TASKS_PER_THREAD * (size_t) pScheduler->GetThreadCount();
+
+	rangeCnt = rangeCnt > maxCnt ? maxCnt : rangeCnt;
+	return rangeCnt < 1 ? 1 : (int) rangeCnt;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// See VertexBuffer.h
+///////////////////////////////////////////////////////////////////////////////////////////
+int GetVertexComponentSize(VertexComponent component)
+{
+	return G_componentSizes[component];
+}
+
+
+
+void BuildVertexBuffer(MeshData & mesh, TaskScheduler *pScheduler)
+{
+	VertexBuffer & vb = mesh.vb;
+	size_t cornerCnt = 3 * mesh.tris.iPos.size();
+
+	vb = VertexBuffer();
+	if(cornerCnt == 0 || mesh.vPos.empty())
+		return;
+
+	VertexSources sources;
+	sources.Set(VERTEX_POS, mesh.vPos, mesh.tris.iPos);
+	sources.Set(VERTEX_NRM, mesh.vNorm, mesh.tris.iNrm);
+	sources.Set(VERTEX_TEX, mesh.vTex, mesh.tris.iTex);
+	sources.Set(VERTEX_COL, mesh.vColor, mesh.tris.iCol);
+	sources.Set(VERTEX_TAN, mesh.vTang, mesh.tris.iTan);
+	sources.Set(VERTEX_BIN, mesh.vBinorm, mesh.tris.iBin);
+
+	for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++)
+	{
+		if(!sources.pIndices[k])
+			continue;
+
+		assert(3 * sources.pIndices[k]->size() == cornerCnt);
+		vb.offsets[k] = (int) vb.stride;
+		vb.stride += G_componentSizes[k];
+	}
+
+	// tuples of all the corners, and their hashes
+	vector<VertexTuple> tuples(cornerCnt);
+	vector<unsigned int> hashes(cornerCnt);
+	int rangeCnt = GetRangeCount(cornerCnt, pScheduler);
+	vector<VertexRangeTask> tasks(rangeCnt);
+
+	{
+		TaskGroup group(pScheduler);
+
+		for(int r = 0; r < rangeCnt; r++)
+		{
+			tasks[r].SetGather(&sources, &tuples[0], &hashes[0], cornerCnt * r / rangeCnt, cornerCnt * (r + 1) / rangeCnt);
+			group.Run(&tasks[r]);
+		}
+
+		group.Wait();
+	}
+
+	// weld them: what's left are the vertices, xrefs the index list
+	vector<size_t> xrefs;
+	size_t vertexCnt = WeldAuto(tuples, xrefs, &hashes[0], std::equal_to<VertexTuple>(), pScheduler);
+
+	vector<unsigned int>().swap(hashes);
+
+	vb.indices.resize(cornerCnt);
+	for(size_t c = 0; c < cornerCnt; c++)
+		vb.indices[c] = (unsigned int) xrefs[c];
+
+	vector<size_t>().swap(xrefs);
+
+	// the values of every vertex
+	vb.vertices.resize(vertexCnt * vb.stride);
+	rangeCnt = GetRangeCount(vertexCnt, pScheduler);
+	tasks.assign(rangeCnt, VertexRangeTask());
+
+	{
+		TaskGroup group(pScheduler);
+
+		for(int r = 0; r < rangeCnt; r++)
+		{
+			tasks[r].SetGather(&sources, &tuples[0], NULL, 0, 0);
+			tasks[r].SetInterleave(&vb, &vb.vertices[0], vertexCnt * r / rangeCnt, vertexCnt * (r + 1) / rangeCnt);
+			group.Run(&tasks[r]);
+		}
+
+		group.Wait();
+	}
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////
+// VERTEXBUFFER.H
+//
+// Last stage of welding.  After WeldData every
+// triangle corner still has six indices, one
+// per component (iPos, iNrm, ...), which a GPU
+// can't draw.  Every corner's combination of
+// indices (its tuple) is welded like any other
+// value, with the same hashing and tables as
+// Weld: each distinct tuple becomes a vertex
+// holding all its components side by side, and
+// the corners become a single index list.
+// Vertices come in order of first use, so the
+// same input gives the same buffer on any
+// thread count.
+////////////////////////////////////////////////
+
+
+#ifndef _VERTEX_BUFFER_H_
+#define _VERTEX_BUFFER_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include "DataTypes.h"
+#include "WeldHash.h"
+#include "TaskScheduler.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define VERTEX_TASK_MIN_CORNERS		(1 << 16)	// fewer corners than this per task isn't worth a thread
+#define VERTEX_TASKS_PER_THREAD		4
+
+
+
+
+/*----------------------------------------------------------------------------
+	Structs:
+----------------------------------------------------------------------------*/
+
+// component indices of one triangle corner, by VertexComponent.  -1 where the vertices don't have the component
+struct VertexTuple
+{
+	int idxs[VERTEX_COMPONENT_COUNT];
+
+	bool operator ==(const VertexTuple & t) const
+	{
+		for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++)
+		{
+			if(idxs[k] != t.idxs[k])
+				return false;
+		}
+		return true;
+	}
+};
+
+// hash functor for Weld
+struct WeldHashVertexTuple
+{
+	unsigned int operator()(const VertexTuple & t) const
+	{
+		unsigned int h = 0;
+
+		for(int k = 0; k < VERTEX_COMPONENT_COUNT; k++)
+			h = (h ^ (unsigned int) t.idxs[k]) * WELD_HASH_PRIME_0;
+
+		return WeldHashMix(h);
+	}
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// Fill mesh.vb from the welded mesh (see the top of this file).  Components with no values are left out of the
+// vertices.  NULL scheduler = all on this thread
+void BuildVertexBuffer(MeshData & mesh, TaskScheduler *pScheduler);
+
+// floats a component takes up in a vertex
+int GetVertexComponentSize(VertexComponent component);
+
+
+
+#endif // _VERTEX_BUFFER_H_
@@ -20,6 +20,8 @@
 
 #include <vector>		// vector<T>
 #include <functional>	// equal_to<T>
+#include <string.h>		// memset
+#include <assert.h>
 
 
 
@@ -28,6 +30,18 @@
 // Project headers
 //
 #include "WriteData.h"
+#include "WeldHash.h"
+#include "TaskScheduler.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define WELD_PARTITION_MIN			(1 << 18)	// elements.  Arrays this long are welded by partitions, on every thread (WeldPartitioned)
+#define WELD_PARTITIONS_PER_THREAD	2
 
 
 
@@ -49,6 +63,50 @@ inline size_t NextPowerOfTwo(size_t x)
 
 
 
+// Open addressing table of the values kept so far: 32 bit index of the value plus its full hash,
+// side by side, so a probe reads one cache line and only compares values when the hashes match.
+// Linear probing, sized for every element to be unique at no more than 2/3 load
+#define WELD_EMPTY_SLOT		0xffffffff
+
+struct WeldSlot
+{
+	unsigned int hash;
+	unsigned int index;		// WELD_EMPTY_SLOT if free
+};
+
+class WeldTable
+{
+	public:
+		explicit WeldTable(size_t cnt)
+		{
+			assert(cnt < WELD_EMPTY_SLOT);
+
+			m_size = NextPowerOfTwo(cnt + cnt / 2 + 1);
+			m_pSlots = new WeldSlot[m_size];
+			memset(m_pSlots, 0xff, m_size * sizeof(WeldSlot));
+		}
+		~WeldTable() { delete [] m_pSlots; }
+
+		// probe sequence of a hash: First, then Next until the value or an empty slot turns up
+		size_t First(unsigned int hash) const { return hash & (m_size - 1); }
+		size_t Next(size_t slot) const { return (slot + 1) & (m_size - 1); }
+		WeldSlot & operator [](size_t slot) { return m_pSlots[slot]; }
+
+	private:
+		WeldSlot *m_pSlots;
+		size_t m_size;
+
+		// not copyable
+		WeldTable(const WeldTable &);
+		WeldTable & operator =(const WeldTable &);
+};
+
+
+
+
+
+
+
 #if 0
 // In case hash_map is not provided.
 //namespace std
@@ -91,13 +149,68 @@ inline size_t NextPowerOfTwo(size_t x)
 
 /** Generic welding routine. This function welds the elements of the vector p
  * and returns the cross references in the xrefs array. To compare the elements
- * it uses the standard hash and key_equal functors.
+ * it uses the given hash (returning 32 bits) and key_equal functors.
+ * p can be a std::vector<T> or a SoAArray<T> (elements are copied out, not referenced).
+ * Unique elements are kept in order of first occurrence.
  *
  * This code is based on the ideas of Ville Miettinen and Pierre Terdiman.
  */
-template <class T, class HashFunction, class BinaryPredicate>
-size_t Weld( std::vector<T> & p, std::vector<size_t> & xrefs, HashFunction hash, BinaryPredicate equal )
+template <class Array, class HashFunction, class BinaryPredicate>
+size_t Weld( Array & p, std::vector<size_t> & xrefs, HashFunction hash, BinaryPredicate equal )
 {
+	typedef typename Array::value_type T;
+
+	size_t const N = p.size();								// # of input vertices.
+	size_t outputCount = 0;									// # of output vertices
+	WeldTable table(N);
+
+	// xrefs and p have the same size.
+	xrefs.resize(N);
+
+	for (size_t i = 0; i < N; ++i)
+	{
+		const T e = p[i];
+		unsigned int hashValue = (unsigned int) hash(e);
+
+		for (size_t s = table.First(hashValue); ; s = table.Next(s))
+		{
+			WeldSlot & slot = table[s];
+
+			// no match found - copy vertex & add to table
+			if( slot.index == WELD_EMPTY_SLOT )
+			{
+				slot.hash = hashValue;
+				slot.index = (unsigned int) outputCount;
+				xrefs[i] = outputCount;
+				p[outputCount++] = e;
+				break;
+			}
+
+			if( slot.hash == hashValue && equal(p[slot.index], e) )
+			{
+				xrefs[i] = slot.index;
+				break;
+			}
+		}
+	}
+
+	// drop duplicates.
+	p.resize(outputCount);
+
+	// number of output vertices
+	return outputCount;
+}
+
+
+
+/** The original Weld: chained hash table (size_t heads plus a 'next' list).  Same
+ * results as Weld, kept to compare against (see WeldBench.cpp)
+ */
+template <class Array, class HashFunction, class BinaryPredicate>
+size_t WeldChained( Array & p, std::vector<size_t> & xrefs, HashFunction hash, BinaryPredicate equal )
+{
+	typedef typename Array::value_type T;
+
 	size_t const NIL = size_t(~0);							// linked list terminator symbol.
 	size_t const N = p.size();								// # of input vertices.
 	size_t outputCount = 0;									// # of output vertices
@@ -113,7 +226,7 @@ size_t Weld( std::vector<T> & p, std::vector<size_t> & xrefs, HashFunction hash,
 	for (size_t i = 0; i < N; ++i)
 	{
 
-		const T & e = p[i];
+		const T e = p[i];
 		size_t hashValue = hash(e) & (hashSize-1);
 		size_t offset = hashTable[hashValue];
 
@@ -156,6 +269,199 @@ size_t Weld( std::vector<T> & p, std::vector<size_t> & xrefs, HashFunction hash,
 
 
 
+/** Same as Weld, with the hash of every element worked out beforehand (i.e. all at
+ * once by a SIMD kernel, see MeshKernels.h).  pHashes[i] is the hash of p[i].
+ */
+template <class Array, class BinaryPredicate>
+size_t WeldHashed( Array & p, std::vector<size_t> & xrefs, const unsigned int * pHashes, BinaryPredicate equal )
+{
+	typedef typename Array::value_type T;
+
+	size_t const N = p.size();
+	size_t outputCount = 0;
+	WeldTable table(N);
+
+	xrefs.resize(N);
+
+	for (size_t i = 0; i < N; ++i)
+	{
+		const T e = p[i];
+		unsigned int hashValue = pHashes[i];
+
+		for (size_t s = table.First(hashValue); ; s = table.Next(s))
+		{
+			WeldSlot & slot = table[s];
+
+			if( slot.index == WELD_EMPTY_SLOT )
+			{
+				slot.hash = hashValue;
+				slot.index = (unsigned int) outputCount;
+				xrefs[i] = outputCount;
+				p[outputCount++] = e;
+				break;
+			}
+
+			if( slot.hash == hashValue && equal(p[slot.index], e) )
+			{
+				xrefs[i] = slot.index;
+				break;
+			}
+		}
+	}
+
+	p.resize(outputCount);
+
+	return outputCount;
+}
+
+
+
+/** Last step of the welds that find the first occurrence of every element first
+ * (xrefs[i] = index of the first element equal to p[i], i itself if it's the first):
+ * number the first occurrences in element order, drop the rest.  A first occurrence
+ * comes before all its duplicates, so their xrefs can be looked up as we go, and
+ * values only ever move down
+ */
+template <class Array>
+size_t WeldNumberFirst( Array & p, std::vector<size_t> & xrefs )
+{
+	typedef typename Array::value_type T;
+
+	size_t const N = p.size();
+	size_t outputCount = 0;
+
+	for (size_t i = 0; i < N; ++i)
+	{
+		if( xrefs[i] == i )
+		{
+			const T e = p[i];
+			p[outputCount] = e;
+			xrefs[i] = outputCount++;
+		}
+		else
+		{
+			xrefs[i] = xrefs[xrefs[i]];
+		}
+	}
+
+	p.resize(outputCount);
+
+	return outputCount;
+}
+
+
+
+/** One partition of WeldPartitioned: finds the first occurrence (index into p) of
+ * each of its elements.  Equal elements always land in the same partition, so that's
+ * the first occurrence over the whole array.  Only writes pFirst[] of its own elements.
+ */
+template <class Array, class BinaryPredicate>
+class WeldPartitionTask : public Task
+{
+	public:
+		WeldPartitionTask() : m_pValues(NULL), m_pHashes(NULL), m_pMembers(NULL), m_cnt(0), m_pFirst(NULL) {}
+
+		void Set(const Array *pValues, const unsigned int *pHashes, const size_t *pMembers, size_t cnt, size_t *pFirst, BinaryPredicate equal)
+		{
+			m_pValues = pValues; m_pHashes = pHashes; m_pMembers = pMembers; m_cnt = cnt; m_pFirst = pFirst; m_equal = equal;
+		}
+
+		virtual void Run()
+		{
+			typedef typename Array::value_type T;
+
+			const Array & p = *m_pValues;
+			WeldTable table(m_cnt);	// members seen first, by local index
+
+			// members are in increasing order: the first one found is the first occurrence
+			for (size_t j = 0; j < m_cnt; ++j)
+			{
+				size_t i = m_pMembers[j];
+				const T e = p[i];
+				unsigned int hashValue = m_pHashes[i];
+
+				for (size_t s = table.First(hashValue); ; s = table.Next(s))
+				{
+					WeldSlot & slot = table[s];
+
+					if( slot.index == WELD_EMPTY_SLOT )
+					{
+						slot.hash = hashValue;
+						slot.index = (unsigned int) j;
+						m_pFirst[i] = i;
+						break;
+					}
+
+					if( slot.hash == hashValue && m_equal(p[m_pMembers[slot.index]], e) )
+					{
+						m_pFirst[i] = m_pMembers[slot.index];
+						break;
+					}
+				}
+			}
+		}
+
+	private:
+		const Array *m_pValues;
+		const unsigned int *m_pHashes;
+		const size_t *m_pMembers;
+		size_t m_cnt;
+		size_t *m_pFirst;
+		BinaryPredicate m_equal;
+};
+
+
+
+/** Partition parallel WeldHashed, for very large arrays.  Elements are split into
+ * 'partCnt' partitions by hash, each partition is deduplicated on its own thread, then
+ * one pass in element order numbers the first occurrences and fixes p and xrefs.
+ * The result is identical to WeldHashed's: unique elements in order of first occurrence.
+ */
+template <class Array, class BinaryPredicate>
+size_t WeldPartitioned( Array & p, std::vector<size_t> & xrefs, const unsigned int * pHashes, BinaryPredicate equal,
+						TaskScheduler * pScheduler, int partCnt )
+{
+	size_t const N = p.size();
+	std::vector<size_t> partStart(partCnt + 1, 0);
+	std::vector<size_t> members(N);
+	std::vector<int> partOf(N);
+
+	// sort element indices by partition (counting sort, stays in element order within a partition).
+	// The partition comes from the hash's high bits, the slots of a partition's table use the low ones
+	for (size_t i = 0; i < N; ++i)
+	{
+		partOf[i] = (int) ((pHashes[i] >> 16) % (unsigned int) partCnt);
+		partStart[partOf[i] + 1]++;
+	}
+
+	for (int k = 0; k < partCnt; ++k)
+		partStart[k + 1] += partStart[k];
+
+	std::vector<size_t> fill(partStart.begin(), partStart.end() - 1);
+	for (size_t i = 0; i < N; ++i)
+		members[fill[partOf[i]]++] = i;
+
+	// first occurrence of every element, all partitions at once.  Goes into xrefs
+	xrefs.resize(N);
+
+	std::vector< WeldPartitionTask<Array, BinaryPredicate> > tasks(partCnt);
+	TaskGroup group(pScheduler);
+
+	for (int k = 0; k < partCnt; ++k)
+	{
+		tasks[k].Set(&p, pHashes, &members[0] + partStart[k], partStart[k + 1] - partStart[k], &xrefs[0], equal);
+		group.Run(&tasks[k]);
+	}
+
+	group.Wait();
+
+	return WeldNumberFirst(p, xrefs);
+}
+
+
+
+
+
 // example code
 #if 0
 
@@ -212,10 +518,10 @@ main(...
  * reorder(texcoords, num, xrefs);
  * @endcode
  */
-template <class T>
-void Reorder(std::vector<T> & array, const std::vector<size_t> & xrefs, const size_t num)
+template <class Array>
+void Reorder(Array & array, const std::vector<size_t> & xrefs, const size_t num)
 {
-	std::vector<T> new_array;
+	Array new_array;
 	new_array.resize(num);
 
 	for(size_t i = 0; i < num; ++i) {
@@ -223,7 +529,7 @@ void Reorder(std::vector<T> & array, const std::vector<size_t> & xrefs, const si
 	}
 
 	// replace old array by the new one.
-	std::swap(array, new_array);
+	array.swap(new_array);
 }
 
 
@@ -0,0 +1,345 @@
+//
+// Weld routine timings on made up data
+//
+
+
+
+//
+// System headers
+//
+#include <stdio.h>
+#include <vector>
+#include <functional>	// equal_to
+
+
+//
+// Project Includes
+//
+#include "WeldBench.h"
+#include "Weld.h"
+#include "WeldSort.h"
+#include "WeldGrid.h"
+#include "MeshKernels.h"
+#include "Quantize.h"
+#include "PerformanceCounter.h"
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DEFINES
+////////////////////////////////////////////////////////////////////////////////////////
+#define BENCH_CORNERS_PER_VERTEX	6		// a vertex of a closed triangle mesh is shared by ~6 triangles
+#define BENCH_RUNS					3		// best of
+#define BENCH_BRUTE_MAX				20000	// values the O(n^2) tolerance weld check runs on, at most
+#define BENCH_TOLERANCE_POS			0.001f	// 1mm
+#define BENCH_TOLERANCE_ANGLE		2.0f	// degrees
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// The hash WriteData used before (std::hash<Vec3>): a sum of the bit patterns, folded
+////////////////////////////////////////////////////////////////////////////////////////
+struct LegacyHashVec3
+{
+	size_t operator()(const Vec3 & v) const
+	{
+		const unsigned int * h = (const unsigned int *)(&v);
+		unsigned int f = (h[0]+h[1]*11-(h[2]*17))&0x7fffffff;     // avoid problems with +-0
+		return (f>>22)^(f>>12)^(f);
+	}
+};
+
+
+
+// small LCG: same data on every run and every platform
+static unsigned int NextRandom(unsigned int & state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Data sets
+////////////////////////////////////////////////////////////////////////////////////////
+
+// Corners of a rounded height field: grid points 1mm apart, each one used ~6 times, in
+// random order.  Rounded the way extraction rounds them
+static void MakeGridData(size_t count, SoAArray<Vec3> & values)
+{
+	size_t vertCnt = count / BENCH_CORNERS_PER_VERTEX + 1;
+	size_t side = 1;
+	unsigned int state = 1;
+
+	while(side * side < vertCnt)
+		side++;
+
+	values.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		size_t v = NextRandom(state) % vertCnt;
+		float x = (float) (v % side) * 0.001f;
+		float z = (float) (v / side) * 0.001f;
+		float y = (float) ((v * 7) % 13) * 0.0005f;
+
+		values[i] = Vec3(QuantizeValue(x, G_precision.pos), QuantizeValue(y, G_precision.pos), QuantizeValue(z, G_precision.pos));
+	}
+}
+
+
+
+// random points in a 10m cube, hardly any duplicates
+static void MakeRandomData(size_t count, SoAArray<Vec3> & values)
+{
+	unsigned int state = 2;
+
+	values.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		float x = (float) (NextRandom(state) % 100000) * 0.0001f;
+		float y = (float) (NextRandom(state) % 100000) * 0.0001f;
+		float z = (float) (NextRandom(state) % 100000) * 0.0001f;
+
+		values[i] = Vec3(QuantizeValue(x, G_precision.pos), QuantizeValue(y, G_precision.pos), QuantizeValue(z, G_precision.pos));
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Share of the slots of a table sized for the unique values that their hashes land on.
+// 100% = no two values start probing at the same slot
+////////////////////////////////////////////////////////////////////////////////////////
+template <class HashFunction>
+static double SlotsUsed(const SoAArray<Vec3> & unique, HashFunction hash)
+{
+	size_t slotCnt = NextPowerOfTwo(unique.size());
+	std::vector<bool> used(slotCnt, false);
+	size_t usedCnt = 0;
+
+	for(size_t i = 0; i < unique.size(); i++)
+	{
+		size_t slot = (size_t) hash(unique[i]) & (slotCnt - 1);
+		if(!used[slot])
+		{
+			used[slot] = true;
+			usedCnt++;
+		}
+	}
+
+	return unique.empty() ? 100.0 : 100.0 * (double) usedCnt / (double) unique.size();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Time every routine on one data set
+////////////////////////////////////////////////////////////////////////////////////////
+enum BenchRoutine
+{
+	BENCH_CHAINED,
+	BENCH_OPEN,
+	BENCH_OPEN_SIMD,
+	BENCH_SORTED,
+	BENCH_ROUTINES
+};
+
+static const char *G_routineNames[BENCH_ROUTINES] =
+{
+	"chained table, old hash",
+	"open addressing, new hash",
+	"open addressing, SIMD hashes",
+	"radix sort, SIMD hashes"
+};
+
+
+
+static void BenchDataSet(const char *pName, const SoAArray<Vec3> & data)
+{
+	std::vector<size_t> xrefs[BENCH_ROUTINES];
+	SoAArray<Vec3> welded;
+	double best[BENCH_ROUTINES];
+
+	for(int r = 0; r < BENCH_ROUTINES; r++)
+	{
+		best[r] = 1e30;
+
+		for(int run = 0; run < BENCH_RUNS; run++)
+		{
+			TimerPerformanceCounter timer;
+			SoAArray<Vec3> values(data);
+			std::vector<unsigned int> hashes;
+
+			timer.Start();
+
+			switch(r)
+			{
+				case BENCH_CHAINED:
+					WeldChained(values, xrefs[r], LegacyHashVec3(), std::equal_to<Vec3>());
+					break;
+
+				case BENCH_OPEN:
+					Weld(values, xrefs[r], WeldHashVec3(), std::equal_to<Vec3>());
+					break;
+
+				case BENCH_OPEN_SIMD:
+					hashes.resize(values.size());
+					HashVec3s(values.Lane(0), values.Lane(1), values.Lane(2), values.size(), hashes.empty() ? NULL : &hashes[0]);
+					WeldHashed(values, xrefs[r], hashes.empty() ? NULL : &hashes[0], std::equal_to<Vec3>());
+					break;
+
+				case BENCH_SORTED:
+					hashes.resize(values.size());
+					HashVec3s(values.Lane(0), values.Lane(1), values.Lane(2), values.size(), hashes.empty() ? NULL : &hashes[0]);
+					WeldSorted(values, xrefs[r], hashes.empty() ? NULL : &hashes[0], std::equal_to<Vec3>(), G_pTaskScheduler);
+					break;
+			}
+
+			timer.Stop();
+
+			if(timer.IntervalSeconds() < best[r])
+				best[r] = timer.IntervalSeconds();
+
+			if(r == BENCH_CHAINED)
+				welded = values;
+		}
+	}
+
+	printf("%s: %u values, %u unique\n", pName, (unsigned int) data.size(), (unsigned int) welded.size());
+	printf("\tslots hit by the old hash %.1f%%, by the new one %.1f%%\n", SlotsUsed(welded, LegacyHashVec3()), SlotsUsed(welded, WeldHashVec3()));
+
+	for(int r = 0; r < BENCH_ROUTINES; r++)
+	{
+		printf("\t%-32s%9.2f ms%s\n", G_routineNames[r], best[r] * 1000.0,
+				xrefs[r] == xrefs[BENCH_CHAINED] ? "" : "   ***  ERROR: results differ from the chained table");
+	}
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Tolerance weld check.  The same rule as WeldWithin, the slow way: every value is
+// compared with every value kept so far, and merges with the first one close enough
+////////////////////////////////////////////////////////////////////////////////////////
+template <class Array, class Metric>
+static size_t WeldWithinBruteForce(Array & p, std::vector<size_t> & xrefs, const Metric & metric)
+{
+	typedef typename Array::value_type T;
+	size_t outputCount = 0;
+
+	xrefs.resize(p.size());
+
+	for(size_t i = 0; i < p.size(); i++)
+	{
+		const T e = p[i];
+		size_t j = 0;
+
+		while(j < outputCount && !metric.Near(p[j], e))
+			j++;
+
+		xrefs[i] = j;
+		if(j == outputCount)
+			p[outputCount++] = e;
+	}
+
+	p.resize(outputCount);
+
+	return outputCount;
+}
+
+
+
+// Clusters of points a bit over the tolerance across, 1cm apart: some pairs in a cluster
+// are within the tolerance and some aren't, so which value a point merges with matters
+static void MakeJitteredData(size_t count, SoAArray<Vec3> & values)
+{
+	size_t vertCnt = count / BENCH_CORNERS_PER_VERTEX + 1;
+	unsigned int state = 3;
+
+	values.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		size_t v = NextRandom(state) % vertCnt;
+		float jitter[3];
+
+		for(int k = 0; k < 3; k++)
+			jitter[k] = ((float) (NextRandom(state) % 1001) - 500.0f) * (1.2f * BENCH_TOLERANCE_POS / 1000.0f);
+
+		values[i] = Vec3((float) (v % 100) * 0.01f + jitter[0], (float) ((v / 100) % 100) * 0.01f + jitter[1], (float) (v / 10000) * 0.01f + jitter[2]);
+	}
+}
+
+
+
+// Unit normals a couple of degrees around a few hundred directions, and some zero length ones
+static void MakeJitteredNormals(size_t count, SoAArray<Vec3> & values)
+{
+	unsigned int state = 4;
+
+	values.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		unsigned int d = NextRandom(state) % 300;
+		float theta = (float) (d % 20) * 0.157f + (float) (NextRandom(state) % 1001) * 0.00004f;
+		float phi = (float) (d / 20) * 0.419f + (float) (NextRandom(state) % 1001) * 0.00004f;
+
+		if(d == 0)
+			values[i] = Vec3(0.0f, 0.0f, 0.0f);
+		else
+			values[i] = Vec3(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta));
+	}
+}
+
+
+
+template <class Metric>
+static void CheckToleranceWeld(const char *pName, const SoAArray<Vec3> & data, const Metric & metric)
+{
+	std::vector<size_t> gridXrefs, bruteXrefs;
+	SoAArray<Vec3> grid(data), brute(data);
+	TimerPerformanceCounter gridTimer, bruteTimer;
+
+	gridTimer.Start();
+	WeldWithin(grid, gridXrefs, metric);
+	gridTimer.Stop();
+
+	bruteTimer.Start();
+	WeldWithinBruteForce(brute, bruteXrefs, metric);
+	bruteTimer.Stop();
+
+	printf("%s: %u values, %u unique\n", pName, (unsigned int) data.size(), (unsigned int) brute.size());
+	printf("\t%-32s%9.2f ms\n", "brute force", bruteTimer.IntervalSeconds() * 1000.0);
+	printf("\t%-32s%9.2f ms%s\n", "grid", gridTimer.IntervalSeconds() * 1000.0,
+			gridXrefs == bruteXrefs ? "" : "   ***  ERROR: results differ from the brute force weld");
+}
+
+
+
+
+void RunWeldBenchmark(size_t count)
+{
+	SoAArray<Vec3> data;
+
+	printf("Weld benchmark, kernels at %s level, best of %d runs\n", CpuDispatch::GetLevelName(G_cpuLevel), BENCH_RUNS);
+
+	MakeGridData(count, data);
+	BenchDataSet("Rounded grid", data);
+
+	MakeRandomData(count, data);
+	BenchDataSet("Random points", data);
+
+	// the tolerance weld against the brute force one, on no more values than that can take
+	size_t bruteCount = count < BENCH_BRUTE_MAX ? count : BENCH_BRUTE_MAX;
+
+	MakeJitteredData(bruteCount, data);
+	CheckToleranceWeld("Jittered points within 1mm", data, DistanceMetric<Vec3, 3>(BENCH_TOLERANCE_POS));
+
+	MakeJitteredNormals(bruteCount, data);
+	CheckToleranceWeld("Jittered normals within 2 degrees", data, AngleMetric(BENCH_TOLERANCE_ANGLE));
+}
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////
+// WELDBENCH.H
+//
+// Timings of the weld routines on made up
+// data (--weld-bench N): the original chained
+// table with the original hash, against the
+// open addressing table with the new hashes
+// (scalar functor, then the SIMD kernels),
+// and the radix sort weld.
+// Also reports how well each hash spreads the
+// values over the table's slots, and checks the
+// tolerance weld (WeldGrid.h) against a brute
+// force one on jittered points and normals.
+////////////////////////////////////////////////
+
+
+#ifndef _WELD_BENCH_H_
+#define _WELD_BENCH_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <stddef.h>
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// weld 'count' positions of each data set with every routine, print the times.  Results are checked against each other,
+// the tolerance weld's against a brute force weld of up to BENCH_BRUTE_MAX values
+void RunWeldBenchmark(size_t count);
+
+
+
+#endif // _WELD_BENCH_H_
@@ -0,0 +1,34 @@
+//
+// Weld tolerances
+//
+
+
+
+//
+// Project Includes
+//
+#include "WeldGrid.h"
+#include "Quantize.h"	// ParseAttributeFloats
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+////////////////////////////////////////////////////////////////////////////////////////
+AttributeFloats G_tolerance = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };	// exact welds
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// "pos=0.001,nrm=2" etc.  0 turns a tolerance back off
+////////////////////////////////////////////////////////////////////////////////////////
+bool ParseTolerance(const char *pList, AttributeFloats & tolerance)
+{
+	if(!ParseAttributeFloats(pList, tolerance, 0.0f))
+		return false;
+
+	// angles past 180 degrees don't mean anything
+	return tolerance.nrm <= 180.0f && tolerance.tan <= 180.0f && tolerance.bin <= 180.0f;
+}
@@ -0,0 +1,269 @@
+////////////////////////////////////////////////
+// WELDGRID.H
+//
+// Welding within a tolerance, instead of exact
+// equality after rounding.  Rounding puts two
+// values 1e-6 apart in different steps when
+// they straddle a step boundary, so they never
+// merge (cracks), and how far apart merged
+// values are depends on where the boundaries
+// fall.  Here values merge when they are truly
+// within 'tolerance' of each other:
+// - every value goes in a grid cell twice the
+//   tolerance wide, so anything within reach is
+//   in its own cell or the neighbour on the
+//   nearer side, per axis (2, 4, 8, 16 cells
+//   for 1 to 4 dimensions)
+// - a value merges with the FIRST value kept
+//   (lowest output index) within tolerance, or
+//   is kept itself.  Same input, same output,
+//   on any thread count
+// Directions (normals, tangents, binormals)
+// merge by the angle between them instead.
+////////////////////////////////////////////////
+
+
+#ifndef _WELD_GRID_H_
+#define _WELD_GRID_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <vector>
+
+#include "DataTypes.h"
+#include "WeldHash.h"
+#include "Weld.h"		// WeldTable
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define WELD_GRID_CELL_SCALE	2.01f			// cell size / tolerance.  A bit over 2: float error at the cell edges stays inside the probed cells
+#define WELD_GRID_MAX_CELL		1.0e9f			// cell coordinates get clamped to this, far beyond any sensible scene
+#define WELD_GRID_MAX_DIMS		4
+
+
+
+
+/*----------------------------------------------------------------------------
+	Globals:
+----------------------------------------------------------------------------*/
+
+// Weld tolerance of every kind of vertex value, 0 = exact weld after rounding (the default).
+// pos, tex and col are distances, nrm, tan and bin angles in degrees.  Values welded with a
+// tolerance aren't rounded
+extern AttributeFloats G_tolerance;
+
+bool ParseTolerance(const char *pList, AttributeFloats & tolerance);
+
+
+
+
+/*----------------------------------------------------------------------------
+	Metrics:  where a value goes in the grid, and whether two values are close
+	enough.  They provide:
+		enum { DIMS = <grid dimensions> };
+		void Coords(const T & value, float *pCoords) const;	// position in cell units
+		bool Near(const T & a, const T & b) const;
+----------------------------------------------------------------------------*/
+
+// components of the value types, as an array
+inline void WeldComponents(const Vec3 & v, float *p) { p[0] = v.x; p[1] = v.y; p[2] = v.z; }
+inline void WeldComponents(const TexCoord & uv, float *p) { p[0] = uv.u; p[1] = uv.v; }
+inline void WeldComponents(const ColorRGBA & c, float *p) { p[0] = c.r; p[1] = c.g; p[2] = c.b; p[3] = c.a; }
+
+
+
+// straight line distance
+template <class T, int N>
+class DistanceMetric
+{
+	public:
+		enum { DIMS = N };
+
+		DistanceMetric(float tolerance) : m_tolerance2(tolerance * tolerance), m_invCell(1.0f / (WELD_GRID_CELL_SCALE * tolerance)) {}
+
+		void Coords(const T & value, float *pCoords) const
+		{
+			WeldComponents(value, pCoords);
+			for(int k = 0; k < DIMS; k++)
+				pCoords[k] *= m_invCell;
+		}
+
+		bool Near(const T & a, const T & b) const
+		{
+			float ca[DIMS], cb[DIMS], d2 = 0.0f;
+
+			WeldComponents(a, ca);
+			WeldComponents(b, cb);
+			for(int k = 0; k < DIMS; k++)
+				d2 += (ca[k] - cb[k]) * (ca[k] - cb[k]);
+
+			return d2 <= m_tolerance2;
+		}
+
+	private:
+		float m_tolerance2;
+		float m_invCell;
+};
+
+
+
+// Angle between directions.  Placed in the grid by their unit vector: unit vectors 'angle' apart
+// are 2*sin(angle/2) apart.  Zero length vectors only merge with each other
+class AngleMetric
+{
+	public:
+		enum { DIMS = 3 };
+
+		AngleMetric(float degrees)
+		{
+			float radians = degrees * 3.14159265f / 180.0f;
+
+			m_minCos = cosf(radians);
+			m_invCell = 1.0f / (WELD_GRID_CELL_SCALE * 2.0f * sinf(radians * 0.5f));
+		}
+
+		void Coords(const Vec3 & v, float *pCoords) const
+		{
+			float len = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+			float scale = len > 0.0f ? m_invCell / len : 0.0f;
+
+			pCoords[0] = v.x * scale;
+			pCoords[1] = v.y * scale;
+			pCoords[2] = v.z * scale;
+		}
+
+		bool Near(const Vec3 & a, const Vec3 & b) const
+		{
+			float la = a.x * a.x + a.y * a.y + a.z * a.z;
+			float lb = b.x * b.x + b.y * b.y + b.z * b.z;
+
+			if(la == 0.0f || lb == 0.0f)
+				return la == lb;
+
+			float dot = a.x * b.x + a.y * b.y + a.z * b.z;
+			return dot >= m_minCos * sqrtf(la * lb);
+		}
+
+	private:
+		float m_minCos;
+		float m_invCell;
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// hash of a grid cell
+inline unsigned int WeldCellHash(const int *pCell, int dims)
+{
+	static const unsigned int primes[WELD_GRID_MAX_DIMS] = { WELD_HASH_PRIME_0, WELD_HASH_PRIME_1, WELD_HASH_PRIME_2, WELD_HASH_PRIME_3 };
+	unsigned int h = 0;
+
+	for(int k = 0; k < dims; k++)
+		h += (unsigned int) pCell[k] * primes[k];
+
+	return WeldHashMix(h);
+}
+
+
+
+/** Weld the elements of p that are within the metric's tolerance of each other, see
+ * the top of this file.  Same interface as Weld: p keeps the unique elements (in order
+ * of first occurrence), xrefs maps every input element to its output slot.
+ * Every kept element sits in the table once, under the hash of its own cell; a
+ * lookup walks the probe sequences of all the cells within reach.
+ */
+template <class Array, class Metric>
+size_t WeldWithin( Array & p, std::vector<size_t> & xrefs, const Metric & metric )
+{
+	typedef typename Array::value_type T;
+	enum { DIMS = Metric::DIMS };
+
+	size_t const NIL = size_t(~0);
+	size_t const N = p.size();
+	size_t outputCount = 0;
+	WeldTable table(N);
+
+	xrefs.resize(N);
+
+	for (size_t i = 0; i < N; ++i)
+	{
+		const T e = p[i];
+		float coords[DIMS];
+		int cell[DIMS], side[DIMS], probe[DIMS];
+		unsigned int ownHash = 0;
+		size_t best = NIL;
+
+		metric.Coords(e, coords);
+		for (int k = 0; k < DIMS; ++k)
+		{
+			float c = coords[k] < -WELD_GRID_MAX_CELL ? -WELD_GRID_MAX_CELL : (coords[k] > WELD_GRID_MAX_CELL ? WELD_GRID_MAX_CELL : coords[k]);
+			float f = floorf(c);
+
+			cell[k] = (int) f;
+			side[k] = c - f < 0.5f ? -1 : 1;	// neighbour on the nearer side
+		}
+
+		// every combination of own cell / neighbour per axis
+		for (int mask = 0; mask < (1 << DIMS); ++mask)
+		{
+			for (int k = 0; k < DIMS; ++k)
+				probe[k] = cell[k] + (((mask >> k) & 1) ? side[k] : 0);
+
+			unsigned int hashValue = WeldCellHash(probe, DIMS);
+			if( mask == 0 )
+				ownHash = hashValue;
+
+			for (size_t s = table.First(hashValue); table[s].index != WELD_EMPTY_SLOT; s = table.Next(s))
+			{
+				const WeldSlot & slot = table[s];
+
+				if( slot.hash == hashValue && slot.index < best && metric.Near(p[slot.index], e) )
+					best = slot.index;
+			}
+		}
+
+		if( best != NIL )
+		{
+			xrefs[i] = best;
+			continue;
+		}
+
+		// nothing close: keep it
+		for (size_t s = table.First(ownHash); ; s = table.Next(s))
+		{
+			WeldSlot & slot = table[s];
+
+			if( slot.index == WELD_EMPTY_SLOT )
+			{
+				slot.hash = ownHash;
+				slot.index = (unsigned int) outputCount;
+				break;
+			}
+		}
+
+		xrefs[i] = outputCount;
+		p[outputCount++] = e;
+	}
+
+	p.resize(outputCount);
+
+	return outputCount;
+}
+
+
+
+#endif // _WELD_GRID_H_
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////
+// WELDHASH.H
+//
+// Hashes of vertex values for welding.  The
+// float bit patterns (-0 turned into +0, they
+// compare equal) are spread over all 32 bits
+// by a multiply per component and a murmur3
+// finalizer.  Grid aligned (quantized) values
+// only differ in a few mantissa bits, this
+// makes every bit of the hash depend on them.
+// The SIMD kernels in MeshKernels.cpp compute
+// exactly the same values.
+////////////////////////////////////////////////
+
+
+#ifndef _WELD_HASH_H_
+#define _WELD_HASH_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <string.h>		// memcpy
+
+#include "DataTypes.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define WELD_HASH_PRIME_0	0x9e3779b1u
+#define WELD_HASH_PRIME_1	0x85ebca77u
+#define WELD_HASH_PRIME_2	0xc2b2ae3du
+#define WELD_HASH_PRIME_3	0x27d4eb2fu
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// bit pattern of a float, -0 as +0
+inline unsigned int WeldHashBits(float f)
+{
+	unsigned int u;
+	memcpy(&u, &f, sizeof(u));
+	return u == 0x80000000u ? 0 : u;
+}
+
+// murmur3's 32 bit finalizer: every input bit affects every output bit
+inline unsigned int WeldHashMix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+// hash functors for Weld
+struct WeldHashVec3
+{
+	unsigned int operator()(const Vec3 & v) const
+	{
+		return WeldHashMix(WeldHashBits(v.x) * WELD_HASH_PRIME_0 + WeldHashBits(v.y) * WELD_HASH_PRIME_1 + WeldHashBits(v.z) * WELD_HASH_PRIME_2);
+	}
+};
+
+struct WeldHashTexCoord
+{
+	unsigned int operator()(const TexCoord & uv) const
+	{
+		return WeldHashMix(WeldHashBits(uv.u) * WELD_HASH_PRIME_0 + WeldHashBits(uv.v) * WELD_HASH_PRIME_1);
+	}
+};
+
+struct WeldHashColor
+{
+	unsigned int operator()(const ColorRGBA & c) const
+	{
+		return WeldHashMix(WeldHashBits(c.r) * WELD_HASH_PRIME_0 + WeldHashBits(c.g) * WELD_HASH_PRIME_1 +
+							WeldHashBits(c.b) * WELD_HASH_PRIME_2 + WeldHashBits(c.a) * WELD_HASH_PRIME_3);
+	}
+};
+
+
+
+#endif // _WELD_HASH_H_
@@ -0,0 +1,370 @@
+////////////////////////////////////////////////
+// WELDSORT.H
+//
+// Welding by sorting instead of a hash table,
+// for huge arrays.  Past a few tens of millions
+// of elements nearly every table probe misses
+// the cache.  Here:
+// - every element becomes an entry: its weld
+//   hash, its index and a copy of the value
+// - the entries are radix sorted by hash (LSD,
+//   stable: equal hashes stay in element order).
+//   Every pass streams through memory, and runs
+//   on every thread
+// - equal elements end up next to each other, in
+//   runs of equal hashes.  Within a run the first
+//   element equal to another is its first
+//   occurrence.  Runs are split up across
+//   threads, and only look at their own entries:
+//   no random reads
+// - first occurrences are numbered in element
+//   order, like WeldPartitioned
+// Same result as Weld: unique elements in order
+// of first occurrence.  Takes two entries of
+// memory per element.
+// WeldAuto picks the routine by array size.
+////////////////////////////////////////////////
+
+
+#ifndef _WELD_SORT_H_
+#define _WELD_SORT_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <vector>
+#include <string.h>		// memset
+#include <assert.h>
+
+#include "Weld.h"
+#include "TaskScheduler.h"
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define WELD_SORT_MIN				(1 << 25)	// elements.  Arrays this long are welded by sorting
+#define WELD_SORT_DIGIT_BITS		11			// 3 passes for 32 bit hashes, 2K counters per task (fits L1)
+#define WELD_SORT_BUCKETS			(1 << WELD_SORT_DIGIT_BITS)
+#define WELD_SORT_TASKS_PER_THREAD	2
+
+
+
+
+/*----------------------------------------------------------------------------
+	Structs:
+----------------------------------------------------------------------------*/
+
+template <class T>
+struct WeldSortEntry
+{
+	unsigned int hash;
+	unsigned int index;		// in the input array
+	T value;
+};
+
+
+
+
+/*----------------------------------------------------------------------------
+	Functions:
+----------------------------------------------------------------------------*/
+
+// tasks the sort weld splits its work into
+inline int GetWeldSortTaskCount(TaskScheduler *pScheduler)
+{
+	return pScheduler ? WELD_SORT_TASKS_PER_THREAD * pScheduler->GetThreadCount() : 1;
+}
+
+
+
+
+/*----------------------------------------------------------------------------
+	Templates:
+----------------------------------------------------------------------------*/
+
+/** One range of entries, through every step of WeldSortByHash.  Makes the entries of its
+ * range of elements, then for every pass: counts the digits of its range, then (once
+ * every task has counted, and the counts have become where each digit of this range
+ * goes) moves the entries there.  Ranges keep their order, so the sort is stable.
+ */
+enum WeldSortStep
+{
+	WELD_SORT_FILL,
+	WELD_SORT_COUNT,
+	WELD_SORT_MOVE
+};
+
+template <class Array>
+class WeldSortRangeTask : public Task
+{
+	public:
+		typedef WeldSortEntry<typename Array::value_type> Entry;
+
+		WeldSortRangeTask() : m_step(WELD_SORT_FILL), m_pValues(NULL), m_pHashes(NULL), m_pSrc(NULL), m_pDst(NULL), m_first(0), m_end(0), m_shift(0) {}
+
+		void SetRange(size_t first, size_t end) { m_first = first; m_end = end; }
+		void SetFill(const Array *pValues, const unsigned int *pHashes, Entry *pDst) { m_step = WELD_SORT_FILL; m_pValues = pValues; m_pHashes = pHashes; m_pDst = pDst; }
+		void SetPass(WeldSortStep step, const Entry *pSrc, Entry *pDst, int shift) { m_step = step; m_pSrc = pSrc; m_pDst = pDst; m_shift = shift; }
+
+		virtual void Run()
+		{
+			switch(m_step)
+			{
+				case WELD_SORT_FILL:
+					for (size_t i = m_first; i < m_end; ++i)
+					{
+						m_pDst[i].hash = m_pHashes[i];
+						m_pDst[i].index = (unsigned int) i;
+						m_pDst[i].value = (*m_pValues)[i];
+					}
+					break;
+
+				case WELD_SORT_COUNT:
+					memset(m_counts, 0, sizeof(m_counts));
+					for (size_t i = m_first; i < m_end; ++i)
+						m_counts[Digit(m_pSrc[i])]++;
+					break;
+
+				case WELD_SORT_MOVE:
+					for (size_t i = m_first; i < m_end; ++i)
+						m_pDst[m_counts[Digit(m_pSrc[i])]++] = m_pSrc[i];
+					break;
+			}
+		}
+
+		size_t m_counts[WELD_SORT_BUCKETS];	// entries per digit, then where the next one of each digit goes
+
+	private:
+		WeldSortStep m_step;
+		const Array *m_pValues;
+		const unsigned int *m_pHashes;
+		const Entry *m_pSrc;
+		Entry *m_pDst;
+		size_t m_first, m_end;
+		int m_shift;
+
+		size_t Digit(const Entry & entry) const { return (entry.hash >> m_shift) & (WELD_SORT_BUCKETS - 1); }
+};
+
+
+
+/** Entries of all the elements of p, sorted by hash (see the top of this file).  Up to 4G
+ * elements.  NULL scheduler = all on this thread
+ */
+template <class Array>
+void WeldSortByHash( const Array & p, const unsigned int * pHashes, std::vector< WeldSortEntry<typename Array::value_type> > & sorted,
+						TaskScheduler * pScheduler )
+{
+	typedef WeldSortEntry<typename Array::value_type> Entry;
+
+	size_t const N = p.size();
+	int taskCnt = GetWeldSortTaskCount(pScheduler);
+	std::vector< WeldSortRangeTask<Array> > tasks(taskCnt);
+
+	assert(N <= 0xffffffff);
+
+	sorted.resize(N);
+	if( N == 0 )
+		return;
+
+	std::vector<Entry> other(N);
+
+	for (int k = 0; k < taskCnt; ++k)
+		tasks[k].SetRange(N * k / taskCnt, N * (k + 1) / taskCnt);
+
+	{
+		TaskGroup group(pScheduler);
+
+		for (int k = 0; k < taskCnt; ++k)
+		{
+			tasks[k].SetFill(&p, pHashes, &sorted[0]);
+			group.Run(&tasks[k]);
+		}
+
+		group.Wait();
+	}
+
+	// least significant digit first
+	Entry *pSrc = &sorted[0];
+	Entry *pDst = &other[0];
+
+	for (int shift = 0; shift < 32; shift += WELD_SORT_DIGIT_BITS)
+	{
+		TaskGroup group(pScheduler);
+
+		for (int k = 0; k < taskCnt; ++k)
+		{
+			tasks[k].SetPass(WELD_SORT_COUNT, pSrc, pDst, shift);
+			group.Run(&tasks[k]);
+		}
+
+		group.Wait();
+
+		// where each range's entries of each digit go: all the smaller digits first, then this digit in the ranges
+		// before.  A digit every entry has wouldn't move anything: skip the pass
+		size_t at = 0;
+		bool allSame = false;
+
+		for (int d = 0; d < WELD_SORT_BUCKETS; ++d)
+		{
+			size_t digitStart = at;
+
+			for (int k = 0; k < taskCnt; ++k)
+			{
+				size_t n = tasks[k].m_counts[d];
+				tasks[k].m_counts[d] = at;
+				at += n;
+			}
+
+			allSame = allSame || at - digitStart == N;
+		}
+
+		if( allSame )
+			continue;
+
+		for (int k = 0; k < taskCnt; ++k)
+		{
+			tasks[k].SetPass(WELD_SORT_MOVE, pSrc, pDst, shift);
+			group.Run(&tasks[k]);
+		}
+
+		group.Wait();
+
+		Entry *pSwap = pSrc;
+		pSrc = pDst;
+		pDst = pSwap;
+	}
+
+	if( pSrc != &sorted[0] )
+		sorted.swap(other);
+}
+
+
+
+/** A range of sorted entries of WeldSorted, starting and ending on runs of equal hashes:
+ * finds the first occurrence of each of its elements.  Only writes pFirst[] of its own
+ * elements.
+ */
+template <class T, class BinaryPredicate>
+class WeldRunTask : public Task
+{
+	public:
+		WeldRunTask() : m_pSorted(NULL), m_cnt(0), m_pFirst(NULL) {}
+
+		void Set(const WeldSortEntry<T> *pSorted, size_t cnt, size_t *pFirst, BinaryPredicate equal)
+		{
+			m_pSorted = pSorted; m_cnt = cnt; m_pFirst = pFirst; m_equal = equal;
+		}
+
+		virtual void Run()
+		{
+			std::vector<size_t> kept;	// entries of the distinct elements of the run so far.  More than one only if hashes collide
+
+			for (size_t s = 0; s < m_cnt; )
+			{
+				size_t runStart = s;
+
+				kept.clear();
+				for (; s < m_cnt && m_pSorted[s].hash == m_pSorted[runStart].hash; ++s)
+				{
+					const WeldSortEntry<T> & e = m_pSorted[s];
+					size_t k = 0;
+
+					while( k < kept.size() && !m_equal(m_pSorted[kept[k]].value, e.value) )
+						++k;
+
+					if( k == kept.size() )
+						kept.push_back(s);
+
+					m_pFirst[e.index] = m_pSorted[kept[k]].index;
+				}
+			}
+		}
+
+	private:
+		const WeldSortEntry<T> *m_pSorted;
+		size_t m_cnt;
+		size_t *m_pFirst;
+		BinaryPredicate m_equal;
+};
+
+
+
+/** Sort based weld, see the top of this file.  pHashes[i] is the hash of p[i]
+ */
+template <class Array, class BinaryPredicate>
+size_t WeldSorted( Array & p, std::vector<size_t> & xrefs, const unsigned int * pHashes, BinaryPredicate equal, TaskScheduler * pScheduler )
+{
+	typedef typename Array::value_type T;
+
+	size_t const N = p.size();
+	std::vector< WeldSortEntry<T> > sorted;
+
+	xrefs.resize(N);
+	if( N == 0 )
+		return 0;
+
+	WeldSortByHash(p, pHashes, sorted, pScheduler);
+
+	// split the entries into ranges that don't cut runs in two
+	int taskCnt = GetWeldSortTaskCount(pScheduler);
+	std::vector<size_t> start(taskCnt + 1, N);
+
+	start[0] = 0;
+	for (int k = 1; k < taskCnt; ++k)
+	{
+		size_t s = N * k / taskCnt;
+
+		s = s < start[k - 1] ? start[k - 1] : s;
+		while( s > 0 && s < N && sorted[s].hash == sorted[s - 1].hash )
+			++s;
+
+		start[k] = s;
+	}
+
+	// first occurrence of every element, all ranges at once.  Goes into xrefs
+	std::vector< WeldRunTask<T, BinaryPredicate> > tasks(taskCnt);
+	TaskGroup group(pScheduler);
+
+	for (int k = 0; k < taskCnt; ++k)
+	{
+		tasks[k].Set(&sorted[0] + start[k], start[k + 1] - start[k], &xrefs[0], equal);
+		group.Run(&tasks[k]);
+	}
+
+	group.Wait();
+
+	std::vector< WeldSortEntry<T> >().swap(sorted);
+
+	return WeldNumberFirst(p, xrefs);
+}
+
+
+
+/** Weld with whichever routine suits the array size, all with the same result: sorting
+ * for huge arrays, partitions on every thread for large ones, one table for the rest.
+ * On a single thread sorting moves more memory than the table's cache misses cost, so
+ * it's only picked with a scheduler
+ */
+template <class Array, class BinaryPredicate>
+size_t WeldAuto( Array & p, std::vector<size_t> & xrefs, const unsigned int * pHashes, BinaryPredicate equal, TaskScheduler * pScheduler )
+{
+	if( pScheduler && p.size() >= WELD_SORT_MIN )
+		return WeldSorted(p, xrefs, pHashes, equal, pScheduler);
+
+	if( pScheduler && p.size() >= WELD_PARTITION_MIN )
+		return WeldPartitioned(p, xrefs, pHashes, equal, pScheduler, WELD_PARTITIONS_PER_THREAD * pScheduler->GetThreadCount());
+
+	return WeldHashed(p, xrefs, pHashes, equal);
+}
+
+
+
+#endif // _WELD_SORT_H_
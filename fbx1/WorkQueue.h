@@ -0,0 +1,255 @@
+////////////////////////////////////////////////
+// WORKQUEUE.H
+//
+// Bounded multi-producer/multi-consumer queue
+// used to hand work items to the worker threads.
+// The ring itself is lock-free (each cell carries
+// a sequence number, see D. Vyukov's bounded MPMC
+// queue); two semaphores are only used to put
+// threads to sleep when the queue is empty/full
+// so nobody burns a core spinning.
+////////////////////////////////////////////////
+
+
+#ifndef _WORK_QUEUE_H_
+#define _WORK_QUEUE_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <assert.h>
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+template <class T>
+class WorkQueue
+{
+	public:
+		WorkQueue(size_t capacity);
+		~WorkQueue();
+
+		void Push(const T & item);	// blocks while the queue is full
+		bool TryPush(const T & item);	// false right away if the queue is full
+		bool Pop(T & item);			// blocks while the queue is empty. Returns false once the queue is closed and drained
+		void Close();				// no more Push() calls after this.  Wakes up all consumers once the queue runs dry
+
+	private:
+		struct Cell
+		{
+			volatile LONG sequence;
+			T data;
+		};
+
+		bool TryEnqueue(const T & item);
+		bool TryDequeue(T & item);
+
+		Cell * m_buffer;
+		LONG m_mask;
+		volatile LONG m_enqueuePos;
+		volatile LONG m_dequeuePos;
+		volatile LONG m_closed;
+		HANDLE m_hItems;	// counts items ready to be popped
+		HANDLE m_hSlots;	// counts free cells in the ring
+
+		// not copyable
+		WorkQueue(const WorkQueue &);
+		WorkQueue & operator =(const WorkQueue &);
+};
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Constructor: the ring gets rounded up to a power of two, but no more than
+// 'capacity' items are ever queued
+///////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+WorkQueue<T>::WorkQueue(size_t capacity)
+{
+	if(capacity < 1)
+		capacity = 1;
+
+	size_t size = 2;
+	while(size < capacity)
+		size += size;
+
+	m_buffer = new Cell[size];
+	m_mask = (LONG) size - 1;
+
+	for(size_t i = 0; i < size; i++)
+		m_buffer[i].sequence = (LONG) i;
+
+	m_enqueuePos = 0;
+	m_dequeuePos = 0;
+	m_closed = 0;
+
+	m_hItems = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+	m_hSlots = CreateSemaphore(NULL, (LONG) capacity, (LONG) capacity, NULL);
+	assert(m_hItems != NULL && m_hSlots != NULL);
+}
+
+
+
+template <class T>
+WorkQueue<T>::~WorkQueue()
+{
+	CloseHandle(m_hItems);
+	CloseHandle(m_hSlots);
+	delete [] m_buffer;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Lock-free part.  A cell is free for the producer at position 'pos' when its
+// sequence == pos, and holds data for the consumer at 'pos' when sequence == pos+1
+///////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+bool WorkQueue<T>::TryEnqueue(const T & item)
+{
+	Cell * cell;
+	LONG pos = m_enqueuePos;
+
+	for(;;)
+	{
+		cell = &m_buffer[pos & m_mask];
+		LONG diff = cell->sequence - pos;
+
+		if(diff == 0)
+		{
+			if(InterlockedCompareExchange(&m_enqueuePos, pos + 1, pos) == pos)
+				break;
+		}
+		else if(diff < 0)
+		{
+			return false; // full
+		}
+
+		pos = m_enqueuePos;
+	}
+
+	cell->data = item;
+	InterlockedExchange(&cell->sequence, pos + 1); // publish
+
+	return true;
+}
+
+
+
+template <class T>
+bool WorkQueue<T>::TryDequeue(T & item)
+{
+	Cell * cell;
+	LONG pos = m_dequeuePos;
+
+	for(;;)
+	{
+		cell = &m_buffer[pos & m_mask];
+		LONG diff = cell->sequence - (pos + 1);
+
+		if(diff == 0)
+		{
+			if(InterlockedCompareExchange(&m_dequeuePos, pos + 1, pos) == pos)
+				break;
+		}
+		else if(diff < 0)
+		{
+			return false; // empty
+		}
+
+		pos = m_dequeuePos;
+	}
+
+	item = cell->data;
+	InterlockedExchange(&cell->sequence, pos + m_mask + 1); // hand the cell back to the producers
+
+	return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Blocking part
+///////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+void WorkQueue<T>::Push(const T & item)
+{
+	assert(!m_closed);
+
+	WaitForSingleObject(m_hSlots, INFINITE);
+
+	// A slot is guaranteed, but the consumer that freed it may not have released
+	// the cell at the head of the ring yet.  That window is a few instructions wide.
+	while(!TryEnqueue(item))
+		SwitchToThread();
+
+	ReleaseSemaphore(m_hItems, 1, NULL);
+}
+
+
+
+template <class T>
+bool WorkQueue<T>::TryPush(const T & item)
+{
+	assert(!m_closed);
+
+	if(WaitForSingleObject(m_hSlots, 0) != WAIT_OBJECT_0)
+		return false;
+
+	while(!TryEnqueue(item))
+		SwitchToThread();
+
+	ReleaseSemaphore(m_hItems, 1, NULL);
+	return true;
+}
+
+
+
+template <class T>
+bool WorkQueue<T>::Pop(T & item)
+{
+	WaitForSingleObject(m_hItems, INFINITE);
+
+	for(;;)
+	{
+		if(TryDequeue(item))
+		{
+			ReleaseSemaphore(m_hSlots, 1, NULL);
+			return true;
+		}
+
+		// Closed and drained: pass the wake up token on to the next sleeping consumer
+		if(m_closed && m_dequeuePos == m_enqueuePos)
+		{
+			ReleaseSemaphore(m_hItems, 1, NULL);
+			return false;
+		}
+
+		SwitchToThread();
+	}
+}
+
+
+
+template <class T>
+void WorkQueue<T>::Close()
+{
+	InterlockedExchange(&m_closed, 1);
+	ReleaseSemaphore(m_hItems, 1, NULL);
+}
+
+
+
+#endif // _WORK_QUEUE_H_
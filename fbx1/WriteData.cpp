@@ -6,6 +6,9 @@
 
 // sytem includes
 #include <assert.h>
+#include <algorithm> // copy
+#include <float.h>	// FLT_MAX
+#include <string.h>	// memset
 
 
 //
@@ -13,52 +16,127 @@
 //
 #include "WriteData.h"
 #include "Weld.h"
+#include "WeldSort.h"
+#include "Quantize.h"
+#include "MeshKernels.h"
+#include "WeldGrid.h"
+#include "VertexBuffer.h"
 
 
 
-///////////////////////////////////////////////////////////////////////////////////////
-// Hash definitions for data types used by the "WeldData" function
-///////////////////////////////////////////////////////////////////////////////////////
-namespace std
+////////////////////////////////////////////////////////////////////////////////////////
+// Point the triangles at the welded values.  The Int3's are just a flat array of ints
+// to the remap kernel
+////////////////////////////////////////////////////////////////////////////////////////
+void ReorderIndices(int originalArraySize, vector<Int3> *pIndexArray, const std::vector<size_t> & xrefs)
 {
-	template <> struct hash<Vec3>
-	{
-		size_t operator()(Vec3 v)
-		{
-			const unsigned int * h = (const unsigned int *)(&v);
-			unsigned int f = (h[0]+h[1]*11-(h[2]*17))&0x7fffffff;     // avoid problems with +-0
-			return (f>>22)^(f>>12)^(f);
-		}
-	};
+	if(originalArraySize > 0 && !xrefs.empty())
+		RemapIndices((*pIndexArray)[0].idxs, 3 * (size_t) originalArraySize, &xrefs[0]);
+}
 
-	template <> struct hash<TexCoord>
-	{
-		size_t operator()(TexCoord uv)
-		{
-			const unsigned int * h = (const unsigned int *)(&uv);
-			unsigned int f = (h[0]+h[1]*11)&0x7fffffff;     // avoid problems with +-0
-			return (f>>22)^(f>>12)^(f);
-		}
-	};
 
-	template <> struct hash<ColorRGBA>
-	{
-		size_t operator()(ColorRGBA v)
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Weld hashes of a whole array, all at once (see MeshKernels.h)
+////////////////////////////////////////////////////////////////////////////////////////
+static void HashValues(const SoAArray<Vec3> & values, vector<unsigned int> & hashes)
+{
+	hashes.resize(values.size());
+	HashVec3s(values.Lane(0), values.Lane(1), values.Lane(2), values.size(), &hashes[0]);
+}
+
+
+
+static void HashValues(const SoAArray<TexCoord> & values, vector<unsigned int> & hashes)
+{
+	hashes.resize(values.size());
+	HashTexCoords(values.Lane(0), values.Lane(1), values.size(), &hashes[0]);
+}
+
+
+
+static void HashValues(const SoAArray<ColorRGBA> & values, vector<unsigned int> & hashes)
+{
+	hashes.resize(values.size());
+	HashColors(values.Lane(0), values.Lane(1), values.Lane(2), values.Lane(3), values.size(), &hashes[0]);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Weld one list of values.  Large ones are split up by hash and welded on every thread,
+// huge ones sorted (same result, see WeldAuto)
+////////////////////////////////////////////////////////////////////////////////////////
+template <class T> static size_t WeldValues(SoAArray<T> & values, vector<size_t> & xrefs)
+{
+	vector<unsigned int> hashes;
+	HashValues(values, hashes);
+
+	return WeldAuto(values, xrefs, &hashes[0], std::equal_to<T>(), G_pTaskScheduler);
+}
+
+
+
+// Weld values within 'tolerance' of each other (see WeldGrid.h).  Only directions can go by angle
+static size_t WeldValuesWithin(SoAArray<Vec3> & values, vector<size_t> & xrefs, float tolerance, bool byAngle)
+{
+	if(byAngle)
+		return WeldWithin(values, xrefs, AngleMetric(tolerance));
+
+	return WeldWithin(values, xrefs, DistanceMetric<Vec3, 3>(tolerance));
+}
+
+static size_t WeldValuesWithin(SoAArray<TexCoord> & values, vector<size_t> & xrefs, float tolerance, bool)
+{
+	return WeldWithin(values, xrefs, DistanceMetric<TexCoord, 2>(tolerance));
+}
+
+static size_t WeldValuesWithin(SoAArray<ColorRGBA> & values, vector<size_t> & xrefs, float tolerance, bool)
+{
+	return WeldWithin(values, xrefs, DistanceMetric<ColorRGBA, 4>(tolerance));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CLASSES
+//
+// Welding of one vertex component (values and the triangle indices into them).  The
+// components don't share anything, so they all get welded at the same time
+////////////////////////////////////////////////////////////////////////////////////////
+template <class T>
+class ComponentWeldTask : public Task
+{
+	public:
+		ComponentWeldTask(SoAArray<T> *pValues, vector<Int3> *pIndices, bool weld, float tolerance, bool byAngle = false) :
+			m_pValues(pValues), m_pIndices(pIndices), m_weld(weld), m_tolerance(tolerance), m_byAngle(byAngle) {}
+
+		virtual void Run()
 		{
-			size_t h = 5381;
-			unsigned char r = (unsigned char) min(255.0f, ((v.r * 0.5f) * 255.0f));
-			unsigned char g = (unsigned char) min(255.0f, ((v.g * 0.5f) * 255.0f));
-			unsigned char b = (unsigned char) min(255.0f, ((v.b * 0.5f) * 255.0f));
-			unsigned char a = (unsigned char) min(255.0f, ((v.a * 0.5f) * 255.0f));
-
-			h = ((h << 5) + h) ^ r;
-			h = ((h << 5) + h) ^ g;
-			h = ((h << 5) + h) ^ b;
-			h = ((h << 5) + h) ^ a;
-			return h;
+			if(m_pValues->empty())
+			{
+				m_pIndices->clear();
+			}
+			else if(m_weld)
+			{
+				vector<size_t> xrefs;
+
+				if(m_tolerance > 0.0f)
+					WeldValuesWithin(*m_pValues, xrefs, m_tolerance, m_byAngle);
+				else
+					WeldValues(*m_pValues, xrefs);
+
+				ReorderIndices((int) m_pIndices->size(), m_pIndices, xrefs);
+			}
 		}
-	};
-}
+
+	private:
+		SoAArray<T> *m_pValues;
+		vector<Int3> *m_pIndices;
+		bool m_weld;		// false: values are unique already
+		float m_tolerance;	// 0: exact weld
+		bool m_byAngle;		// tolerance is an angle (directions)
+};
 
 
 
@@ -66,19 +144,36 @@ namespace std
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
-// Template for reordering index arrays
+// Copy 'src' to 'dst' starting at 'st', shifting every valid index by 'offset'
 ////////////////////////////////////////////////////////////////////////////////////////
-void ReorderIndices(int originalArraySize, vector<Int3> *pIndexArray, const std::vector<size_t> & xrefs)
+static void StitchIndices(vector<Int3> & dst, size_t st, const vector<Int3> & src, size_t offset)
 {
-	for(int i=0; i < originalArraySize; i++)
+	for(size_t i = 0; i < src.size(); i++)
 	{
 		for(int j=0; j < 3; j++)
 		{
-			if((*pIndexArray)[i].idxs[j] >= 0)
-				(*pIndexArray)[i].idxs[j] = xrefs[(*pIndexArray)[i].idxs[j]];
+			int idx = src[i].idxs[j];
+			dst[st + i].idxs[j] = idx >= 0 ? idx + (int) offset : idx;
 		}
 	}
+}
+
+
 
+template <class T> static void StitchValues(SoAArray<T> & dst, size_t st, const SoAArray<T> & src)
+{
+	dst.CopyFrom(st, src);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Round every component of the values from 'first' on, a lane at a time (see Quantize.h)
+////////////////////////////////////////////////////////////////////////////////////////
+template <class T> static void QuantizeValues(SoAArray<T> & values, size_t first, float precision)
+{
+	for(int k = 0; first < values.size() && k < SoAArray<T>::LANES; k++)
+		QuantizeFloats(values.Lane(k) + first, values.size() - first, precision);
 }
 
 
@@ -109,114 +204,216 @@ void WriteData::SetFilename(string input_filename)
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex coordinate into the vertex stl::vector structure
+// Helpers to push new vertex components into their lists.  Values are stored as they
+// are, whoever records them rounds them afterwards, a whole batch at once: see QuantizeFrom
 ///////////////////////////////////////////////////////////////////////////////////////////
 void WriteData::RecordVertCoord(FbxVector4 pValue)
 {
-	Vec3 vertCoord;
+	m_fileData.meshData.vPos.push_back( Vec3((float) pValue[0], (float) pValue[1], (float) pValue[2]) );
+}
 
-	// All values rounded to 1/10th of a millimeter (enough accuracy I believe - at the time of writing this comment)
-	// This will help with vertex welding later on (merging vertex positions that are 'close enough' to be considered the same)
 
-	vertCoord.x = IN_CutPrecision( (float) pValue[0] );
-	vertCoord.y = IN_CutPrecision( (float) pValue[1] );
-	vertCoord.z = IN_CutPrecision( (float) pValue[2] );
 
-	m_fileData.meshData.vPos.push_back(vertCoord);
+void WriteData::RecordVertColor(FbxColor pValue)
+{
+	m_fileData.meshData.vColor.push_back( ColorRGBA((float) pValue.mRed, (float) pValue.mGreen, (float) pValue.mBlue, (float) pValue.mAlpha) );
 }
 
 
 
+void WriteData::RecordVertTexCoord(FbxVector2 pValue)
+{
+	m_fileData.meshData.vTex.push_back( TexCoord((float) pValue[0], (float) pValue[1]) );
+}
 
-///////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex color into the color stl::vector structure
-///////////////////////////////////////////////////////////////////////////////////////////
-void WriteData::RecordVertColor(FbxColor pValue)
+
+
+void WriteData::RecordVertNormal(FbxVector4 pValue)
 {
-	ColorRGBA color;
+	m_fileData.meshData.vNorm.push_back( Vec3((float) pValue[0], (float) pValue[1], (float) pValue[2]) );
+}
+
 
-	color.r = IN_CutPrecision( (float) pValue.mRed );
-	color.g = IN_CutPrecision( (float) pValue.mGreen );
-	color.b = IN_CutPrecision( (float) pValue.mBlue );
-	color.a = IN_CutPrecision( (float) pValue.mAlpha );
 
-	m_fileData.meshData.vColor.push_back(color);
+void WriteData::RecordVertTangent(FbxVector4 pValue)
+{
+	m_fileData.meshData.vTang.push_back( Vec3((float) pValue[0], (float) pValue[1], (float) pValue[2]) );
 }
 
 
 
+void WriteData::RecordVertBinormal(FbxVector4 pValue)
+{
+	m_fileData.meshData.vBinorm.push_back( Vec3((float) pValue[0], (float) pValue[1], (float) pValue[2]) );
+}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex texture coordinate into the texCoord stl::vector structure
-////////////////////////////////////////////////////////////////////////////////////////////////////
-void WriteData::RecordVertTexCoord(FbxVector2 pValue)
+
+
+
+// A whole array of positions (i.e. a mesh's control points): converted and rounded in one pass.
+// Not rounded at all when positions are welded within a tolerance
+void WriteData::RecordVertCoords(const FbxVector4 *pValues, int cnt)
 {
-	TexCoord texC;
+	SoAArray<Vec3> & vPos = m_fileData.meshData.vPos;
+	size_t first = vPos.size();
 
-	texC.u = IN_CutPrecision( (float) pValue[0] );
-	texC.v = IN_CutPrecision( (float) pValue[1] );
+	if(G_tolerance.pos > 0.0f)
+	{
+		for(int i = 0; i < cnt; i++)
+			RecordVertCoord(pValues[i]);
+		return;
+	}
 
-	m_fileData.meshData.vTex.push_back(texC);
+	vPos.resize(first + cnt);
+	QuantizeVector4s((const double *) pValues, cnt, vPos.Lane(0) + first, vPos.Lane(1) + first, vPos.Lane(2) + first, G_precision.pos);
 }
 
 
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex normal into the normal stl::vector structure
+// Round the values recorded since 'from' (sizes taken before recording them).  Every
+// value has to be rounded exactly once: rounding twice can move it down another step.
+// Rounding makes values that are 'close enough' identical, which is what lets vertex
+// welding merge them later on.  Precision per kind of value: see G_precision
 ///////////////////////////////////////////////////////////////////////////////////////////
-void WriteData::RecordVertNormal(FbxVector4 pValue)
+void WriteData::QuantizeFrom(const MeshDataSizes & from)
 {
-	Vec3 vertNorm;
-
-	// All values rounded to 1/10th of a millimeter (enough accuracy I believe - at the time of writing this comment)
-	// This will help with vertex welding later on (merging vertex positions that are 'close enough' to be considered the same)
-
-	vertNorm.x = IN_CutPrecision( (float) pValue[0] );
-	vertNorm.y = IN_CutPrecision( (float) pValue[1] );
-	vertNorm.z = IN_CutPrecision( (float) pValue[2] );
+	MeshData *pData = &m_fileData.meshData;
 
-	m_fileData.meshData.vNorm.push_back(vertNorm);
+	// values welded within a tolerance are kept as they are (see WeldGrid.h)
+	if(G_tolerance.pos <= 0.0f)	QuantizeValues(pData->vPos, from.pos, G_precision.pos);
+	if(G_tolerance.col <= 0.0f)	QuantizeValues(pData->vColor, from.color, G_precision.col);
+	if(G_tolerance.tex <= 0.0f)	QuantizeValues(pData->vTex, from.tex, G_precision.tex);
+	if(G_tolerance.nrm <= 0.0f)	QuantizeValues(pData->vNorm, from.norm, G_precision.nrm);
+	if(G_tolerance.tan <= 0.0f)	QuantizeValues(pData->vTang, from.tang, G_precision.tan);
+	if(G_tolerance.bin <= 0.0f)	QuantizeValues(pData->vBinorm, from.binorm, G_precision.bin);
 }
 
 
 
 
+
 ///////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex tangent into the tangent stl::vector structure
+// Append the data of one mesh, extracted on its own (i.e. by a MeshTask).  Its indices
+// start at 0, so they get shifted past the data we already have.  Materials used by
+// the mesh's triangles are flagged here, the mesh's materials were recorded in our
+// list before it was extracted
 ///////////////////////////////////////////////////////////////////////////////////////////
-void WriteData::RecordVertTangent(FbxVector4 pValue)
+void WriteData::AppendMeshData(const MeshData & mesh)
 {
-	Vec3 vertTang;
+	MeshDataSizes at, sizes;
+
+	GetMeshDataSizes(m_fileData.meshData, at);
+	GetMeshDataSizes(mesh, sizes);
+	AddMeshDataSizes(sizes, at);
 
-	// All values rounded to 1/10th of a millimeter (enough accuracy I believe - at the time of writing this comment)
-	// This will help with vertex welding later on (merging vertex positions that are 'close enough' to be considered the same)
+	ResizeMeshData(m_fileData.meshData, sizes);
+	StitchMeshData(m_fileData.meshData, mesh, at);
 
-	vertTang.x = IN_CutPrecision( (float) pValue[0] );
-	vertTang.y = IN_CutPrecision( (float) pValue[1] );
-	vertTang.z = IN_CutPrecision( (float) pValue[2] );
+	const vector<int> & matIds = mesh.tris.iMat.GetIds();
 
-	m_fileData.meshData.vTang.push_back(vertTang);
+	for(size_t i = 0; i < matIds.size(); i++)
+		SetMaterialAsUsed(matIds[i]); // I keep track of used materials so I can get rid of non-used ones
 }
 
 
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
-// Helper function to push a new vertex binormal into the binormal stl::vector structure
+// Mesh data stitching helpers
 ///////////////////////////////////////////////////////////////////////////////////////////
-void WriteData::RecordVertBinormal(FbxVector4 pValue)
+void WriteData::GetMeshDataSizes(const MeshData & mesh, MeshDataSizes & sizes)
+{
+	sizes.pos = mesh.vPos.size();
+	sizes.norm = mesh.vNorm.size();
+	sizes.tex = mesh.vTex.size();
+	sizes.color = mesh.vColor.size();
+	sizes.binorm = mesh.vBinorm.size();
+	sizes.tang = mesh.vTang.size();
+	sizes.tris = mesh.tris.iPos.size();
+	sizes.mats = mesh.tris.iMat.GetIdCount();
+	sizes.matStride = mesh.tris.iMat.GetStride();
+}
+
+
+
+void WriteData::AddMeshDataSizes(MeshDataSizes & sum, const MeshDataSizes & sizes)
 {
-	Vec3 vertBiNorm;
+	sum.pos += sizes.pos;
+	sum.norm += sizes.norm;
+	sum.tex += sizes.tex;
+	sum.color += sizes.color;
+	sum.binorm += sizes.binorm;
+	sum.tang += sizes.tang;
+	sum.mats += sizes.mats;
+
+	// empty pieces don't have a say in the stride
+	if(sum.tris == 0)
+		sum.matStride = sizes.matStride;
+	else if(sizes.tris > 0 && sizes.matStride != sum.matStride)
+		sum.matStride = MATLISTS_MIXED;
+
+	sum.tris += sizes.tris;
+}
+
+
+
+void WriteData::ResizeMeshData(MeshData & mesh, const MeshDataSizes & sizes)
+{
+	mesh.vPos.resize(sizes.pos);
+	mesh.vNorm.resize(sizes.norm);
+	mesh.vTex.resize(sizes.tex);
+	mesh.vColor.resize(sizes.color);
+	mesh.vBinorm.resize(sizes.binorm);
+	mesh.vTang.resize(sizes.tang);
+
+	// all triangle lists run in parallel
+	mesh.tris.iPos.resize(sizes.tris);
+	mesh.tris.iNrm.resize(sizes.tris);
+	mesh.tris.iTex.resize(sizes.tris);
+	mesh.tris.iCol.resize(sizes.tris);
+	mesh.tris.iBin.resize(sizes.tris);
+	mesh.tris.iTan.resize(sizes.tris);
+	mesh.tris.iMat.Resize(sizes.tris, sizes.mats, sizes.matStride);
+}
 
-	// All values rounded to 1/10th of a millimeter (enough accuracy I believe - at the time of writing this comment)
-	// This will help with vertex welding later on (merging vertex positions that are 'close enough' to be considered the same)
 
-	vertBiNorm.x = IN_CutPrecision( (float) pValue[0] );
-	vertBiNorm.y = IN_CutPrecision( (float) pValue[1] );
-	vertBiNorm.z = IN_CutPrecision( (float) pValue[2] );
 
-	m_fileData.meshData.vBinorm.push_back(vertBiNorm);
+///////////////////////////////////////////////////////////////////////////////////////////
+// Copy 'src' into 'dst' (already sized to hold it) at 'at'.  Indices in 'src' start at
+// 0, they get shifted to point past whatever comes before 'at'
+///////////////////////////////////////////////////////////////////////////////////////////
+void WriteData::StitchMeshData(MeshData & dst, const MeshData & src, const MeshDataSizes & at)
+{
+	StitchValues(dst.vPos, at.pos, src.vPos);
+	StitchValues(dst.vNorm, at.norm, src.vNorm);
+	StitchValues(dst.vTex, at.tex, src.vTex);
+	StitchValues(dst.vColor, at.color, src.vColor);
+	StitchValues(dst.vBinorm, at.binorm, src.vBinorm);
+	StitchValues(dst.vTang, at.tang, src.vTang);
+
+	StitchIndices(dst.tris.iPos, at.tris, src.tris.iPos, at.pos);
+	StitchIndices(dst.tris.iNrm, at.tris, src.tris.iNrm, at.norm);
+	StitchIndices(dst.tris.iTex, at.tris, src.tris.iTex, at.tex);
+	StitchIndices(dst.tris.iCol, at.tris, src.tris.iCol, at.color);
+	StitchIndices(dst.tris.iBin, at.tris, src.tris.iBin, at.binorm);
+	StitchIndices(dst.tris.iTan, at.tris, src.tris.iTan, at.tang);
+	dst.tris.iMat.Stitch(at.tris, at.mats, src.tris.iMat);
+
+	dst.m_usingFields.vpos |= src.m_usingFields.vpos;
+	dst.m_usingFields.vnorm |= src.m_usingFields.vnorm;
+	dst.m_usingFields.vbinormal |= src.m_usingFields.vbinormal;
+	dst.m_usingFields.vtangent |= src.m_usingFields.vtangent;
+	dst.m_usingFields.vcolor |= src.m_usingFields.vcolor;
+	dst.m_usingFields.vtexCoord |= src.m_usingFields.vtexCoord;
+
+	dst.m_perCorner.vpos |= src.m_perCorner.vpos;
+	dst.m_perCorner.vnorm |= src.m_perCorner.vnorm;
+	dst.m_perCorner.vbinormal |= src.m_perCorner.vbinormal;
+	dst.m_perCorner.vtangent |= src.m_perCorner.vtangent;
+	dst.m_perCorner.vcolor |= src.m_perCorner.vcolor;
+	dst.m_perCorner.vtexCoord |= src.m_perCorner.vtexCoord;
 }
 
 
@@ -231,87 +428,46 @@ void WriteData::WeldData()
 {
 	MeshData *pData = &m_fileData.meshData;
 	TriList *pIndices = &m_fileData.meshData.tris;
-	int num = 0;
-	int compCnt = 0;
-	vector<size_t> xrefs;
+	TaskGroup group(G_pTaskScheduler);
+
+	// values recorded per control point only are unique already.  Unless there's a tolerance: then they
+	// weren't rounded either, and values a hair apart (the cracks between meshes) still need merging
+	ComponentWeldTask<Vec3> pos(&pData->vPos, &pIndices->iPos, pData->m_perCorner.vpos != 0 || G_tolerance.pos > 0.0f, G_tolerance.pos);
+	ComponentWeldTask<ColorRGBA> color(&pData->vColor, &pIndices->iCol, pData->m_perCorner.vcolor != 0 || G_tolerance.col > 0.0f, G_tolerance.col);
+	ComponentWeldTask<TexCoord> tex(&pData->vTex, &pIndices->iTex, pData->m_perCorner.vtexCoord != 0 || G_tolerance.tex > 0.0f, G_tolerance.tex);
+	ComponentWeldTask<Vec3> norm(&pData->vNorm, &pIndices->iNrm, true, G_tolerance.nrm, true);
+	ComponentWeldTask<Vec3> tang(&pData->vTang, &pIndices->iTan, true, G_tolerance.tan, true);
+	ComponentWeldTask<Vec3> binorm(&pData->vBinorm, &pIndices->iBin, true, G_tolerance.bin, true);
+
+	group.Run(&pos);
+	group.Run(&color);
+	group.Run(&tex);
+	group.Run(&norm);
+	group.Run(&tang);
+	group.Run(&binorm);
+
+	group.Wait();
+
+	// Bounding box of what's left
+	float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	ComputeBounds(pData->vPos.Lane(0), pData->vPos.Lane(1), pData->vPos.Lane(2), pData->vPos.size(), bbMin, bbMax);
+
+	pData->bbMin = Vec3(bbMin[0], bbMin[1], bbMin[2]);
+	pData->bbMax = Vec3(bbMax[0], bbMax[1], bbMax[2]);
+}
 
-	// Remove POSITION duplicates
-	if(pData->vPos.size() > 0)
-	{
-		num = Weld( pData->vPos, xrefs, std::hash<Vec3>(), std::equal_to<Vec3>() );
-		compCnt = pIndices->iPos.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iPos, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iPos.clear();
-	}
 
-	// Remove COLOR duplicates
-	if(pData->vColor.size() > 0)
-	{
-		num = Weld( pData->vColor, xrefs, std::hash<ColorRGBA>(), std::equal_to<ColorRGBA>() );
-		compCnt = pIndices->iCol.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iCol, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iCol.clear();
-	}
 
-	// Remove TEXTURE COORDINATE duplicates
-	if(pData->vTex.size() > 0)
-	{
-		num = Weld( pData->vTex, xrefs, std::hash<TexCoord>(), std::equal_to<TexCoord>() );
-		compCnt = pIndices->iTex.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iTex, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iTex.clear();
-	}
 
-	// Remove NORMAL duplicates
-	if(pData->vNorm.size() > 0)
-	{
-		num = Weld( pData->vNorm, xrefs, std::hash<Vec3>(), std::equal_to<Vec3>() );
-		compCnt = pIndices->iNrm.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iNrm, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iNrm.clear();
-	}
-
-	// Remove TANGENT duplicates
-	if(pData->vTang.size() > 0)
-	{
-		num = Weld( pData->vTang, xrefs, std::hash<Vec3>(), std::equal_to<Vec3>() );
-		compCnt = pIndices->iTan.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iTan, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iTan.clear();
-	}
 
-	// Remove BINORMAL duplicates
-	if(pData->vBinorm.size() > 0)
-	{
-		num = Weld( pData->vBinorm, xrefs, std::hash<Vec3>(), std::equal_to<Vec3>() );
-		compCnt = pIndices->iBin.size(); // number of items in this component
-		ReorderIndices(compCnt, &pIndices->iBin, xrefs);
-		xrefs.clear();
-	}
-	else
-	{
-		pIndices->iBin.clear();
-	}
+///////////////////////////////////////////////////////////////////////////////////////////
+// Vertices and index list for the GPU, from the welded data
+///////////////////////////////////////////////////////////////////////////////////////////
+void WriteData::BuildVertexBuffer()
+{
+	::BuildVertexBuffer(m_fileData.meshData, G_pTaskScheduler);
 }
 
 
@@ -337,3 +493,248 @@ void WriteData::SetMaterialAsUsed(int materialIndex)
 
 	m_fileData.materials[materialIndex].used = true;
 }
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// SAVE
+// Everything goes in as fixed size records and flat arrays, references by index or
+// string offset (see ResFormat.h).  Each part goes to disk as soon as it's final, and
+// is freed right after: the whole file never has to be in memory twice
+///////////////////////////////////////////////////////////////////////////////////////////
+#define SAVE_BLOCK_ELEMENTS	4096	// values converted for writing at a time
+
+static void CopyColor(float *pDst, const ColorRGBA & c)
+{
+	pDst[0] = c.r; pDst[1] = c.g; pDst[2] = c.b; pDst[3] = c.a;
+}
+
+
+
+// frees the memory too, unlike clear()
+template <class T> static void Release(T & container)
+{
+	T().swap(container);
+}
+
+
+
+// welded values as an array of structures: x, y, z, x, y, z, ...  Converted a block at a time
+template <class T> static void AddValuesSection(ResWriter & writer, ResSectionType type, const SoAArray<T> & values)
+{
+	const int lanes = SoAArray<T>::LANES;
+	float block[SAVE_BLOCK_ELEMENTS * lanes];
+
+	if(values.empty() || !writer.BeginSection(type, lanes * sizeof(float)))
+		return;
+
+	for(size_t first = 0; first < values.size(); first += SAVE_BLOCK_ELEMENTS)
+	{
+		size_t cnt = min(values.size() - first, (size_t) SAVE_BLOCK_ELEMENTS);
+
+		for(int k = 0; k < lanes; k++)
+		{
+			const float *pLane = values.Lane(k) + first;
+			for(size_t i = 0; i < cnt; i++)
+				block[i * lanes + k] = pLane[i];
+		}
+
+		writer.WriteSection(block, cnt);
+	}
+
+	writer.EndSection();
+}
+
+
+
+static void AddMaterialSections(ResWriter & writer, const FileData & fileData)
+{
+	vector<ResMaterial> materials(fileData.materials.size());
+	vector<unsigned int> materialTextures;
+
+	for(size_t i = 0; i < materials.size(); i++)
+	{
+		const MaterialData & src = fileData.materials[i];
+		ResMaterial & dst = materials[i];
+
+		memset(&dst, 0, sizeof(dst));
+		dst.name = writer.AddString(src.name);
+		dst.shadingModel = (unsigned int) src.shadingModel;
+		CopyColor(dst.ambient, src.ambient);
+		CopyColor(dst.diffuse, src.diffuse);
+		CopyColor(dst.specular, src.specular);
+		CopyColor(dst.emissive, src.emissive);
+		dst.opacity = src.opacity;
+		dst.shininess = src.shininess;
+		dst.reflectivity = src.reflectivity;
+
+		dst.firstTexture = (unsigned int) materialTextures.size();
+		for(size_t j = 0; j < src.textureIdx.size(); j++)
+			materialTextures.push_back((unsigned int) src.textureIdx[j]);
+		dst.textureCount = (unsigned int) materialTextures.size() - dst.firstTexture;
+	}
+
+	vector<ResTexture> textures(fileData.textures.size());
+
+	for(size_t i = 0; i < textures.size(); i++)
+	{
+		const TextureData & src = fileData.textures[i];
+		ResTexture & dst = textures[i];
+
+		memset(&dst, 0, sizeof(dst));
+		dst.name = writer.AddString(src.name);
+		dst.filename = writer.AddString(src.filename);
+		dst.alphaSource = (unsigned int) src.alphaSource;
+		dst.mappingType = (unsigned int) src.mappingType;
+		dst.planarNormals = (unsigned int) src.planarNormals;
+		dst.blendMode = (unsigned int) src.blendMode;
+		dst.usedFor = (unsigned int) src.usedFor;
+		dst.flags = (src.isProcedural ? RES_TEXTURE_PROCEDURAL : 0) | (src.isLayered ? RES_TEXTURE_LAYERED : 0) |
+					(src.usesDefaultMaterial ? RES_TEXTURE_DEFAULT_MATERIAL : 0) | (src.swapUV ? RES_TEXTURE_SWAP_UV : 0);
+		dst.scaleU = src.scaleU; dst.scaleV = src.scaleV;
+		dst.translateU = src.translateU; dst.translateV = src.translateV;
+		dst.rotateU = src.rotateU; dst.rotateV = src.rotateV; dst.rotateW = src.rotateW;
+		dst.cropLeft = src.cropLeft; dst.cropTop = src.cropTop; dst.cropRight = src.cropRight; dst.cropBottom = src.cropBottom;
+		dst.defaultAlpha = src.defaultAlpha;
+	}
+
+	writer.AddSection(RES_SECTION_MATERIALS, materials);
+	writer.AddSection(RES_SECTION_MATERIAL_TEXTURES, materialTextures);
+	writer.AddSection(RES_SECTION_TEXTURES, textures);
+}
+
+
+
+static void AddLightSection(ResWriter & writer, const FileData & fileData)
+{
+	vector<ResLight> lights(fileData.lights.size());
+
+	for(size_t i = 0; i < lights.size(); i++)
+	{
+		const LightData & src = fileData.lights[i];
+		ResLight & dst = lights[i];
+
+		memset(&dst, 0, sizeof(dst));
+		dst.name = writer.AddString(src.name);
+		dst.type = (unsigned int) src.type;
+		dst.flags = (src.isCastLight ? RES_LIGHT_CAST : 0) | (src.isGobo ? RES_LIGHT_GOBO : 0);
+		if(src.isGobo)
+		{
+			dst.flags |= (src.gobo.doesProjectToGround ? RES_LIGHT_GOBO_TO_GROUND : 0) | (src.gobo.isVolumetricProjection ? RES_LIGHT_GOBO_VOLUMETRIC : 0) |
+						(src.gobo.isFrontVolumetricProjection ? RES_LIGHT_GOBO_FRONT_VOLUMETRIC : 0);
+		}
+		dst.goboFilename = writer.AddString(src.isGobo ? src.gobo.filename : string());
+		CopyColor(dst.color, src.color);
+		dst.intensity = src.intensity;
+		dst.outerAngle = src.outerAngle;
+		dst.fog = src.fog;
+	}
+
+	writer.AddSection(RES_SECTION_LIGHTS, lights);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Start the .res file.  Parts are saved by the calls below as they become final, then
+// CloseOutput finishes the file.  If it can't be created the parts are still freed
+///////////////////////////////////////////////////////////////////////////////////////////
+// the big arrays get compressed if asked; the records stay as they are, to be used in place
+bool WriteData::OpenOutput()
+{
+	static const ResSectionType arrays[] = {	RES_SECTION_VERTICES, RES_SECTION_INDICES, RES_SECTION_POSITIONS, RES_SECTION_NORMALS,
+												RES_SECTION_TEXCOORDS, RES_SECTION_COLORS, RES_SECTION_TANGENTS, RES_SECTION_BINORMALS,
+												RES_SECTION_POSITION_INDICES, RES_SECTION_TRIANGLE_MATERIALS, RES_SECTION_TRIANGLE_MATERIAL_OFFSETS };
+
+	for(size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+		m_resWriter.SetCodec(arrays[i], G_resCodec);
+
+	m_resWriter.SetScheduler(G_pTaskScheduler);
+
+	return m_resWriter.Open(m_outputFilename, G_pAsyncWriter);
+}
+
+
+
+// after ProcessMaterials::DeleteUnused: nothing changes the materials, textures or lights after that
+void WriteData::SaveMaterials()
+{
+	AddMaterialSections(m_resWriter, m_fileData);
+	AddLightSection(m_resWriter, m_fileData);
+
+	Release(m_fileData.materials);
+	Release(m_fileData.textures);
+	Release(m_fileData.lights);
+}
+
+
+
+// after BuildVertexBuffer.  Each array is freed as soon as it's written
+void WriteData::SaveMesh()
+{
+	MeshData & mesh = m_fileData.meshData;
+	VertexBuffer & vb = mesh.vb;
+	TriList & tris = mesh.tris;
+	bool hasPositions = !mesh.vPos.empty();
+	ResScene scene;
+
+	memset(&scene, 0, sizeof(scene));
+	if(hasPositions)
+	{
+		scene.bbMin[0] = mesh.bbMin.x; scene.bbMin[1] = mesh.bbMin.y; scene.bbMin[2] = mesh.bbMin.z;
+		scene.bbMax[0] = mesh.bbMax.x; scene.bbMax[1] = mesh.bbMax.y; scene.bbMax[2] = mesh.bbMax.z;
+	}
+
+	CopyColor(scene.ambient, m_fileData.globals.ambient);
+
+	scene.vertexCount = vb.stride ? (unsigned int) (vb.vertices.size() / vb.stride) : 0;
+	scene.vertexStride = vb.stride * sizeof(float);
+	for(int k = 0; k < RES_VERTEX_COMPONENTS; k++)
+		scene.vertexOffsets[k] = vb.offsets[k] >= 0 ? vb.offsets[k] * (int) sizeof(float) : RES_NO_OFFSET;
+
+	scene.triangleCount = (unsigned int) tris.iPos.size();
+	scene.materialStride = tris.iMat.GetStride() == MATLISTS_MIXED ? RES_MATERIALS_MIXED : tris.iMat.GetStride();
+
+	m_resWriter.AddSection(RES_SECTION_SCENE, &scene, sizeof(scene), 1);
+
+	m_resWriter.AddSection(RES_SECTION_VERTICES, vb.vertices.empty() ? NULL : &vb.vertices[0], scene.vertexStride, scene.vertexCount);
+	Release(vb.vertices);
+	m_resWriter.AddSection(RES_SECTION_INDICES, vb.indices);
+	Release(vb.indices);
+
+	AddValuesSection(m_resWriter, RES_SECTION_POSITIONS, mesh.vPos);
+	Release(mesh.vPos);
+	AddValuesSection(m_resWriter, RES_SECTION_NORMALS, mesh.vNorm);
+	Release(mesh.vNorm);
+	AddValuesSection(m_resWriter, RES_SECTION_TEXCOORDS, mesh.vTex);
+	Release(mesh.vTex);
+	AddValuesSection(m_resWriter, RES_SECTION_COLORS, mesh.vColor);
+	Release(mesh.vColor);
+	AddValuesSection(m_resWriter, RES_SECTION_TANGENTS, mesh.vTang);
+	Release(mesh.vTang);
+	AddValuesSection(m_resWriter, RES_SECTION_BINORMALS, mesh.vBinorm);
+	Release(mesh.vBinorm);
+
+	if(hasPositions)
+		m_resWriter.AddSection(RES_SECTION_POSITION_INDICES, tris.iPos.empty() ? NULL : tris.iPos[0].idxs, sizeof(int), 3 * tris.iPos.size());
+
+	m_resWriter.AddSection(RES_SECTION_TRIANGLE_MATERIALS, tris.iMat.GetIds());
+	m_resWriter.AddSection(RES_SECTION_TRIANGLE_MATERIAL_OFFSETS, tris.iMat.GetOffsets());
+
+	Release(tris.iPos);
+	Release(tris.iNrm);
+	Release(tris.iTex);
+	Release(tris.iCol);
+	Release(tris.iBin);
+	Release(tris.iTan);
+	Release(tris.iMat);
+}
+
+
+
+bool WriteData::CloseOutput()
+{
+	return m_resWriter.Finish();
+}
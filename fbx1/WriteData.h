@@ -24,6 +24,22 @@
 // Project headers
 //
 #include "DataTypes.h"
+#include "ResWriter.h"
+
+
+
+///////////////////////////////////////////////////////
+// STRUCTS
+///////////////////////////////////////////////////////
+
+// element count of every list in a MeshData. Also used as the spot a piece of mesh data lands at when stitched into a bigger one
+struct MeshDataSizes
+{
+	size_t pos, norm, tex, color, binorm, tang;
+	size_t tris;
+	size_t mats;	// material ids of all the triangles
+	int matStride;	// materials per triangle, MATLISTS_MIXED if the triangles don't agree
+};
 
 
 
@@ -39,6 +55,13 @@ class WriteData
 		WriteData();
 		void SetFilename(string input_filename);
 		void WeldData(); // remove duplicates from data lists and fix indices
+		void BuildVertexBuffer(); // after WeldData: one index per triangle corner, into vertices holding every component (see VertexBuffer.h)
+		bool OpenOutput(); // start the .res file (see ResFormat.h).  Then each part gets saved, and freed, as soon as it's final:
+		void SaveMaterials(); // materials, textures and lights, after ProcessMaterials::DeleteUnused
+		void SaveMesh(); // everything else, after BuildVertexBuffer
+		bool CloseOutput(); // finish the file.  Written behind by G_pAsyncWriter if there is one: true = all queued
+		const string & GetOutputFilename() const { return m_outputFilename; }
+		void QuantizeFrom(const MeshDataSizes & from); // round everything recorded since 'from' (GetMeshDataSizes before recording)
 
 		///////////////////////////////////////////////
 		// Functions for recording vertex components
@@ -48,6 +71,7 @@ class WriteData
 		void RecordVertNormal(FbxVector4 pValue);
 		void RecordVertTangent(FbxVector4 pValue);
 		void RecordVertBinormal(FbxVector4 pValue);
+		void RecordVertCoords(const FbxVector4 *pValues, int cnt); // rounded right away
 
 		///////////////////////////////////////////////
 		// Functions for getting current component index
@@ -66,7 +90,20 @@ class WriteData
 		void AddNormTriIdxs(Int3 & arg) { m_fileData.meshData.tris.iNrm.push_back( arg ); }
 		void AddTangTriIdxs(Int3 & arg) { m_fileData.meshData.tris.iTan.push_back( arg ); }
 		void AddBinormTriIdxs(Int3 & arg) { m_fileData.meshData.tris.iBin.push_back( arg ); }
-		void AddMaterialIdx(MatList & arg) { m_fileData.meshData.tris.iMat.push_back( arg ); }
+		void AddMaterialIdx(const int *pIds, int cnt) { m_fileData.meshData.tris.iMat.Add( pIds, cnt ); }
+
+		///////////////////////////////////////////////
+		// Append a mesh extracted into its own WriteData (indices starting at 0)
+		void AppendMeshData(const MeshData & mesh);
+
+		///////////////////////////////////////////////
+		// Stitching pieces of mesh data together: size the destination for all the pieces
+		// first, then copy every piece to its spot (a running sum of the sizes before it).
+		// Copies to different spots can run on different threads
+		static void GetMeshDataSizes(const MeshData & mesh, MeshDataSizes & sizes);
+		static void AddMeshDataSizes(MeshDataSizes & sum, const MeshDataSizes & sizes);
+		static void ResizeMeshData(MeshData & mesh, const MeshDataSizes & sizes);
+		static void StitchMeshData(MeshData & dst, const MeshData & src, const MeshDataSizes & at);
 
 		////////////////////////////////////////////////
 		// For material, texture, light, etc data access
@@ -79,6 +116,7 @@ class WriteData
 	private:
 		FileData m_fileData;
 		string m_outputFilename;
+		ResWriter m_resWriter;
 };
 
 
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////
+// XXHASH64.H
+//
+// xxHash64, the 64 bit hash from the xxHash
+// family (Yann Collet, BSD license), small
+// enough to keep in the tree.  Same values as
+// the reference XXH64: files hashed here check
+// against any other implementation.
+// Fast (several GB/s), for catching damaged
+// data, not for security.
+// Hash a block in one go with XXHash64::Hash,
+// or a piece at a time: Reset, Update as many
+// times as needed, then Digest.
+////////////////////////////////////////////////
+
+
+#ifndef _XXHASH64_H_
+#define _XXHASH64_H_
+
+
+
+/*----------------------------------------------------------------------------
+	Headers
+----------------------------------------------------------------------------*/
+
+#include <string.h>		// memcpy
+
+
+
+
+/*----------------------------------------------------------------------------
+	Defines:
+----------------------------------------------------------------------------*/
+
+#define XXH64_PRIME1		0x9E3779B185EBCA87ULL
+#define XXH64_PRIME2		0xC2B2AE3D27D4EB4FULL
+#define XXH64_PRIME3		0x165667B19E3779F9ULL
+#define XXH64_PRIME4		0x85EBCA77C2B2AE63ULL
+#define XXH64_PRIME5		0x27D4EB2F165667C5ULL
+#define XXH64_STRIPE		32		// bytes taken in by each round of the 4 accumulators
+
+
+
+
+/*----------------------------------------------------------------------------
+	Classes:
+----------------------------------------------------------------------------*/
+
+class XXHash64
+{
+	public:
+		typedef unsigned long long Value;
+
+		XXHash64(Value seed = 0) { Reset(seed); }
+
+		void Reset(Value seed = 0)
+		{
+			m_acc[0] = seed + XXH64_PRIME1 + XXH64_PRIME2;
+			m_acc[1] = seed + XXH64_PRIME2;
+			m_acc[2] = seed;
+			m_acc[3] = seed - XXH64_PRIME1;
+			m_seed = seed;
+			m_totalSize = 0;
+			m_bufferSize = 0;
+		}
+
+		void Update(const void *pData, size_t size)
+		{
+			if(size == 0)
+				return;
+
+			const unsigned char *p = (const unsigned char *) pData;
+			m_totalSize += size;
+
+			// top up what's left from last time first
+			if(m_bufferSize)
+			{
+				size_t cnt = XXH64_STRIPE - m_bufferSize;
+				cnt = cnt < size ? cnt : size;
+
+				memcpy(m_buffer + m_bufferSize, p, cnt);
+				m_bufferSize += cnt;
+				p += cnt;
+				size -= cnt;
+
+				if(m_bufferSize < XXH64_STRIPE)
+					return;
+
+				Stripe(m_buffer);
+				m_bufferSize = 0;
+			}
+
+			for(; size >= XXH64_STRIPE; p += XXH64_STRIPE, size -= XXH64_STRIPE)
+				Stripe(p);
+
+			if(size)
+			{
+				memcpy(m_buffer, p, size);
+				m_bufferSize = size;
+			}
+		}
+
+		Value Digest() const
+		{
+			Value h;
+
+			if(m_totalSize >= XXH64_STRIPE)
+			{
+				h = Rotate(m_acc[0], 1) + Rotate(m_acc[1], 7) + Rotate(m_acc[2], 12) + Rotate(m_acc[3], 18);
+				for(int k = 0; k < 4; k++)
+					h = (h ^ Round(0, m_acc[k])) * XXH64_PRIME1 + XXH64_PRIME4;
+			}
+			else
+				h = m_seed + XXH64_PRIME5;
+
+			h += m_totalSize;
+
+			// the tail: 8, then 4, then 1 byte at a time
+			const unsigned char *p = m_buffer;
+			const unsigned char *pEnd = m_buffer + m_bufferSize;
+
+			for(; p + 8 <= pEnd; p += 8)
+				h = Rotate(h ^ Round(0, Read64(p)), 27) * XXH64_PRIME1 + XXH64_PRIME4;
+
+			if(p + 4 <= pEnd)
+			{
+				h = Rotate(h ^ (Read32(p) * XXH64_PRIME1), 23) * XXH64_PRIME2 + XXH64_PRIME3;
+				p += 4;
+			}
+
+			for(; p < pEnd; p++)
+				h = Rotate(h ^ (*p * XXH64_PRIME5), 11) * XXH64_PRIME1;
+
+			// mix the last bits through
+			h ^= h >> 33;
+			h *= XXH64_PRIME2;
+			h ^= h >> 29;
+			h *= XXH64_PRIME3;
+			h ^= h >> 32;
+
+			return h;
+		}
+
+		static Value Hash(const void *pData, size_t size, Value seed = 0)
+		{
+			XXHash64 hash(seed);
+			hash.Update(pData, size);
+			return hash.Digest();
+		}
+
+	private:
+		Value m_acc[4];
+		Value m_seed;
+		Value m_totalSize;
+		unsigned char m_buffer[XXH64_STRIPE];	// bytes short of a whole stripe
+		size_t m_bufferSize;
+
+		static Value Rotate(Value v, int bits) { return (v << bits) | (v >> (64 - bits)); }
+		static Value Round(Value acc, Value input) { return Rotate(acc + input * XXH64_PRIME2, 31) * XXH64_PRIME1; }
+
+		// little endian, like the .res files
+		static Value Read64(const unsigned char *p) { Value v; memcpy(&v, p, sizeof(v)); return v; }
+		static Value Read32(const unsigned char *p) { unsigned int v; memcpy(&v, p, sizeof(v)); return v; }
+
+		void Stripe(const unsigned char *p)
+		{
+			for(int k = 0; k < 4; k++)
+				m_acc[k] = Round(m_acc[k], Read64(p + 8 * k));
+		}
+};
+
+
+
+#endif // _XXHASH64_H_
@@ -12,19 +12,16 @@
 //////////////////////////////////////////
 #include "common.h"	// Basic FBX init stuff and includes
 #include <string>	// std library
-
-
-
-//////////////////////////////////////////
-// DEFINES
-//////////////////////////////////////////
-#define MAX_FILE_COUNT	128
+#include "Log.h"	// LOG_* macros, everybody reports through them
 
 
 
 /////////////////////////////////////////////////
 // STRUCTS
 /////////////////////////////////////////////////
+class ProcessContent;
+
+
 struct FbxLib
 {
     FbxManager* lSdkManager;
@@ -37,13 +34,17 @@ struct FbxLibAndFilename
 {
 	FbxLib *pFbxLib;
 	std::string fileName;
+	unsigned __int64 fileSize;	// bytes on disk, used to estimate how long the file will take
+	double predictedSec;		// estimated processing time when the file was dispatched
+	double workSec;				// time actually spent on the file, summed over all pipeline stages
+	ProcessContent *pContent;	// data extracted from the file, travels from the extract stage to the write stage
 };
 
 
 //////////////////////////////////////////
 // GLOBALS
 //////////////////////////////////////////
-extern bool G_bVerbose;
+extern bool G_bControlPoints;	// record positions (and colors/uv's mapped by control point) once per control point instead of per triangle corner
 
 
 
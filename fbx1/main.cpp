@@ -3,7 +3,7 @@
 //
 
 // sytem includes
-#include <process.h> // thread library ('_beginthread')
+#include <stdlib.h>	 // atoi
 #include <string>
 #include <vector>
 
@@ -13,7 +13,19 @@
 #include "fbxdefs.h"
 #include "ProcessContent.h"
 #include "Weld.h"
+#include "WorkQueue.h"
+#include "InputManifest.h"
+#include "BatchScheduler.h"
+#include "Pipeline.h"
+#include "TaskScheduler.h"
 #include "PerformanceCounter.h"
+#include "Quantize.h"
+#include "CpuDispatch.h"
+#include "WeldBench.h"
+#include "WeldGrid.h"
+#include "AsyncWriter.h"
+#include "ResWriter.h"
+#include "ResCodec.h"
 
 
 
@@ -28,17 +40,18 @@ using namespace std;	// to avoid having to write std:: every time I want to use
 //////////////////////////////////////////
 // PROTOTYPES
 //////////////////////////////////////////
-void ProcessFbxFileThreadStart(void *pData);
+void PrintUsage();
+bool ParseStageThreads(const char *pList, PipelineSettings & settings);
 
 
 
 //////////////////////////////////////////
 // GLOBALS
 //////////////////////////////////////////
-FbxLib G_fbxLib = {NULL, NULL};
-FbxLibAndFilename G_fbxInfo[MAX_FILE_COUNT];
-int G_threadCnt;
-bool G_bVerbose = false;
+bool G_bControlPoints = false;
+TaskScheduler *G_pTaskScheduler = NULL;
+AsyncWriter *G_pAsyncWriter = NULL;
+ResCodec G_resCodec = RES_CODEC_NONE;
 
 
 
@@ -51,62 +64,332 @@ bool G_bVerbose = false;
 //////////////////////////////////////////
 int main(int argc, char** argv)
 {
-	printf("Processing fbx file list...\n");
+	LOG_INFO("Processing fbx file list...\n");
+
+	int workerCnt = 0;	// 0 means one per hardware thread
+	int window = SCHEDULER_DEFAULT_WINDOW; // files held back for largest-first ordering
+	int queueDepth = PIPELINE_DEFAULT_QUEUE_DEPTH;
+	const char *pStageThreads = NULL; // per stage thread counts, overrides the ones derived from workerCnt
+	int inputCnt = 0;	// number of input sources (files, lists, directories) on the command line
+	bool cpuReport = false;	// --cpu-features: print what the CPU can do and exit
+	int benchCount = 0;		// --weld-bench N: time the weld routines on N values and exit
+	int writeBehindMB = ASYNC_DEFAULT_MAX_MB;	// --write-behind N: output MB queued for the I/O thread, 0 = no I/O thread
+
+	CpuDispatch::Init(); // before any kernel runs, --cpu may lower the level
+
+	//////////////////////////////////////////
+	// First pass: settings that must be known before the workers start.
+	// Inputs are only counted here, they get read once the workers are running
+	for(int i=1; i < argc; i++)
+	{
+		string arg(argv[i]);
+
+		if(arg == "-" || arg[0] != '-')
+		{
+			inputCnt++;
+		}
+		else if(arg == "-r")
+		{
+			i++; // skip directory
+			inputCnt++;
+		}
+		else if(arg == "-f")
+		{
+			i++; // skip filter list
+		}
+		else if(arg.find("-v") == 0)
+		{
+			G_logLevel = LOG_LEVEL_VERBOSE;
+			LOG_VERBOSE("\tVerbose mode On...\n");
+		}
+		else if(arg == "-c")
+		{
+			LOG_INFO("\tControl point mode On...\n");
+			G_bControlPoints = true;
+		}
+		else if(arg.find("-j") == 0)
+		{
+			// accept both "-j N" and "-jN"
+			const char *pCount = "";
+			if(arg.length() > 2)
+				pCount = argv[i] + 2;
+			else if(i + 1 < argc)
+				pCount = argv[++i];
+
+			workerCnt = atoi(pCount);
+			if(workerCnt <= 0)
+			{
+				LOG_ERROR("***   Invalid worker count \"%s\" for -j\n", pCount);
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "-l")
+		{
+			const char *pLevel = i + 1 < argc ? argv[++i] : "";
+			if(!Log::ParseLevel(pLevel, G_logLevel))
+			{
+				LOG_ERROR("***   Invalid log level \"%s\" for -l\n", pLevel);
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "-p")
+		{
+			const char *pPrecision = i + 1 < argc ? argv[++i] : "";
+			if(!ParsePrecision(pPrecision, G_precision))
+			{
+				LOG_ERROR("***   Invalid precision list \"%s\" for -p\n", pPrecision);
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "-t")
+		{
+			const char *pTolerance = i + 1 < argc ? argv[++i] : "";
+			if(!ParseTolerance(pTolerance, G_tolerance))
+			{
+				LOG_ERROR("***   Invalid weld tolerance list \"%s\" for -t\n", pTolerance);
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "--cpu-features")
+		{
+			cpuReport = true;
+		}
+		else if(arg.find("--cpu=") == 0)
+		{
+			if(!CpuDispatch::SetLevel(argv[i] + 6))
+			{
+				LOG_ERROR("***   Unknown or unsupported instruction set \"%s\" for --cpu (best here: %s)\n", argv[i] + 6,
+						CpuDispatch::GetLevelName(CpuDispatch::GetBestLevel()));
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "--weld-bench")
+		{
+			benchCount = i + 1 < argc ? atoi(argv[++i]) : 0;
+			if(benchCount <= 0)
+			{
+				LOG_ERROR("***   --weld-bench needs a value count\n");
+				PrintUsage();
+				return 0;
+			}
+		}
+		else if(arg == "-w")
+		{
+			if(i + 1 < argc)
+				window = atoi(argv[++i]);
 
-	int stArg = 1; // first filename in argv to process according to usage
+			if(window < 0)
+				window = 0;
+		}
+		else if(arg == "-s")
+		{
+			if(i + 1 < argc)
+				pStageThreads = argv[++i];
+		}
+		else if(arg == "-q")
+		{
+			if(i + 1 < argc)
+				queueDepth = atoi(argv[++i]);
 
-	// verbose mode?  If so, first filename in argv according to usage will be 2
-	if(argc >= 2)
-	{
-		string arg1(argv[1]);
-		size_t loc = arg1.find("-v");
-		if(loc != string::npos)
+			if(queueDepth < 1)
+				queueDepth = 1;
+		}
+		else if(arg == "--write-behind")
+		{
+			if(i + 1 < argc)
+				writeBehindMB = atoi(argv[++i]);
+
+			if(writeBehindMB < 0)
+				writeBehindMB = 0;
+		}
+		else if(arg == "--compress")
+		{
+			const char *pCodec = i + 1 < argc ? argv[++i] : "";
+			if(!ParseResCodec(pCodec, G_resCodec) || !IsResCodecAvailable(G_resCodec))
+			{
+				LOG_ERROR("***   Unknown or unavailable codec \"%s\" for --compress\n", pCodec);
+				PrintUsage();
+				return 0;
+			}
+		}
+		else
 		{
-			printf("\tVerbose mode On...\n");
-			G_bVerbose = true;
-			stArg = 2;
+			LOG_ERROR("***   Unknown option %s\n", argv[i]);
+			PrintUsage();
+			return 0;
 		}
 	}
 
-	if(argc < stArg +1)
+	if(cpuReport)
+	{
+		CpuDispatch::PrintReport();
+		return 0;
+	}
+
+	if(benchCount > 0)
+	{
+		RunWeldBenchmark((size_t) benchCount);
+		return 0;
+	}
+
+	if(inputCnt == 0)
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	// default to one worker per hardware thread.  The number of files isn't known yet
+	if(workerCnt == 0)
+	{
+		SYSTEM_INFO sysInfo;
+		GetSystemInfo(&sysInfo);
+		workerCnt = (int) sysInfo.dwNumberOfProcessors;
+	}
+
+	PipelineSettings settings;
+	Pipeline::DefaultSettings(workerCnt, settings);
+	settings.queueDepth = queueDepth;
+
+	if(pStageThreads && !ParseStageThreads(pStageThreads, settings))
 	{
-		printf("Usage: fbx1.exe [ -v] <filename1.fbx> <filename2.fbx> ...\n");
+		LOG_ERROR("***   Invalid stage thread counts \"%s\" for -s\n", pStageThreads);
+		PrintUsage();
 		return 0;
 	}
 
-    // Prepare the FBX SDK.
-	InitializeSdkObjects(G_fbxLib.lSdkManager, G_fbxLib.lScene);
+	int taskWorkerCnt = Pipeline::TaskWorkerCount(workerCnt, settings);
+
+	LOG_VERBOSE("\tThreads per stage: load %d, extract %d, weld %d, write %d, plus %d task workers.  Queue depth %d...\n",
+			settings.threads[STAGE_LOAD], settings.threads[STAGE_EXTRACT], settings.threads[STAGE_WELD],
+			settings.threads[STAGE_WRITE], taskWorkerCnt, settings.queueDepth);
+
+	LOG_VERBOSE("\tKernels at %s level.  Rounding: pos %g, nrm %g, tex %g, col %g, tan %g, bin %g...\n", CpuDispatch::GetLevelName(G_cpuLevel),
+			G_precision.pos, G_precision.nrm, G_precision.tex, G_precision.col, G_precision.tan, G_precision.bin);
+	LOG_VERBOSE("\tWeld tolerances (0 = exact): pos %g, nrm %g, tex %g, col %g, tan %g, bin %g...\n",
+			G_tolerance.pos, G_tolerance.nrm, G_tolerance.tex, G_tolerance.col, G_tolerance.tan, G_tolerance.bin);
+
+	// files waiting to be loaded.  A couple of entries per load thread is plenty: it keeps the pipeline fed
+	// while the file list is being read, and stops a huge directory walk from racing ahead of it
+	WorkQueue<FbxLibAndFilename *> workQueue(2 * settings.threads[STAGE_LOAD]);
+	BatchScheduler scheduler(&workQueue, (size_t) window);
+
+	TimerPerformanceCounter wallClock;
+	wallClock.Start();
+
+
+
+	//////////////////////////////////////////
+	// START PIPELINE
+	// From here on messages come from every thread: queue them, the log's own thread prints them.
+	// The task pool lets the extract threads spread a single file's meshes over every core, and
+	// the I/O thread writes the output behind them.  No pool if the stages already use every core
+	Log::Start();
+	if(taskWorkerCnt > 0)
+		G_pTaskScheduler = new TaskScheduler(taskWorkerCnt);
+
+	if(writeBehindMB > 0)
+	{
+		G_pAsyncWriter = new AsyncWriter((size_t) writeBehindMB << 20);
+		if(!G_pAsyncWriter->Start())
+		{
+			LOG_WARNING("\tCan't start the I/O thread, writing from the pipeline threads...\n");
+			delete G_pAsyncWriter;
+			G_pAsyncWriter = NULL;
+		}
+	}
 
-	// keep track of how many thread we make so we can track errors
-	G_threadCnt = 0;
+	Pipeline pipeline(&workQueue, &scheduler, settings);
 
-	for(int i=stArg; i<argc; i++)
+	if(!pipeline.Start())
 	{
-		G_fbxInfo[i].pFbxLib = &G_fbxLib;
-		G_fbxInfo[i].fileName = argv[i];
-		uintptr_t ret;
+		LOG_ERROR("***   Error in main.cpp: unable to start the processing pipeline\n");
+
+		// no files yet: the threads that did start just exit
+		workQueue.Close();
+		pipeline.Join();
+
+		delete G_pAsyncWriter;
+		G_pAsyncWriter = NULL;
+
+		delete G_pTaskScheduler;
+		G_pTaskScheduler = NULL;
+
+		Log::Stop();
+		return 1;
+	}
 
-		// kick off thread
-		ret =_beginthread(ProcessFbxFileThreadStart, 0, (void *) &G_fbxInfo[i]);
 
-		// check for errors
-		if(ret > 0)
+
+	//////////////////////////////////////////
+	// FEED PIPELINE
+	// Second pass: read the inputs in command line order.  Files are queued as they are found
+	InputManifest manifest(&scheduler);
+	string filters("*.fbx");
+
+	for(int i=1; i < argc; i++)
+	{
+		string arg(argv[i]);
+
+		if(arg == "-")
 		{
-			G_threadCnt++;
+			manifest.AddStream(stdin);
 		}
-		else
+		else if(arg[0] == '@')
+		{
+			manifest.AddResponseFile(arg.substr(1));
+		}
+		else if(arg == "-r")
+		{
+			if(i + 1 < argc)
+				manifest.AddDirectory(argv[++i], filters);
+		}
+		else if(arg == "-f")
+		{
+			if(i + 1 < argc)
+				filters = argv[++i];
+		}
+		else if(arg == "-j" || arg == "-l" || arg == "-p" || arg == "-t" || arg == "-w" || arg == "-s" || arg == "-q" || arg == "--weld-bench" || arg == "--write-behind" || arg == "--compress")
+		{
+			i++; // already handled, skip the value
+		}
+		else if(arg[0] != '-')
 		{
-			printf("***   Error in main.cpp creating a thread for %s (arg #%d)\n", argv[i], i);
+			manifest.AddFile(arg);
 		}
 	}
 
-	// wait for all threads to end
-	if(G_bVerbose)
-		printf("\tWaiting for all files to finish being processed...\n");
-	
-	while(G_threadCnt > 0);
+	scheduler.Flush(); // whatever is still held back, most expensive first
+	workQueue.Close();
+
+	if(manifest.GetFileCount() == 0)
+		LOG_ERROR("***   No input files found\n");
+	else
+		LOG_VERBOSE("\tQueued %u file(s)...\n", (unsigned int) manifest.GetFileCount());
+
+
+
+	//////////////////////////////////////////
+	// wait for all files to make it through the pipeline
+	LOG_VERBOSE("\tWaiting for all files to finish being processed...\n");
+
+	pipeline.Join();
 
-	printf("Done.\n");
+	delete G_pAsyncWriter; // waits for the last files to be on disk
+	G_pAsyncWriter = NULL;
+
+	delete G_pTaskScheduler;
+	G_pTaskScheduler = NULL;
+
+	wallClock.Stop();
+	scheduler.PrintSummary(wallClock.IntervalSeconds());
+
+	LOG_INFO("Done.\n");
+	Log::Stop();
 
 	return 0;
 }
@@ -115,27 +398,58 @@ int main(int argc, char** argv)
 
 //////////////////////////////////////////
 //
-// Entry point for thread.  One thread per file processed
+// Command line help
 //
 //////////////////////////////////////////
-void ProcessFbxFileThreadStart(void *pData)
+void PrintUsage()
 {
-	FbxLibAndFilename *pFbxInfo = static_cast<FbxLibAndFilename *>(pData);
+	printf("Usage: fbx1.exe [-v] [-l level] [-c] [-p list] [-t list] [--cpu=level] [--cpu-features] [--weld-bench N] [-j N] [-s L,E,W,O] [-q N] [-w N] [--write-behind N] [--compress codec] [-f filters] <inputs> ...\n");
+	printf("Inputs (read in order, processing starts while they are still being read):\n");
+	printf("\t<file.fbx>\tprocess a single file\n");
+	printf("\t@<list.txt>\tprocess every file listed in list.txt, one path per line\n");
+	printf("\t-\t\tread paths from stdin, one per line\n");
+	printf("\t-r <dir>\trecursively process every file in dir that matches the filters\n");
+	printf("Options:\n");
+	printf("\t-v\t\tverbose, same as -l verbose\n");
+	printf("\t-l level\tlog level: error, warning, info or verbose (default: info)\n");
+	printf("\t-c\t\tcontrol point mode: positions are stored once per control point and not welded (unless -t pos= is given)\n");
+	printf("\t-p list\t\trounding steps per unit, any of pos=N,nrm=N,tex=N,col=N,tan=N,bin=N (default: %g each)\n", DEFAULT_PRECISION_POS);
+	printf("\t-t list\t\tweld within a tolerance instead of rounding: pos=D,tex=D,col=D (distances), nrm=A,tan=A,bin=A (degrees)\n");
+	printf("\t--cpu=level\tcap the instruction set kernels use: scalar, sse4.1 or avx (default: best available)\n");
+	printf("\t--cpu-features\tprint the CPU's features and the kernel versions picked, then exit\n");
+	printf("\t--weld-bench N\ttime the weld routines on N made up positions and check the tolerance weld, then exit\n");
+	printf("\t-j N\t\thardware threads to size the pipeline for (default: all of them)\n");
+	printf("\t-s L,E,W,O\tthreads for the load, extract, weld and write stages (default: derived from -j).  The task pool gets the cores extract and weld leave\n");
+	printf("\t-q N\t\tmax files waiting in front of each stage (default: %d)\n", PIPELINE_DEFAULT_QUEUE_DEPTH);
+	printf("\t-w N\t\tlargest-first scheduling window: files held back while the workers are busy, 0 keeps the input order (default: %d)\n", SCHEDULER_DEFAULT_WINDOW);
+	printf("\t--write-behind N\tMB of output queued for a background I/O thread, 0 writes from the pipeline threads (default: %d)\n", ASYNC_DEFAULT_MAX_MB);
+	printf("\t--compress codec\tcompress the big arrays of the .res files: none, lz4%s (default: none)\n", IsResCodecAvailable(RES_CODEC_ZSTD) ? " or zstd" : "");
+	printf("\t-f filters\tglob filters for any following -r, ';' separated (default: *.fbx)\n");
+}
 
-	if(G_bVerbose)
-		printf("\t\tProcessing: %s...\n", pFbxInfo->fileName.c_str());
 
-	bool lResult = LoadScene(pFbxInfo->pFbxLib->lSdkManager, pFbxInfo->pFbxLib->lScene, pFbxInfo->fileName.c_str());
 
-    if(lResult == false)
-    {
-		FBXSDK_printf("***  An error occurred while loading the scene \"%s\" (main.cpp->ProcessFbxFile->LoadScene)...\n", pFbxInfo->fileName.c_str());
-    }
-	else
+//////////////////////////////////////////
+//
+// Parse "-s 2,8,4,1" into the per stage
+// thread counts.  Every stage needs at
+// least one thread
+//
+//////////////////////////////////////////
+bool ParseStageThreads(const char *pList, PipelineSettings & settings)
+{
+	int counts[STAGE_COUNT];
+
+	if(sscanf(pList, "%d,%d,%d,%d", &counts[STAGE_LOAD], &counts[STAGE_EXTRACT], &counts[STAGE_WELD], &counts[STAGE_WRITE]) != STAGE_COUNT)
+		return false;
+
+	for(int i=0; i < STAGE_COUNT; i++)
 	{
-		ProcessContent proc(pFbxInfo->fileName);	// create the data structure that will hold all of the file's data
-		proc.Start(pFbxInfo->pFbxLib->lScene);		// process the file (extract all data)
+		if(counts[i] < 1)
+			return false;
+
+		settings.threads[i] = counts[i];
 	}
 
-	G_threadCnt--; //done update global counter
+	return true;
 }